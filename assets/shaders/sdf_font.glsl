@@ -0,0 +1,33 @@
+#ifdef VERTEX
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+layout(location = 3) in vec4 color;
+uniform mat4 projection;
+uniform mat4 view;
+out vec4 frag_color;
+out vec2 frag_uv;
+void main() {
+    gl_Position =  projection * view * vec4(position, 1.0);
+    frag_color = color;
+    frag_uv = uv;
+}
+#endif
+#ifdef FRAGMENT
+out vec4 final_color;
+in vec4 frag_color;
+in vec2 frag_uv;
+
+// Distance field glyphs from the glyph cache. The outline is at 0.5. See cache_glyph in draw.c
+uniform sampler2D distance_atlas;
+
+void main() {
+    if (frag_uv.x > -1.0) {
+        // Blend over about a pixel whatever size the glyph is drawn at
+        float field = texture(distance_atlas, frag_uv).r;
+        float edge_width = 0.5 * fwidth(field);
+        float coverage = smoothstep(0.5 - edge_width, 0.5 + edge_width, field);
+        final_color = vec4(frag_color.xyz, frag_color.a * coverage);
+    } else final_color = frag_color;
+}
+#endif
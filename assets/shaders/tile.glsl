@@ -0,0 +1,48 @@
+#ifdef VERTEX
+
+// One instance per tile. The quad comes from gl_VertexID and the sprite is a layer of the tile sprite array. See cell_map.c
+layout(location = 0) in uvec2 tile_xy;
+layout(location = 1) in uint tile_layer;
+layout(location = 2) in uvec2 tile_cell_map_layer_flags;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+// z for each Cell_Map_Layer
+uniform vec4 layer_z;
+
+out vec3 frag_uv;
+
+// Same vertex order as imm_textured_rect
+const vec2 corners[6] = vec2[6](
+    vec2(0.0, 1.0),
+    vec2(0.0, 0.0),
+    vec2(1.0, 1.0),
+
+    vec2(0.0, 0.0),
+    vec2(1.0, 0.0),
+    vec2(1.0, 1.0)
+);
+
+void main() {
+    vec2 corner = corners[gl_VertexID];
+    vec2 position = vec2(tile_xy) + corner;
+    float z = layer_z[int(tile_cell_map_layer_flags.x)];
+    gl_Position = projection * view * vec4(position, z, 1.0);
+
+    frag_uv = vec3(corner, float(tile_layer));
+}
+
+#endif
+#ifdef FRAGMENT
+
+out vec4 final_color;
+in vec3 frag_uv;
+
+uniform sampler2DArray sprites;
+
+void main() {
+    final_color = texture(sprites, frag_uv);
+}
+
+#endif
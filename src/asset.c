@@ -15,14 +15,18 @@ static char* asset_type_string[] = {
     "Shader",
     "Texture2d",
     "Font Collection",
-    "Mesh"
+    "Mesh",
+    "Sprite Array",
 };
 
 #define ASSET_TYPE_DEFINITION(def) \
-def(AT_Shader, load_shader, unload_null) \
-def(AT_Texture2d, load_texture2d, unload_null) \
-def(AT_Font_Collection, load_font_collection, unload_null) \
-def(AT_Mesh, load_mesh, unload_null)
+def(AT_Shader, load_shader, unload_shader) \
+def(AT_Texture2d, load_texture2d, unload_texture2d) \
+def(AT_Font_Collection, load_font_collection, unload_font_collection) \
+def(AT_Mesh, load_mesh, unload_mesh) \
+def(AT_Sprite_Array, load_sprite_array, unload_sprite_array)
+
+// Loaders copy anything they need out of file since it is freed right after loading
 
 static b32 load_null(Asset* asset, String file, Allocator asset_memory) { return false; }
 static b32 unload_null(Asset* asset, Allocator asset_memory) { return false; }
@@ -34,6 +38,15 @@ static b32 load_shader(Asset* asset, String file, Allocator asset_memory) {
     return init_shader(shader);
 }
 
+static b32 unload_shader(Asset* asset, Allocator asset_memory) {
+    Shader* shader = &asset->shader;
+
+    // Don't use free_string as the allocator in source may be from an old code load
+    mem_free(asset_memory, shader->source.data);
+    shader->source = (String) { 0 };
+    return free_shader(shader);
+}
+
 static b32 load_texture2d(Asset* asset, String file, Allocator asset_memory) {
     Texture2d* texture = &asset->texture2d;
 
@@ -49,9 +62,69 @@ static b32 load_texture2d(Asset* asset, String file, Allocator asset_memory) {
     return upload_texture2d(texture);
 }
 
+static b32 unload_texture2d(Asset* asset, Allocator asset_memory) {
+    Texture2d* texture = &asset->texture2d;
+
+    glDeleteTextures(1, &texture->id);
+    stbi_image_free(texture->pixels);
+    *texture = (Texture2d) { 0 };
+    return true;
+}
+
+#define FONT_CACHE_PATH "cache/"
+
 static b32 load_font_collection(Asset* asset, String file, Allocator asset_memory) {
     Font_Collection* fc = &asset->font_collection;
-    return init_font_collection(expand_string(file), asset_memory, fc);
+
+    // Codepoint tables are cached by the font's file name so later launches can skip parsing
+    String name = asset->path;
+    for (int i = name.len - 1; i >= 0; --i) {
+        if (name.data[i] == '/' || name.data[i] == '\\') {
+            name = advance_string(name, i + 1);
+            break;
+        }
+    }
+    int period_index = find_from_left(name, '.');
+    if (period_index != -1) name.len = period_index;
+
+    char cache_path[1024];
+    sprintf(cache_path, "%s%.*s.cmap", FONT_CACHE_PATH, name.len, (const char*)name.data); // @CRT
+    if (!g_platform->file_metadata(from_cstr(FONT_CACHE_PATH), 0)) g_platform->create_directory(from_cstr(FONT_CACHE_PATH));
+
+    // Fonts handed out before a reload are asked for again in the same order so they land in the same slots and any
+    // Font* held onto stays valid. Unloading leaves them in the collection for this
+    int font_count = fc->font_count;
+    int font_sizes[FONT_CAP];
+    b32 font_is_sdf[FONT_CAP];
+    for (int i = 0; i < font_count; ++i) {
+        font_sizes[i]  = fc->fonts[i].size;
+        font_is_sdf[i] = fc->fonts[i].is_sdf;
+    }
+
+    // STBTT reads from the font data for as long as the collection lives
+    String data = copy_string(file, asset_memory);
+    if (!init_font_collection(expand_string(data), from_cstr(cache_path), asset_memory, fc)) {
+        mem_free(asset_memory, data.data);
+        return false;
+    }
+
+    for (int i = 0; i < font_count; ++i) {
+        Font* font = font_is_sdf[i] ? sdf_font_at_size(fc, font_sizes[i]) : font_at_size(fc, font_sizes[i]);
+        assert(font == &fc->fonts[i]);
+    }
+    return true;
+}
+
+static b32 unload_font_collection(Asset* asset, Allocator asset_memory) {
+    Font_Collection* fc = &asset->font_collection;
+
+    for (int i = 0; i < fc->font_count; ++i) evict_font_glyphs(&fc->fonts[i]);
+
+    mem_free(asset_memory, fc->pages);
+    mem_free(asset_memory, fc->info.data);
+    fc->pages = 0;
+    fc->info  = (stbtt_fontinfo) { 0 };
+    return true;
 }
 
 static u64 hash_mesh_vertex(void* a, void* b, int size) {
@@ -64,7 +137,7 @@ static u64 hash_mesh_vertex(void* a, void* b, int size) {
         return v3_equal(a_vert->position, b_vert->position) && v3_equal(a_vert->normal, b_vert->normal) && v2_equal(a_vert->uv, b_vert->uv);
     }
 
-    return fnv1_hash(a, size);
+    return hash_bytes(a, size);
 }
 
 static b32 load_mesh(Asset* asset, String file, Allocator asset_memory) {
@@ -88,7 +161,8 @@ static b32 load_mesh(Asset* asset, String file, Allocator asset_memory) {
     u32* indices = mem_alloc_array(asset_memory, u32, index_cap);
     int index_count = 0;
 
-    Hash_Table vertex_index_table = make_hash_table(Mesh_Vertex, int, hash_mesh_vertex, g_platform->permanent_arena);
+    // Only needed while loading so this goes away with the temp memory around the load
+    Hash_Table vertex_index_table = make_pod_hash_table(Mesh_Vertex, int, g_platform->frame_arena);
     reserve_hash_table(&vertex_index_table, index_cap / 3);
 
     for (int i = 0; i < (int)fast_obj_mesh->group_count; ++i) {
@@ -142,11 +216,172 @@ static b32 load_mesh(Asset* asset, String file, Allocator asset_memory) {
     mesh->indices = indices;
     mesh->index_count = index_count;
 
+    fast_obj_destroy(fast_obj_mesh);
     upload_mesh(mesh);
 
     return true;
 }
 
+static b32 unload_mesh(Asset* asset, Allocator asset_memory) {
+    Mesh* mesh = &asset->mesh;
+
+    glDeleteBuffers(2, &mesh->vbo);
+    glDeleteVertexArrays(1, &mesh->vao);
+    mem_free(asset_memory, mesh->vertices);
+    mem_free(asset_memory, mesh->indices);
+    *mesh = (Mesh) { 0 };
+    return true;
+}
+
+static String trim_string(String s) {
+    while (s.len > 0 && (s.data[0] == ' ' || s.data[0] == '\t' || s.data[0] == '\r')) s = advance_string(s, 1);
+    while (s.len > 0 && (s.data[s.len - 1] == ' ' || s.data[s.len - 1] == '\t' || s.data[s.len - 1] == '\r')) s.len -= 1;
+    return s;
+}
+
+static b32 unload_sprite_array(Asset* asset, Allocator asset_memory);
+
+// The manifest is a "size <pixels>" line then a sheet path per line relative to the manifest. # starts a comment
+static b32 load_sprite_array(Asset* asset, String file, Allocator asset_memory) {
+    Sprite_Array* sprites = &asset->sprite_array;
+
+    int directory_len = 0;
+    for (int i = 0; i < asset->path.len; ++i) {
+        if (asset->path.data[i] == '/') directory_len = i + 1;
+    }
+
+    int size = 0;
+    u8* sheet_pixels[SPRITE_SHEET_CAP] = { 0 };
+    int sheet_widths[SPRITE_SHEET_CAP] = { 0 };
+    b32 loaded = true;
+
+    // Sheets are loaded bottom row first like load_texture2d so sprite numbers match the sheet's uvs
+    stbi_set_flip_vertically_on_load(true);
+
+    String remaining = file;
+    while (remaining.len > 0 && loaded) {
+        int newline_index = find_from_left(remaining, '\n');
+        String line = remaining;
+        if (newline_index == -1) {
+            remaining.len = 0;
+        } else {
+            line.len = newline_index;
+            remaining = advance_string(remaining, newline_index + 1);
+        }
+
+        line = trim_string(line);
+        if (line.len == 0 || line.data[0] == '#') continue;
+
+        String size_prefix = from_cstr("size ");
+        if (starts_with(line, size_prefix)) {
+            String digits = trim_string(advance_string(line, size_prefix.len));
+            size = 0;
+            for (int i = 0; i < digits.len && digits.data[i] >= '0' && digits.data[i] <= '9'; ++i) size = size * 10 + (digits.data[i] - '0');
+            continue;
+        }
+
+        if (size <= 0 || sprites->sheet_count == SPRITE_SHEET_CAP) {
+            o_log_error("[Asset] %s needs a size before its sheets and can have at most %i sheets", (const char*)asset->path.data, SPRITE_SHEET_CAP);
+            loaded = false;
+            break;
+        }
+
+        char sheet_path[1024];
+        sprintf(sheet_path, "%.*s%.*s", directory_len, (const char*)asset->path.data, line.len, (const char*)line.data); // @CRT
+
+        String sheet_file;
+        if (!read_file_into_string(from_cstr(sheet_path), &sheet_file, g_platform->frame_arena)) {
+            o_log_error("[Asset] %s failed to read sprite sheet %s", (const char*)asset->path.data, sheet_path);
+            loaded = false;
+            break;
+        }
+
+        int width, height, depth;
+        u8* pixels = stbi_load_from_memory(expand_string(sheet_file), &width, &height, &depth, 4);
+        if (!pixels || width % size != 0 || height % size != 0) {
+            o_log_error("[Asset] %s sprite sheet %s isn't a whole number of %ipx sprites", (const char*)asset->path.data, sheet_path, size);
+            if (pixels) stbi_image_free(pixels);
+            loaded = false;
+            break;
+        }
+
+        int period_index = find_from_left(line, '.');
+        String name = line;
+        if (period_index != -1) name.len = period_index;
+
+        Sprite_Sheet* sheet = &sprites->sheets[sprites->sheet_count];
+        sheet->name = copy_string(name, asset_memory);
+        sheet->first_sprite = sprites->sprite_count;
+        sheet->sprite_count = (width / size) * (height / size);
+
+        sheet_pixels[sprites->sheet_count] = pixels;
+        sheet_widths[sprites->sheet_count] = width;
+        sprites->sheet_count += 1;
+        sprites->sprite_count += sheet->sprite_count;
+    }
+
+    if (loaded && sprites->sprite_count > 0) {
+        int layer_size = size * size * 4;
+        u8* layers = mem_alloc_array(g_platform->frame_arena, u8, (usize)layer_size * sprites->sprite_count);
+        sprites->sprite_layers = mem_alloc_array(asset_memory, s16, sprites->sprite_count);
+
+        int layer_count = 0;
+        for (int i = 0; i < sprites->sheet_count; ++i) {
+            Sprite_Sheet* sheet = &sprites->sheets[i];
+            u8* pixels = sheet_pixels[i];
+            int sheet_width = sheet_widths[i];
+            int sprites_per_row = sheet_width / size;
+
+            for (int j = 0; j < sheet->sprite_count; ++j) {
+                int sprite_x = (j % sprites_per_row) * size;
+                int sprite_y = (j / sprites_per_row) * size;
+
+                u8* layer = layers + (usize)layer_size * layer_count;
+                b32 is_empty = true;
+                for (int y = 0; y < size; ++y) {
+                    u8* row = pixels + ((sprite_y + y) * sheet_width + sprite_x) * 4;
+                    mem_copy(layer + y * size * 4, row, size * 4);
+                    for (int x = 0; x < size; ++x) is_empty &= row[x * 4 + 3] == 0;
+                }
+
+                if (is_empty) {
+                    sprites->sprite_layers[sheet->first_sprite + j] = -1;
+                } else {
+                    assert(layer_count <= 0x7FFF);
+                    sprites->sprite_layers[sheet->first_sprite + j] = (s16)layer_count;
+                    layer_count += 1;
+                }
+            }
+        }
+
+        GLint max_layers = 0;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+        if (layer_count > max_layers) {
+            o_log_error("[Asset] %s has %i sprites but the driver only allows %i layers", (const char*)asset->path.data, layer_count, max_layers);
+            loaded = false;
+        } else if (layer_count > 0) {
+            sprites->texture = (Texture_Array) { size, size, layer_count };
+            loaded = upload_texture_array(&sprites->texture, layers);
+        }
+    }
+
+    for (int i = 0; i < sprites->sheet_count; ++i) stbi_image_free(sheet_pixels[i]);
+
+    // A failed load isn't unloaded by the asset manager so give back what was made here
+    if (!loaded) unload_sprite_array(asset, asset_memory);
+    return loaded;
+}
+
+static b32 unload_sprite_array(Asset* asset, Allocator asset_memory) {
+    Sprite_Array* sprites = &asset->sprite_array;
+
+    glDeleteTextures(1, &sprites->texture.id);
+    for (int i = 0; i < sprites->sheet_count; ++i) mem_free(asset_memory, sprites->sheets[i].name.data);
+    if (sprites->sprite_layers) mem_free(asset_memory, sprites->sprite_layers);
+    *sprites = (Sprite_Array) { 0 };
+    return true;
+}
+
 #define ASSET_CAP 1024 // This can be increased if needed
 #define PATH_MEMORY_CAP (ASSET_CAP * 1024) // Rough Estimate
 #define ASSET_MEMORY_CAP gigabyte(1)
@@ -157,6 +392,11 @@ typedef struct Asset_Manager {
     Allocator path_memory;
     Allocator asset_memory;
 
+    f64 last_reload_check;
+
+    // Indexed by Asset_Handle. Assets reload in place so these stay valid until the next init
+    Asset* handles[AH_Count];
+
     b32 is_initialized;
 } Asset_Manager;
 
@@ -176,6 +416,7 @@ static Asset_Type_Extension asset_type_extensions[] = {
     { AT_Texture2d, "bmp" },
     { AT_Mesh,      "obj" },
     { AT_Font_Collection, "ttf" },
+    { AT_Sprite_Array, "sprites" },
 };
 
 static Asset_Type get_asset_type_from_path(String path) {
@@ -191,56 +432,138 @@ static Asset_Type get_asset_type_from_path(String path) {
     return AT_None;
 }
 
+static b32 load_asset(Asset* asset) {
+    f64 start_time = g_platform->time_in_seconds();
+
+    String file;
+    if (!read_file_into_string(asset->path, &file, asset_manager->asset_memory)) {
+        o_log_error("[Asset] %s failed to load file from path %s", asset_type_string[asset->type], (const char*)asset->path.data);
+        return false;
+    }
+
+    // Loaders use the frame arena for scratch
+    Temp_Memory temp_memory = begin_temp_memory(g_platform->frame_arena);
+
+    b32 loaded = false;
+    switch (asset->type) {
+#define LOAD_ASSET(at, load, unload) \
+    case at: \
+        loaded = load(asset, file, asset_manager->asset_memory); \
+        break;
+    ASSET_TYPE_DEFINITION(LOAD_ASSET);
+#undef LOAD_ASSET
+    default:
+        o_log_error("[Asset] %s is missing asset type definition", asset_type_string[asset->type]);
+    };
+
+    end_temp_memory(temp_memory);
+    mem_free(asset_manager->asset_memory, file.data);
+
+    if (!loaded) {
+        o_log_error("[Asset] %s failed to initialize from path %s", asset_type_string[asset->type], (const char*)asset->path.data);
+        return false;
+    }
+
+    f64 duration = g_platform->time_in_seconds() - start_time;
+    o_log("[Asset] took %ims to load %s from path %s", (int)(duration * 1000.0), asset_type_string[asset->type], (const char*)asset->path.data);
+
+    asset->flags |= AF_Initialized;
+    return true;
+}
+
+static void unload_asset(Asset* asset) {
+    if (!(asset->flags & AF_Initialized)) return;
+
+    switch (asset->type) {
+#define UNLOAD_ASSET(at, load, unload) \
+    case at: \
+        unload(asset, asset_manager->asset_memory); \
+        break;
+    ASSET_TYPE_DEFINITION(UNLOAD_ASSET);
+#undef UNLOAD_ASSET
+    };
+
+    asset->flags &= ~AF_Initialized;
+}
+
+static void resolve_asset_handles(void) {
+    static const struct { Asset_Type type; const char* path; } definitions[AH_Count] = {
+        { AT_None, 0 },
+#define ASSET_HANDLE_PATH(ah, at, path) { at, path },
+        ASSET_HANDLE_DEFINITION(ASSET_HANDLE_PATH)
+#undef ASSET_HANDLE_PATH
+    };
+
+    for (int i = 1; i < AH_Count; ++i) {
+        Asset* asset = find_asset(from_cstr(definitions[i].path));
+        if (!asset || asset->type != definitions[i].type) {
+            o_log_error("[Asset] could not find %s at path %s", asset_type_string[definitions[i].type], definitions[i].path);
+            asset = 0;
+        }
+        asset_manager->handles[i] = asset;
+    }
+}
+
 void init_asset_manager(Platform* platform) {
     asset_manager = mem_alloc_struct(platform->permanent_arena, Asset_Manager);
     asset_manager->path_memory  = arena_allocator(platform->permanent_arena, PATH_MEMORY_CAP);
-    asset_manager->asset_memory = arena_allocator(platform->permanent_arena, ASSET_MEMORY_CAP); // @TODO(colby): do pool allocator
-
-    if (asset_manager->is_initialized) return;
+    asset_manager->asset_memory = tlsf_allocator(platform->permanent_arena, ASSET_MEMORY_CAP);
+    track_allocator(&asset_manager->path_memory, platform->permanent_arena, "Asset Paths", false);
+    track_allocator(&asset_manager->asset_memory, platform->permanent_arena, "Asset Memory", true);
+
+    if (asset_manager->is_initialized) {
+        // Font collections hold onto the allocator whose proc is from the last code load
+        for (int i = 0; i < asset_manager->asset_count; ++i) {
+            Asset* asset = &asset_manager->assets[i];
+            if (asset->type == AT_Font_Collection) asset->font_collection.asset_memory = asset_manager->asset_memory;
+        }
+        resolve_asset_handles();
+        return;
+    }
     asset_manager->is_initialized = true;
 
     for (directory_iterator(from_cstr("assets/"), true, platform->frame_arena)) {
-        Temp_Memory temp_memory = begin_temp_memory(platform->frame_arena);
         if (iter->type != DET_File) continue;
 
-        f64 start_time = g_platform->time_in_seconds();
-
         Asset_Type type = get_asset_type_from_path(iter->path);
         if (!type) continue;
 
         Asset* asset = &asset_manager->assets[asset_manager->asset_count++];
         asset->path = copy_string(iter->path, asset_manager->path_memory);
         asset->type = type;
-        
-        String file;
-        if (!read_file_into_string(iter->path, &file, asset_manager->asset_memory)) {
-            end_temp_memory(temp_memory);
-            o_log_error("[Asset] %s failed to load file from path %s", asset_type_string[type], (const char*)iter->path.data);
-            continue;
-        }
+        asset->last_write_time = iter->metadata.last_write_time;
 
-        switch (type) {
-#define LOAD_ASSET(at, load, unload) \
-        case at: \
-            if (!load(asset, file, asset_manager->asset_memory)) { \
-                end_temp_memory(temp_memory); \
-                o_log_error("[Asset] %s failed to initialize from path %s", asset_type_string[type], (const char*)iter->path.data); \
-                continue; \
-            } else { \
-                f64 duration = g_platform->time_in_seconds() - start_time; \
-                o_log("[Asset] took %ims to load %s from path %s", (int)(duration * 1000.0), asset_type_string[type], (const char*)iter->path.data); \
-            } \
-            break;
-        ASSET_TYPE_DEFINITION(LOAD_ASSET);
-#undef LOAD_ASSET
-        default:
-            o_log_error("[Asset] %s is missing asset type definition", asset_type_string[type]);
-        };
+        load_asset(asset);
+    }
 
-        asset->flags |= AF_Initialized;
+    resolve_asset_handles();
+}
+
+b32 reload_asset(Asset* asset) {
+    unload_asset(asset);
+    return load_asset(asset);
+}
+
+#define ASSET_RELOAD_CHECK_INTERVAL 1.0
+b32 reload_changed_assets(void) {
+    f64 now = g_platform->time_in_seconds();
+    if (now - asset_manager->last_reload_check < ASSET_RELOAD_CHECK_INTERVAL) return false;
+    asset_manager->last_reload_check = now;
+
+    b32 reloaded = false;
+    for (int i = 0; i < asset_manager->asset_count; ++i) {
+        Asset* asset = &asset_manager->assets[i];
+
+        File_Metadata metadata;
+        if (!g_platform->file_metadata(asset->path, &metadata)) continue;
+        if (metadata.last_write_time == asset->last_write_time) continue;
 
-        end_temp_memory(temp_memory);
+        asset->last_write_time = metadata.last_write_time;
+        o_log("[Asset] %s changed on disk. Reloading", (const char*)asset->path.data);
+        reload_asset(asset);
+        reloaded = true;
     }
+    return reloaded;
 }
 
 Asset* find_asset(String path) {
@@ -251,4 +574,16 @@ Asset* find_asset(String path) {
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+Sprite_Sheet* find_sprite_sheet(Sprite_Array* sprites, String name) {
+    for (int i = 0; i < sprites->sheet_count; ++i) {
+        if (string_equal(sprites->sheets[i].name, name)) return &sprites->sheets[i];
+    }
+    return 0;
+}
+
+Asset* get_asset(Asset_Handle handle) {
+    assert(handle > AH_None && handle < AH_Count);
+    return asset_manager->handles[handle];
+}
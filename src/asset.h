@@ -10,24 +10,73 @@ typedef enum Asset_Type {
     AT_Texture2d,
     AT_Font_Collection,
     AT_Mesh,
+    AT_Sprite_Array,
     AT_End,
     AT_Count = AT_End - 1,
 } Asset_Type;
 
+typedef struct Sprite_Sheet {
+    String name; // File name without the extension
+    int first_sprite;
+    int sprite_count;
+} Sprite_Sheet;
+
+// A .sprites manifest lists sprite sheets next to it that are cut into one Texture_Array. Sprites are numbered
+// left to right from the bottom row of each sheet like the sheet's own uvs. Empty sprites don't get a layer
+#define SPRITE_SHEET_CAP 16
+typedef struct Sprite_Array {
+    Texture_Array texture;
+
+    Sprite_Sheet sheets[SPRITE_SHEET_CAP];
+    int sheet_count;
+
+    s16* sprite_layers; // Layer for each sprite or -1 if it's empty
+    int sprite_count;
+} Sprite_Array;
+
 typedef struct Asset {
     String      path;
     int         flags;
     Asset_Type  type;
+    u64         last_write_time;
     union {
         Shader          shader;
         Texture2d       texture2d;
         Font_Collection font_collection;
         Mesh            mesh;
+        Sprite_Array    sprite_array;
     };
 } Asset;
 
+// Assets drawn with every frame. These are found once when the asset manager inits so the hot path never searches by path
+#define ASSET_HANDLE_DEFINITION(def) \
+def(AH_Basic2d_Shader,      AT_Shader,          "assets/shaders/basic2d") \
+def(AH_Font_Shader,         AT_Shader,          "assets/shaders/font") \
+def(AH_Sdf_Font_Shader,     AT_Shader,          "assets/shaders/sdf_font") \
+def(AH_Tile_Shader,         AT_Shader,          "assets/shaders/tile") \
+def(AH_Background_Texture,  AT_Texture2d,       "assets/textures/background") \
+def(AH_Terrain_Map_Texture, AT_Texture2d,       "assets/sprites/terrain_map") \
+def(AH_Walls_Texture,       AT_Texture2d,       "assets/sprites/walls") \
+def(AH_Tile_Sprites,        AT_Sprite_Array,    "assets/sprites/tiles") \
+def(AH_Menlo_Font,          AT_Font_Collection, "assets/fonts/Menlo-Regular")
+
+typedef enum Asset_Handle {
+    AH_None,
+#define ASSET_HANDLE_ENUM(ah, at, path) ah,
+    ASSET_HANDLE_DEFINITION(ASSET_HANDLE_ENUM)
+#undef ASSET_HANDLE_ENUM
+    AH_Count,
+} Asset_Handle;
+
 void init_asset_manager(Platform* platform);
+
+// Linear search over every asset. Use a handle for anything done every frame
 Asset* find_asset(String path);
+Asset* get_asset(Asset_Handle handle);
+
+// Unloads then loads the asset again. All memory from the old load is given back
+b32 reload_asset(Asset* asset);
+b32 reload_changed_assets(void); // True if anything was reloaded
 inline Shader* find_shader(String path) { 
     Asset* found = find_asset(path);
     if (found && found->type == AT_Shader) return &found->shader;
@@ -52,4 +101,30 @@ inline Mesh* find_mesh(String path) {
     return 0;
 }
 
-#endif /* ASSET_H */
\ No newline at end of file
+inline Shader* get_shader(Asset_Handle handle) {
+    Asset* found = get_asset(handle);
+    if (found && found->type == AT_Shader) return &found->shader;
+    return 0;
+}
+
+inline Texture2d* get_texture2d(Asset_Handle handle) {
+    Asset* found = get_asset(handle);
+    if (found && found->type == AT_Texture2d) return &found->texture2d;
+    return 0;
+}
+
+inline Font_Collection* get_font_collection(Asset_Handle handle) {
+    Asset* found = get_asset(handle);
+    if (found && found->type == AT_Font_Collection) return &found->font_collection;
+    return 0;
+}
+
+inline Sprite_Array* get_sprite_array(Asset_Handle handle) {
+    Asset* found = get_asset(handle);
+    if (found && found->type == AT_Sprite_Array) return &found->sprite_array;
+    return 0;
+}
+
+Sprite_Sheet* find_sprite_sheet(Sprite_Array* sprites, String name);
+
+#endif /* ASSET_H */
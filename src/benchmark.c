@@ -0,0 +1,619 @@
+#include "debug.h"
+
+// Benchmarks are kicked off from the debug ui and log their results. They use the heap so they
+// don't leave anything behind in the arenas
+
+static u32 benchmark_random(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Inserts the first half of keys then looks up both halves so the second half are all misses
+static void benchmark_hash_table(const char* name, Hash_Table_Func* func, u8* keys, int key_size, int count) {
+    Hash_Table ht = _make_hash_table(key_size, sizeof(int), func, heap_allocator());
+    u8* missing_keys = keys + key_size * count;
+
+    f64 start = g_platform->time_in_seconds();
+    for (int i = 0; i < count; ++i) _push_hash_table(&ht, keys + key_size * i, key_size, &i, sizeof(int));
+    f64 insert_time = g_platform->time_in_seconds() - start;
+
+    int found = 0;
+    start = g_platform->time_in_seconds();
+    for (int i = 0; i < count; ++i) found += _find_hash_table(&ht, keys + key_size * i, key_size) != 0;
+    f64 hit_time = g_platform->time_in_seconds() - start;
+
+    start = g_platform->time_in_seconds();
+    for (int i = 0; i < count; ++i) found += _find_hash_table(&ht, missing_keys + key_size * i, key_size) != 0;
+    f64 miss_time = g_platform->time_in_seconds() - start;
+
+    start = g_platform->time_in_seconds();
+    for (int i = 0; i < count; ++i) _remove_hash_table(&ht, keys + key_size * i, key_size);
+    f64 remove_time = g_platform->time_in_seconds() - start;
+
+    if (found != count) o_log_warning("[Benchmark] %s found %i of %i keys", name, found, count);
+
+    f64 to_ns = 1000000000.0 / count;
+    o_log(
+        "[Benchmark] %-16s %7i keys | insert %7.1fns | find %7.1fns | miss %7.1fns | remove %7.1fns",
+        name,
+        count,
+        insert_time * to_ns,
+        hit_time * to_ns,
+        miss_time * to_ns,
+        remove_time * to_ns
+    );
+
+    free_hash_table(&ht);
+}
+
+void run_hash_table_benchmark(void) {
+    static const int counts[] = { 1024, 16384, 131072 };
+    Allocator allocator = heap_allocator();
+
+    o_log("[Benchmark] Hash table. Times are per operation");
+
+    for (int i = 0; i < array_count(counts); ++i) {
+        int count = counts[i];
+        int key_count = count * 2;
+        u32 seed = 0x9E3779B9;
+
+        // GUI ids are a pointer truncated to an int plus a small index
+        GUI_Id* ids = mem_alloc_array(allocator, GUI_Id, key_count);
+        for (int j = 0; j < key_count; ++j) {
+            ids[j].item  = (int)(0x10000 + (j / 8) * 64);
+            ids[j].index = j % 8;
+        }
+        benchmark_hash_table("GUI_Id", hash_gui_id, (u8*)ids, sizeof(GUI_Id), count);
+        benchmark_hash_table("GUI_Id pod", hash_pod, (u8*)ids, sizeof(GUI_Id), count);
+        mem_free(allocator, ids);
+
+        Cell_Ref* refs = mem_alloc_array(allocator, Cell_Ref, key_count);
+        for (int j = 0; j < key_count; ++j) refs[j] = (Cell_Ref) { j % 1024, j / 1024 };
+        benchmark_hash_table("Cell_Ref", hash_cell_ref, (u8*)refs, sizeof(Cell_Ref), count);
+        benchmark_hash_table("Cell_Ref pod", hash_pod, (u8*)refs, sizeof(Cell_Ref), count);
+        mem_free(allocator, refs);
+
+        // Vertices on a jittered grid like an obj mesh would have
+        Mesh_Vertex* vertices = mem_alloc_array(allocator, Mesh_Vertex, key_count);
+        for (int j = 0; j < key_count; ++j) {
+            f32 jitter = (f32)(benchmark_random(&seed) & 0xFFFF) / 65535.f;
+            vertices[j] = (Mesh_Vertex) {
+                .position = v3((f32)(j % 256), (f32)(j / 256), jitter),
+                .normal   = v3(0.f, 0.f, 1.f),
+                .uv       = v2((f32)(j % 256) / 256.f, jitter),
+            };
+        }
+        benchmark_hash_table("Mesh_Vertex", hash_mesh_vertex, (u8*)vertices, sizeof(Mesh_Vertex), count);
+        benchmark_hash_table("Mesh_Vertex pod", hash_pod, (u8*)vertices, sizeof(Mesh_Vertex), count);
+        mem_free(allocator, vertices);
+
+        // Strings shaped like asset paths
+        const int path_cap = 64;
+        u8* path_memory = mem_alloc_array(allocator, u8, key_count * path_cap);
+        String* paths = mem_alloc_array(allocator, String, key_count);
+        for (int j = 0; j < key_count; ++j) {
+            u8* path = path_memory + j * path_cap;
+            int len = sprintf((char*)path, "assets/textures/sprite_%08x_%i.png", benchmark_random(&seed), j); // @CRT
+            paths[j] = (String) { path, len, allocator };
+        }
+        benchmark_hash_table("String", hash_string, (u8*)paths, sizeof(String), count);
+        mem_free(allocator, paths);
+        mem_free(allocator, path_memory);
+    }
+}
+
+typedef u64 (Benchmark_Hash_Func)(void* data, usize size);
+
+static u64 benchmark_fnv1(void* data, usize size) { return fnv1_hash(data, size); }
+static u64 benchmark_hash_bytes(void* data, usize size) { return hash_bytes(data, size); }
+
+static void benchmark_hash_function(const char* name, Benchmark_Hash_Func* func, u8* data, usize data_size) {
+    // Throughput over one big buffer
+    f64 start = g_platform->time_in_seconds();
+    u64 result = func(data, data_size);
+    f64 bulk_time = g_platform->time_in_seconds() - start;
+
+    Builder builder = make_builder(g_platform->frame_arena, 256);
+    printf_builder(&builder, "[Benchmark] %-10s %6.2fGB/s |", name, (f64)data_size / bulk_time / 1000000000.0);
+
+    // Lots of small keys back to back like a hash table sees
+    static const int key_sizes[] = { 4, 8, 16, 32, 64 };
+    for (int i = 0; i < array_count(key_sizes); ++i) {
+        int key_size = key_sizes[i];
+        int key_count = (int)(data_size / key_size);
+
+        start = g_platform->time_in_seconds();
+        for (int j = 0; j < key_count; ++j) result ^= func(data + j * key_size, key_size);
+        f64 key_time = g_platform->time_in_seconds() - start;
+
+        printf_builder(&builder, " %ib %5.2fns", key_size, key_time * 1000000000.0 / key_count);
+    }
+
+    // Printing the result keeps the hashing from being optimized out
+    printf_builder(&builder, " | %016llx", result);
+    o_log("%.*s", builder.count, (const char*)builder.data);
+}
+
+void run_hash_function_benchmark(void) {
+    usize data_size = megabyte(64);
+    u8* data = mem_alloc_array(heap_allocator(), u8, data_size);
+
+    u32 seed = 0x9E3779B9;
+    for (usize i = 0; i < data_size; ++i) data[i] = (u8)benchmark_random(&seed);
+
+    o_log("[Benchmark] Hash functions. Throughput over %llumb then time per key for small keys", data_size / megabyte(1));
+    benchmark_hash_function("fnv1", benchmark_fnv1, data, data_size);
+    benchmark_hash_function("hash_bytes", benchmark_hash_bytes, data, data_size);
+
+    mem_free(heap_allocator(), data);
+}
+
+#define RASTER_BENCHMARK_FRAMES 120
+#define RASTER_CAPTURE_PATH "captures/raster.png"
+#define RASTER_SCENE_PATH   "captures/raster_scene.png"
+#define RASTER_GOLDEN_PATH  "captures/golden/raster_scene.png"
+
+// The golden scene is the same size no matter the window so its image can be compared anywhere
+#define RASTER_SCENE_WIDTH  640
+#define RASTER_SCENE_HEIGHT 360
+
+typedef struct Raster_Benchmark {
+    Raster_Target target;
+    int frames_left;
+
+    // The first frame reads every texture back from gl so it isn't counted
+    int frame_count;
+    f64 submit_time;
+    f64 resolve_time;
+    f64 min_frame_time;
+    f64 max_frame_time;
+    s64 triangle_count;
+
+    f64 frame_start;
+    Draw_Stats gl_stats;
+} Raster_Benchmark;
+
+// On the heap across frames. The pointer doesn't survive a code reload so neither does a running benchmark
+static Raster_Benchmark* raster_benchmark = 0;
+
+void run_raster_benchmark(void) {
+    if (raster_benchmark) return;
+
+    raster_benchmark = mem_alloc_struct(heap_allocator(), Raster_Benchmark);
+    *raster_benchmark = (Raster_Benchmark) {
+        .target         = make_raster_target(g_platform->window_width, g_platform->window_height, heap_allocator()),
+        .frames_left    = RASTER_BENCHMARK_FRAMES,
+        .min_frame_time = 1000000.0,
+    };
+
+    o_log(
+        "[Benchmark] Software raster. Drawing the next %i frames at %ix%i on %i workers",
+        RASTER_BENCHMARK_FRAMES,
+        g_platform->window_width,
+        g_platform->window_height,
+        g_platform->worker_count
+    );
+}
+
+b32 wants_raster_benchmark_frame(void) { return raster_benchmark != 0; }
+
+void begin_raster_benchmark_frame(void) {
+    assert(raster_benchmark);
+
+    // The capture isn't part of the gl frame's stats
+    raster_benchmark->gl_stats = draw_state->stats;
+
+    clear_raster_target(&raster_benchmark->target, v3s(0.01f));
+    raster_benchmark->frame_start = g_platform->time_in_seconds();
+    begin_raster_capture(&raster_benchmark->target);
+}
+
+// Everything here is fixed so the same build always draws the same pixels. The live frames move with the camera and
+// the entities so they're only written out to look at. Covers each raster shading
+static void draw_raster_scene(Rect viewport) {
+    set_shader(get_shader(AH_Basic2d_Shader));
+    draw_right_handed(viewport);
+    set_uniform_texture(SU_Diffuse, *get_texture2d(AH_Background_Texture));
+    imm_begin();
+    imm_textured_rect(viewport, -10.f, v2z(), v2s(1.f), v4s(1.f));
+    imm_flush();
+
+    imm_begin();
+    imm_rect(rect_from_raw(40.f, 40.f, 280.f, 200.f), -5.f, rgba_from_hex(0x5ecf4466));
+    imm_border_rect(rect_from_raw(40.f, 40.f, 280.f, 200.f), -4.f, 4.f, rgba_from_hex(0x5ecf44ff));
+    imm_textured_circle(60.f, 32, v2(460.f, 120.f), -5.f, v2s(-1.f), v2s(-1.f), rgba_from_hex(0xcf4444aa));
+    imm_arrow(v2(340.f, 300.f), v2(600.f, 240.f), -3.f, 6.f, v4s(1.f));
+    imm_flush();
+
+    // Only the left half of this circle is inside the clip
+    begin_clip_rect(rect_from_raw(340.f, 20.f, 400.f, 200.f));
+    imm_begin();
+    imm_textured_circle(50.f, 32, v2(400.f, 100.f), -4.f, v2s(-1.f), v2s(-1.f), rgba_from_hex(0x4488cfff));
+    imm_flush();
+    end_clip_rect();
+
+    Font_Collection* collection = get_font_collection(AH_Menlo_Font);
+    if (!collection) return;
+
+    Font* font = font_at_size(collection, 24);
+    set_shader(get_shader(AH_Font_Shader));
+    draw_right_handed(viewport);
+    set_uniform_texture(SU_Atlas, glyph_atlas(font));
+    imm_begin();
+    imm_string_2d(from_cstr("Orchard raster scene"), font, 1000.f, v2(40.f, 320.f), -2.f, v4s(1.f));
+    imm_flush();
+
+    Font* sdf_font = sdf_font_at_size(collection, 48);
+    set_shader(get_shader(AH_Sdf_Font_Shader));
+    draw_right_handed(viewport);
+    set_uniform_texture(SU_Distance_Atlas, glyph_atlas(sdf_font));
+    imm_begin();
+    imm_string_2d(from_cstr("0123456789"), sdf_font, 1000.f, v2(40.f, 260.f), -2.f, v4s(1.f));
+    imm_flush();
+}
+
+// Golden images are written by this same benchmark so anything that doesn't match exactly is a change
+static void compare_raster_golden(Raster_Target* target) {
+    String path = from_cstr(RASTER_GOLDEN_PATH);
+    if (!g_platform->file_metadata(path, 0)) {
+        o_log_warning("[Benchmark] No golden image at %s so the scene wasn't compared. Copy %s there to make one", RASTER_GOLDEN_PATH, RASTER_SCENE_PATH);
+        return;
+    }
+
+    String file;
+    if (!read_file_into_string(path, &file, heap_allocator())) {
+        o_log_warning("[Benchmark] Failed to read %s", RASTER_GOLDEN_PATH);
+        return;
+    }
+
+    // Flipped so rows go bottom first like the target
+    int width, height, depth;
+    stbi_set_flip_vertically_on_load(true);
+    u8* golden = stbi_load_from_memory(expand_string(file), &width, &height, &depth, 4);
+    mem_free(heap_allocator(), file.data);
+
+    if (!golden) {
+        o_log_warning("[Benchmark] Failed to decode %s", RASTER_GOLDEN_PATH);
+        return;
+    }
+
+    if (width != target->width || height != target->height) {
+        o_log_warning("[Benchmark] Golden image is %ix%i but the capture is %ix%i", width, height, target->width, target->height);
+    } else {
+        int mismatched = 0;
+        for (int y = 0; y < height; ++y) {
+            u32* row = target->color + y * target->stride;
+            u32* golden_row = (u32*)golden + y * width;
+            for (int x = 0; x < width; ++x) mismatched += row[x] != golden_row[x];
+        }
+
+        if (mismatched) o_log_warning("[Benchmark] %i of %i pixels don't match the golden image", mismatched, width * height);
+        else o_log("[Benchmark] Matches the golden image");
+    }
+
+    stbi_image_free(golden);
+}
+
+void end_raster_benchmark_frame(void) {
+    Raster_Benchmark* benchmark = raster_benchmark;
+    Raster_Target* target = &benchmark->target;
+
+    end_raster_capture();
+    f64 submitted = g_platform->time_in_seconds();
+    int triangle_count = target->triangle_count; // Resolving starts the target over
+    resolve_raster_target(target);
+    f64 resolved = g_platform->time_in_seconds();
+
+    draw_state->stats = benchmark->gl_stats;
+
+    if (benchmark->frames_left < RASTER_BENCHMARK_FRAMES) {
+        f64 frame_time = resolved - benchmark->frame_start;
+        benchmark->submit_time  += submitted - benchmark->frame_start;
+        benchmark->resolve_time += resolved - submitted;
+        if (frame_time < benchmark->min_frame_time) benchmark->min_frame_time = frame_time;
+        if (frame_time > benchmark->max_frame_time) benchmark->max_frame_time = frame_time;
+        benchmark->triangle_count += triangle_count;
+        benchmark->frame_count += 1;
+    }
+
+    benchmark->frames_left -= 1;
+    if (benchmark->frames_left > 0) return;
+
+    if (benchmark->frame_count > 0) {
+        f64 to_ms = 1000.0 / benchmark->frame_count;
+        o_log(
+            "[Benchmark] Raster %ix%i | submit %6.3fms | resolve %6.3fms | frame avg %6.3fms min %6.3fms max %6.3fms | %lli triangles per frame",
+            target->width,
+            target->height,
+            benchmark->submit_time * to_ms,
+            benchmark->resolve_time * to_ms,
+            (benchmark->submit_time + benchmark->resolve_time) * to_ms,
+            benchmark->min_frame_time * 1000.0,
+            benchmark->max_frame_time * 1000.0,
+            benchmark->triangle_count / benchmark->frame_count
+        );
+    }
+
+    String captures_path = from_cstr("captures");
+    if (!g_platform->file_metadata(captures_path, 0)) g_platform->create_directory(captures_path);
+    if (write_png(from_cstr(RASTER_CAPTURE_PATH), target->color, target->width, target->height, target->stride)) {
+        o_log("[Benchmark] Wrote the last frame to %s", RASTER_CAPTURE_PATH);
+    } else {
+        o_log_warning("[Benchmark] Failed to write %s", RASTER_CAPTURE_PATH);
+    }
+    free_raster_target(target);
+
+    Raster_Target scene = make_raster_target(RASTER_SCENE_WIDTH, RASTER_SCENE_HEIGHT, heap_allocator());
+    clear_raster_target(&scene, v3s(0.01f));
+    begin_raster_capture(&scene);
+    draw_raster_scene((Rect) { v2z(), v2((f32)RASTER_SCENE_WIDTH, (f32)RASTER_SCENE_HEIGHT) });
+    end_raster_capture();
+    resolve_raster_target(&scene);
+
+    if (write_png(from_cstr(RASTER_SCENE_PATH), scene.color, scene.width, scene.height, scene.stride)) {
+        o_log("[Benchmark] Wrote the golden scene to %s", RASTER_SCENE_PATH);
+    } else {
+        o_log_warning("[Benchmark] Failed to write %s", RASTER_SCENE_PATH);
+    }
+    compare_raster_golden(&scene);
+    free_raster_target(&scene);
+
+    mem_free(heap_allocator(), benchmark);
+    raster_benchmark = 0;
+}
+
+#define ZOOM_BENCHMARK_STEPS 8
+#define ZOOM_BENCHMARK_STEP_FRAMES 90
+
+// Chunks reached for the first time rebuild their meshes and impostors, and gpu times come back a few frames late
+#define ZOOM_BENCHMARK_WARMUP_FRAMES 30
+
+typedef struct Zoom_Benchmark {
+    int step;
+    int step_frame;
+
+    int frame_count;
+    int lod_frames;
+    f64 tick_time;
+    f64 draw_time;
+    f64 gpu_time;
+} Zoom_Benchmark;
+
+// On the heap across frames like the raster benchmark
+static Zoom_Benchmark* zoom_benchmark = 0;
+
+static f32 zoom_benchmark_step_ortho_size(int step) {
+    return lerpf(MIN_CAMERA_ORTHO_SIZE, MAX_CAMERA_ORTHO_SIZE, (f32)step / (f32)(ZOOM_BENCHMARK_STEPS - 1));
+}
+
+void run_zoom_benchmark(void) {
+    if (zoom_benchmark) return;
+
+    zoom_benchmark = mem_alloc_struct(heap_allocator(), Zoom_Benchmark);
+    *zoom_benchmark = (Zoom_Benchmark) { 0 };
+
+    o_log(
+        "[Benchmark] Zoom. Redrawing the world for %i frames at each of %i zooms from %.0f to %.0f at %ix%i",
+        ZOOM_BENCHMARK_STEP_FRAMES,
+        ZOOM_BENCHMARK_STEPS,
+        MIN_CAMERA_ORTHO_SIZE,
+        MAX_CAMERA_ORTHO_SIZE,
+        g_platform->window_width,
+        g_platform->window_height
+    );
+}
+
+b32 get_zoom_benchmark_ortho_size(f32* ortho_size) {
+    if (!zoom_benchmark) return false;
+
+    *ortho_size = zoom_benchmark_step_ortho_size(zoom_benchmark->step);
+    return true;
+}
+
+void end_zoom_benchmark_frame(f64 tick_time, f64 draw_time, b32 drew_lod) {
+    Zoom_Benchmark* benchmark = zoom_benchmark;
+    assert(benchmark);
+
+    if (benchmark->step_frame >= ZOOM_BENCHMARK_WARMUP_FRAMES) {
+        int gpu_scope_count;
+        f64 gpu_time;
+        get_gpu_scope_times(&gpu_scope_count, &gpu_time, 0);
+
+        benchmark->tick_time += tick_time;
+        benchmark->draw_time += draw_time;
+        benchmark->gpu_time  += gpu_time;
+        if (drew_lod) benchmark->lod_frames += 1;
+        benchmark->frame_count += 1;
+    }
+
+    benchmark->step_frame += 1;
+    if (benchmark->step_frame < ZOOM_BENCHMARK_STEP_FRAMES) return;
+
+    f32 ortho_size = zoom_benchmark_step_ortho_size(benchmark->step);
+    f64 to_ms = 1000.0 / benchmark->frame_count;
+    o_log(
+        "[Benchmark] ortho %6.2f %6.2f px per cell | tick %6.3fms | draw %6.3fms | gpu %6.3fms | %s",
+        ortho_size,
+        (f32)g_platform->window_height / (ortho_size * 2.f),
+        benchmark->tick_time * to_ms,
+        benchmark->draw_time * to_ms,
+        benchmark->gpu_time * to_ms,
+        benchmark->lod_frames == benchmark->frame_count ? "lod" : (benchmark->lod_frames ? "mixed" : "full detail")
+    );
+
+    *benchmark = (Zoom_Benchmark) { .step = benchmark->step + 1 };
+    if (benchmark->step < ZOOM_BENCHMARK_STEPS) return;
+
+    mem_free(heap_allocator(), benchmark);
+    zoom_benchmark = 0;
+}
+
+// What a new font size used to cost against what the glyph cache pays the first time a size draws ascii text
+void run_glyph_cache_benchmark(void) {
+    static const int sizes[] = { 14, 21, 28, 48 };
+    Allocator allocator = heap_allocator();
+    Font_Collection* collection = get_font_collection(AH_Menlo_Font);
+    if (!collection) return;
+
+    const int atlas_size = 4096;
+    u8* atlas = mem_alloc_array(allocator, u8, atlas_size * atlas_size);
+    u8* scratch = mem_alloc_array(allocator, u8, 512 * 512);
+
+    // One codepoint for each glyph the font has, 0 for glyphs nothing maps to
+    int codepoint_count = collection->info.numGlyphs;
+    int* codepoints = mem_alloc_array(allocator, int, codepoint_count);
+    mem_set(codepoints, 0, sizeof(int) * codepoint_count);
+    for (int codepoint = 0; codepoint < CODEPOINT_PAGE_SIZE * CODEPOINT_PAGE_COUNT; ++codepoint) {
+        int glyph_index = glyph_index_from_rune(collection, codepoint);
+        if (glyph_index > 0) codepoints[glyph_index] = codepoint;
+    }
+    stbtt_packedchar* packed = mem_alloc_array(allocator, stbtt_packedchar, codepoint_count);
+
+    o_log("[Benchmark] Glyph cache. Baking every glyph into a %ix%i atlas against rasterizing printable ascii", atlas_size, atlas_size);
+
+    for (int i = 0; i < array_count(sizes); ++i) {
+        Font* font = font_at_size(collection, sizes[i]);
+
+        f64 start = g_platform->time_in_seconds();
+        stbtt_pack_context pc;
+        stbtt_pack_range pr = {
+            .font_size                   = (f32)font->size,
+            .array_of_unicode_codepoints = codepoints,
+            .num_chars                   = codepoint_count,
+            .chardata_for_range          = packed,
+        };
+        stbtt_PackBegin(&pc, atlas, atlas_size, atlas_size, 0, 1, 0);
+        stbtt_PackSetSkipMissingCodepoints(&pc, 1);
+        stbtt_PackSetOversampling(&pc, font->h_oversample, font->v_oversample);
+        stbtt_PackFontRanges(&pc, collection->info.data, 0, &pr, 1);
+        stbtt_PackEnd(&pc);
+        f64 bake_time = g_platform->time_in_seconds() - start;
+
+        // The same work cache_glyph does minus the upload
+        int area = 0;
+        start = g_platform->time_in_seconds();
+        for (Rune r = ' '; r <= '~'; ++r) {
+            int glyph_index = stbtt_FindGlyphIndex(font->info, r);
+            f32 scale_x = font->scale * (f32)font->h_oversample;
+            f32 scale_y = font->scale * (f32)font->v_oversample;
+
+            int x0, y0, x1, y1;
+            stbtt_GetGlyphBitmapBoxSubpixel(font->info, glyph_index, scale_x, scale_y, 0.f, 0.f, &x0, &y0, &x1, &y1);
+            int width  = x1 - x0 + font->h_oversample - 1;
+            int height = y1 - y0 + font->v_oversample - 1;
+            if (x1 <= x0 || y1 <= y0 || width > 512 || height > 512) continue;
+
+            f32 sub_x, sub_y;
+            mem_set(scratch, 0, width * height);
+            stbtt_MakeGlyphBitmapSubpixelPrefilter(font->info, scratch, width, height, width, scale_x, scale_y, 0.f, 0.f, font->h_oversample, font->v_oversample, &sub_x, &sub_y, glyph_index);
+            area += (width + 1) * (height + 1);
+        }
+        f64 cache_time = g_platform->time_in_seconds() - start;
+
+        o_log(
+            "[Benchmark] size %3i | bake %8.2fms %6.2fmb | cache %6.2fms %6.2fkb",
+            font->size,
+            bake_time * 1000.0,
+            (f64)(atlas_size * atlas_size) / (f64)megabyte(1),
+            cache_time * 1000.0,
+            (f64)area / 1024.0
+        );
+    }
+
+    // Distance field glyphs are made once for every size
+    {
+        int area = 0;
+        f32 scale = stbtt_ScaleForPixelHeight(&collection->info, (f32)SDF_GLYPH_SIZE);
+        f64 start = g_platform->time_in_seconds();
+        for (Rune r = ' '; r <= '~'; ++r) {
+            int glyph_index = stbtt_FindGlyphIndex(&collection->info, r);
+
+            int width, height, x_offset, y_offset;
+            u8* distances = stbtt_GetGlyphSDF(&collection->info, scale, glyph_index, SDF_PADDING, SDF_ON_EDGE, SDF_PIXEL_DIST_SCALE, &width, &height, &x_offset, &y_offset);
+            if (!distances) continue;
+
+            area += (width + 1) * (height + 1);
+            stbtt_FreeSDF(distances, 0);
+        }
+        f64 sdf_time = g_platform->time_in_seconds() - start;
+
+        o_log("[Benchmark] sdf every size | %6.2fms %6.2fkb", sdf_time * 1000.0, (f64)area / 1024.0);
+    }
+
+    mem_free(allocator, packed);
+    mem_free(allocator, codepoints);
+    mem_free(allocator, scratch);
+    mem_free(allocator, atlas);
+}
+
+// Codepoint to glyph lookups through the collection's tables against asking stbtt every time. Also what init costs
+// against probing every codepoint up front
+void run_glyph_lookup_benchmark(void) {
+    Allocator allocator = heap_allocator();
+    Font_Collection* collection = get_font_collection(AH_Menlo_Font);
+    if (!collection) return;
+
+    // Parsing the cmap against reading the tables back from the sidecar the asset load wrote
+    Font_Collection* init_collection = mem_alloc_struct(allocator, Font_Collection);
+    f64 start = g_platform->time_in_seconds();
+    init_font_collection(collection->info.data, 0, (String) { 0 }, allocator, init_collection);
+    f64 parse_time = g_platform->time_in_seconds() - start;
+    mem_free(allocator, init_collection->pages);
+
+    start = g_platform->time_in_seconds();
+    init_font_collection(collection->info.data, 0, from_cstr(FONT_CACHE_PATH "Menlo-Regular.cmap"), allocator, init_collection);
+    f64 cached_time = g_platform->time_in_seconds() - start;
+    mem_free(allocator, init_collection->pages);
+    mem_free(allocator, init_collection);
+
+    int probe_found = 0;
+    start = g_platform->time_in_seconds();
+    for (int codepoint = 0; codepoint < 0x110000; ++codepoint) probe_found += stbtt_FindGlyphIndex(&collection->info, codepoint) > 0;
+    f64 probe_time = g_platform->time_in_seconds() - start;
+
+    o_log(
+        "[Benchmark] Font init | parse %.3fms | sidecar %.3fms | probing all codepoints %.2fms (%i glyphs)",
+        parse_time * 1000.0,
+        cached_time * 1000.0,
+        probe_time * 1000.0,
+        probe_found
+    );
+
+    // Mostly ascii with some Latin-1 and a few runes from further out, roughly like real text
+    const int rune_count = 1 << 20;
+    Rune* runes = mem_alloc_array(allocator, Rune, rune_count);
+    u32 state = 0x9E3779B9;
+    for (int i = 0; i < rune_count; ++i) {
+        u32 roll = benchmark_random(&state) % 100;
+        u32 r = benchmark_random(&state);
+        if (roll < 90)      runes[i] = ' ' + r % 95;
+        else if (roll < 98) runes[i] = 0xA0 + r % 96;
+        else                runes[i] = 0x100 + r % 0x2F00;
+    }
+
+    // Pages are filled on first use. That's paid once so it's left out
+    for (int i = 0; i < rune_count; ++i) glyph_index_from_rune(collection, runes[i]);
+
+    int stbtt_sum = 0;
+    start = g_platform->time_in_seconds();
+    for (int i = 0; i < rune_count; ++i) stbtt_sum += stbtt_FindGlyphIndex(&collection->info, runes[i]);
+    f64 stbtt_time = g_platform->time_in_seconds() - start;
+
+    int table_sum = 0;
+    start = g_platform->time_in_seconds();
+    for (int i = 0; i < rune_count; ++i) table_sum += glyph_index_from_rune(collection, runes[i]);
+    f64 table_time = g_platform->time_in_seconds() - start;
+
+    o_log(
+        "[Benchmark] Glyph lookups | stbtt %8.2fm/s | table %8.2fm/s | %s",
+        (f64)rune_count / stbtt_time / 1000000.0,
+        (f64)rune_count / table_time / 1000000.0,
+        stbtt_sum == table_sum ? "match" : "MISMATCH"
+    );
+
+    mem_free(allocator, runes);
+}
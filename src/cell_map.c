@@ -0,0 +1,424 @@
+#include "cell_map.h"
+
+static Cell_Map_Renderer* cell_map_renderer = 0;
+
+static const f32 layer_z[CML_Count] = { -5.f, -4.f };
+static const char* layer_sheet_names[CML_Count] = { "terrain_map", "walls" };
+
+void init_cell_map(Platform* platform) {
+    cell_map_renderer = mem_alloc_struct(platform->permanent_arena, Cell_Map_Renderer);
+
+    // The GL objects survive a code reload so only the first init creates them
+    if (cell_map_renderer->is_initialized) return;
+    cell_map_renderer->is_initialized = true;
+
+    for (int i = 0; i < CHUNK_CAP; ++i) {
+        Chunk_Mesh* mesh = &cell_map_renderer->meshes[i];
+
+        glGenVertexArrays(1, &mesh->vao);
+        glBindVertexArray(mesh->vao);
+
+        glGenBuffers(1, &mesh->vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+
+        GLuint xy_loc = 0;
+        glVertexAttribIPointer(xy_loc, 2, GL_UNSIGNED_SHORT, sizeof(Tile_Instance), 0);
+        glVertexAttribDivisor(xy_loc, 1);
+        glEnableVertexAttribArray(xy_loc);
+
+        GLuint layer_loc = 1;
+        glVertexAttribIPointer(layer_loc, 1, GL_UNSIGNED_SHORT, sizeof(Tile_Instance), (void*)(sizeof(u16) * 2));
+        glVertexAttribDivisor(layer_loc, 1);
+        glEnableVertexAttribArray(layer_loc);
+
+        GLuint cell_map_layer_flags_loc = 2;
+        glVertexAttribIPointer(cell_map_layer_flags_loc, 2, GL_UNSIGNED_BYTE, sizeof(Tile_Instance), (void*)(sizeof(u16) * 3));
+        glVertexAttribDivisor(cell_map_layer_flags_loc, 1);
+        glEnableVertexAttribArray(cell_map_layer_flags_loc);
+    }
+
+    // sRGB so blending while drawing the impostors and filtering them both happen in linear like the tiles on screen
+    GLuint impostor_texture;
+    glGenTextures(1, &impostor_texture);
+    glBindTexture(GL_TEXTURE_2D, impostor_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, IMPOSTOR_TEXTURE_SIZE, IMPOSTOR_TEXTURE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    cell_map_renderer->impostors = (Texture2d) {
+        .width  = IMPOSTOR_TEXTURE_SIZE,
+        .height = IMPOSTOR_TEXTURE_SIZE,
+        .depth  = 4,
+        .id     = impostor_texture,
+    };
+
+    glGenFramebuffers(1, &cell_map_renderer->impostor_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, cell_map_renderer->impostor_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, impostor_texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) o_log_error("[Cell Map] Impostor framebuffer is incomplete");
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenFramebuffers(array_count(cell_map_renderer->impostor_mip_framebuffers), cell_map_renderer->impostor_mip_framebuffers);
+}
+
+b32 should_draw_lod(Controller* controller) {
+    f32 pixels_per_cell = (f32)g_platform->window_height / (controller->current_ortho_size * 2.f);
+    return pixels_per_cell < LOD_PIXELS_PER_CELL;
+}
+
+static b32 find_cell_sprite(Cell* cell, Cell_Map_Layer layer, int* sprite_index) {
+    switch (layer) {
+    case CML_Floor:
+        if (cell->floor_type == CFT_None && !cell_map_renderer->floor_shows_empty) return false;
+        *sprite_index = cell->floor_type;
+        break;
+    case CML_Walls:
+        if (cell->content != CC_Wall) return false;
+        *sprite_index = cell->wall.visual;
+        break;
+    default: invalid_code_path;
+    }
+    assert(*sprite_index >= 0 && *sprite_index <= 0xFF);
+    return true;
+}
+
+static void build_chunk_mesh(Chunk_Mesh* mesh, Chunk* chunk, int chunk_index, Sprite_Array* sprites) {
+    Temp_Memory temp_memory = begin_temp_memory(g_platform->frame_arena);
+    Tile_Instance* instances = mem_alloc_array(g_platform->frame_arena, Tile_Instance, CELLS_PER_CHUNK * CML_Count);
+    int instance_count = 0;
+
+    int chunk_y = chunk_index / WORLD_SIZE;
+    int chunk_x = chunk_index - chunk_y * WORLD_SIZE;
+
+    for (int layer = 0; layer < CML_Count; ++layer) {
+        Sprite_Sheet* sheet = find_sprite_sheet(sprites, from_cstr(layer_sheet_names[layer]));
+        if (!sheet) continue;
+
+        for (int x = 0; x < CHUNK_SIZE; ++x) {
+            for (int y = 0; y < CHUNK_SIZE; ++y) {
+                Cell* cell = &chunk->cells[x + y * CHUNK_SIZE];
+
+                int sprite_index;
+                if (!find_cell_sprite(cell, layer, &sprite_index)) continue;
+                if (sprite_index >= sheet->sprite_count) continue;
+
+                int sprite_layer = sprites->sprite_layers[sheet->first_sprite + sprite_index];
+                if (sprite_layer < 0) continue;
+
+                instances[instance_count++] = (Tile_Instance) {
+                    .x              = (u16)(chunk_x * CHUNK_SIZE + x),
+                    .y              = (u16)(chunk_y * CHUNK_SIZE + y),
+                    .layer          = (u16)sprite_layer,
+                    .cell_map_layer = (u8)layer,
+                };
+            }
+        }
+    }
+
+    mesh->instance_count = instance_count;
+    mesh->is_built = true;
+    mesh->impostor_is_stale = true;
+
+    glBindVertexArray(mesh->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Tile_Instance) * instance_count, instances, GL_DYNAMIC_DRAW);
+
+    end_temp_memory(temp_memory);
+}
+
+// The tile shader has no cpu version so captures draw every tile as an imm rect out of the sprite sheets instead. Meshes
+// and stats are left alone so the frame after looks the same as before
+static void draw_cell_map_imm(Entity_Manager* em, Controller* controller) {
+    Texture2d* maps[CML_Count] = {
+        get_texture2d(AH_Terrain_Map_Texture),
+        get_texture2d(AH_Walls_Texture),
+    };
+
+    set_shader(get_shader(AH_Basic2d_Shader));
+    draw_from(controller->location, controller->current_ortho_size);
+
+    Rect viewport_in_world_space = get_viewport_in_world_space(controller);
+
+    for (int layer = 0; layer < CML_Count; ++layer) {
+        Texture2d* map = maps[layer];
+        f32 map_width = (f32)map->width;
+        int sprites_per_row = map->width / PIXELS_PER_METER;
+        f32 sprite_size = PIXELS_PER_METER / map_width;
+        f32 inset = 1.f / map_width / 4.f;
+        set_uniform_texture(SU_Diffuse, *map);
+
+        imm_begin();
+        for (int i = 0; i < CHUNK_CAP; ++i) {
+            Chunk* chunk = &em->chunks[i];
+
+            int chunk_y = i / WORLD_SIZE;
+            int chunk_x = i - chunk_y * WORLD_SIZE;
+
+            Vector2 min = v2((f32)chunk_x * CHUNK_SIZE, (f32)chunk_y * CHUNK_SIZE);
+            Vector2 max = v2_add(min, v2(CHUNK_SIZE, CHUNK_SIZE));
+            Rect chunk_rect = { min, max };
+            if (!rect_overlaps_rect(viewport_in_world_space, chunk_rect, 0)) continue;
+
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                for (int y = 0; y < CHUNK_SIZE; ++y) {
+                    Cell* cell = &chunk->cells[x + y * CHUNK_SIZE];
+
+                    int sprite_index;
+                    if (!find_cell_sprite(cell, layer, &sprite_index)) continue;
+
+                    Vector2 sprite_xy = v2((f32)(sprite_index % sprites_per_row), (f32)(sprite_index / sprites_per_row));
+                    Vector2 uv0 = v2_add(v2_mul(sprite_xy, v2s(sprite_size)), v2s(inset));
+                    Vector2 uv1 = v2_mul(v2_add(sprite_xy, v2s(1.f)), v2s(sprite_size));
+
+                    Vector2 cell_min = v2_add(min, v2((f32)x, (f32)y));
+                    Rect cell_rect = { cell_min, v2_add(cell_min, v2s(1.f)) };
+                    imm_textured_rect(cell_rect, layer_z[layer], uv0, uv1, v4s(1.f));
+                }
+            }
+        }
+        imm_flush();
+    }
+}
+
+static Rect chunk_rect_from_index(int chunk_index) {
+    int chunk_y = chunk_index / WORLD_SIZE;
+    int chunk_x = chunk_index - chunk_y * WORLD_SIZE;
+
+    Vector2 min = v2((f32)chunk_x * CHUNK_SIZE, (f32)chunk_y * CHUNK_SIZE);
+    Vector2 max = v2_add(min, v2(CHUNK_SIZE, CHUNK_SIZE));
+    return (Rect) { min, max };
+}
+
+// Blits each mip level of one chunk's impostor down from the level above. Past the level where a chunk is one texel
+// it takes its neighbours with it, which is what generating the whole chain would have done there too
+static void update_impostor_mips(int chunk_index) {
+    GLuint read_framebuffer = cell_map_renderer->impostor_mip_framebuffers[0];
+    GLuint draw_framebuffer = cell_map_renderer->impostor_mip_framebuffers[1];
+    GLuint texture = cell_map_renderer->impostors.id;
+
+    Rect chunk_rect = chunk_rect_from_index(chunk_index);
+    GLint x0 = (GLint)chunk_rect.min.x * IMPOSTOR_PIXELS_PER_CELL;
+    GLint y0 = (GLint)chunk_rect.min.y * IMPOSTOR_PIXELS_PER_CELL;
+    GLint x1 = x0 + IMPOSTOR_CHUNK_PIXELS;
+    GLint y1 = y0 + IMPOSTOR_CHUNK_PIXELS;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_framebuffer);
+    for (int level = 1; (IMPOSTOR_TEXTURE_SIZE >> level) > 0; ++level) {
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, level - 1);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, level);
+
+        // Rounded out to whole texels of this level
+        GLint scale = 1 << level;
+        GLint dst_x0 = x0 / scale;
+        GLint dst_y0 = y0 / scale;
+        GLint dst_x1 = (x1 + scale - 1) / scale;
+        GLint dst_y1 = (y1 + scale - 1) / scale;
+
+        // Halving with linear filtering averages each 2x2 block
+        glBlitFramebuffer(
+            dst_x0 * 2, dst_y0 * 2, dst_x1 * 2, dst_y1 * 2,
+            dst_x0, dst_y0, dst_x1, dst_y1,
+            GL_COLOR_BUFFER_BIT, GL_LINEAR
+        );
+    }
+}
+
+// Past this many redrawn impostors one pass over the whole mip chain is cheaper than blitting each chunk's
+#define IMPOSTOR_MIP_BLIT_CAP (CHUNK_CAP / 4)
+
+// Visible chunks get their impostor redrawn if their mesh changed since then. Expects the tile shader to be bound
+static void draw_stale_impostors(Entity_Manager* em, Rect viewport_in_world_space, Sprite_Array* sprites) {
+    begin_gpu_scope("Impostors");
+
+    // This can be drawn from inside a draw layer so whatever was bound is put back after, blending included
+    GLint last_framebuffer;
+    GLint last_viewport[4];
+    GLint last_blend[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &last_framebuffer);
+    glGetIntegerv(GL_VIEWPORT, last_viewport);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &last_blend[0]);
+    glGetIntegerv(GL_BLEND_DST_RGB, &last_blend[1]);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &last_blend[2]);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &last_blend[3]);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, cell_map_renderer->impostor_framebuffer);
+    glEnable(GL_SCISSOR_TEST);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+
+    // Alpha is kept as coverage so empty cells stay see through
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    int redrawn_chunks[IMPOSTOR_MIP_BLIT_CAP];
+    for (int i = 0; i < CHUNK_CAP; ++i) {
+        Chunk* chunk = &em->chunks[i];
+        Rect chunk_rect = chunk_rect_from_index(i);
+        if (!rect_overlaps_rect(viewport_in_world_space, chunk_rect, 0)) continue;
+
+        Chunk_Mesh* mesh = &cell_map_renderer->meshes[i];
+        int dirty_flags = CDF_Floor | CDF_Walls;
+        if ((chunk->dirty_flags & dirty_flags) || !mesh->is_built) {
+            build_chunk_mesh(mesh, chunk, i, sprites);
+            chunk->dirty_flags &= ~dirty_flags;
+            cell_map_renderer->chunks_rebuilt += 1;
+        }
+        if (!mesh->impostor_is_stale) continue;
+
+        GLint x = (GLint)chunk_rect.min.x * IMPOSTOR_PIXELS_PER_CELL;
+        GLint y = (GLint)chunk_rect.min.y * IMPOSTOR_PIXELS_PER_CELL;
+        glViewport(x, y, IMPOSTOR_CHUNK_PIXELS, IMPOSTOR_CHUNK_PIXELS);
+        glScissor(x, y, IMPOSTOR_CHUNK_PIXELS, IMPOSTOR_CHUNK_PIXELS);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        if (mesh->instance_count > 0) {
+            Vector2 center = v2_add(chunk_rect.min, v2s(CHUNK_SIZE / 2.f));
+            draw_ortho(v3xy(center, 0.f), quat_identity, 1.f, CHUNK_SIZE / 2.f);
+
+            glBindVertexArray(mesh->vao);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, mesh->instance_count);
+            draw_state->stats.num_draw_calls += 1;
+            draw_state->stats.vertices_drawn += mesh->instance_count * 6;
+        }
+
+        mesh->impostor_is_stale = false;
+        if (cell_map_renderer->impostors_redrawn < IMPOSTOR_MIP_BLIT_CAP) redrawn_chunks[cell_map_renderer->impostors_redrawn] = i;
+        cell_map_renderer->impostors_redrawn += 1;
+    }
+
+    glBlendFuncSeparate((GLenum)last_blend[0], (GLenum)last_blend[1], (GLenum)last_blend[2], (GLenum)last_blend[3]);
+    glDisable(GL_SCISSOR_TEST);
+
+    // Editing a few cells while zoomed out only updates their chunks' part of each mip level
+    int impostors_redrawn = cell_map_renderer->impostors_redrawn;
+    if (impostors_redrawn > IMPOSTOR_MIP_BLIT_CAP) {
+        glBindTexture(GL_TEXTURE_2D, cell_map_renderer->impostors.id);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    } else {
+        for (int i = 0; i < impostors_redrawn; ++i) update_impostor_mips(redrawn_chunks[i]);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)last_framebuffer);
+    glViewport(last_viewport[0], last_viewport[1], last_viewport[2], last_viewport[3]);
+    end_gpu_scope();
+}
+
+// Every visible chunk is one quad out of the impostor texture so the cost doesn't grow with the cells on screen
+static void draw_cell_map_lod(Entity_Manager* em, Controller* controller, Sprite_Array* sprites) {
+    Rect viewport_in_world_space = get_viewport_in_world_space(controller);
+
+    set_shader(get_shader(AH_Tile_Shader));
+    set_uniform_texture_array(SU_Sprites, sprites->texture);
+    set_uniform_v4(SU_Layer_Z, v4(layer_z[CML_Floor], layer_z[CML_Walls], 0.f, 0.f));
+    draw_stale_impostors(em, viewport_in_world_space, sprites);
+
+    set_shader(get_shader(AH_Basic2d_Shader));
+    draw_from(controller->location, controller->current_ortho_size);
+    set_uniform_texture(SU_Diffuse, cell_map_renderer->impostors);
+
+    f32 texel_per_cell = (f32)IMPOSTOR_PIXELS_PER_CELL / (f32)IMPOSTOR_TEXTURE_SIZE;
+
+    imm_begin();
+    for (int i = 0; i < CHUNK_CAP; ++i) {
+        Rect chunk_rect = chunk_rect_from_index(i);
+        if (!rect_overlaps_rect(viewport_in_world_space, chunk_rect, 0)) continue;
+        if (cell_map_renderer->meshes[i].instance_count == 0) continue;
+
+        Vector2 uv0 = v2_mul(chunk_rect.min, v2s(texel_per_cell));
+        Vector2 uv1 = v2_mul(chunk_rect.max, v2s(texel_per_cell));
+        imm_textured_rect(chunk_rect, layer_z[CML_Floor], uv0, uv1, v4s(1.f));
+        cell_map_renderer->chunks_drawn += 1;
+    }
+    imm_flush();
+}
+
+b32 is_cell_map_stale(Entity_Manager* em, Controller* controller) {
+    if ((controller->mode == CM_Set_Cell) != cell_map_renderer->floor_shows_empty) return true;
+
+    Rect viewport_in_world_space = get_viewport_in_world_space(controller);
+    b32 draws_lod = should_draw_lod(controller);
+
+    for (int i = 0; i < CHUNK_CAP; ++i) {
+        if (!rect_overlaps_rect(viewport_in_world_space, chunk_rect_from_index(i), 0)) continue;
+
+        Chunk_Mesh* mesh = &cell_map_renderer->meshes[i];
+        if ((em->chunks[i].dirty_flags & (CDF_Floor | CDF_Walls)) || !mesh->is_built) return true;
+        if (draws_lod && mesh->impostor_is_stale) return true;
+    }
+    return false;
+}
+
+void draw_cell_map(Entity_Manager* em, Controller* controller) {
+    // Floors only show empty cells while placing them so switching modes changes every chunk
+    b32 floor_shows_empty = controller->mode == CM_Set_Cell;
+    if (floor_shows_empty != cell_map_renderer->floor_shows_empty) {
+        cell_map_renderer->floor_shows_empty = floor_shows_empty;
+        for (int i = 0; i < CHUNK_CAP; ++i) em->chunks[i].dirty_flags |= CDF_Floor;
+    }
+
+    if (is_raster_capturing()) {
+        draw_cell_map_imm(em, controller);
+        return;
+    }
+
+    cell_map_renderer->chunks_drawn = 0;
+    cell_map_renderer->chunks_rebuilt = 0;
+    cell_map_renderer->impostors_redrawn = 0;
+    cell_map_renderer->drew_impostors = false;
+
+    Sprite_Array* sprites = get_sprite_array(AH_Tile_Sprites);
+    if (!sprites) return;
+
+    // Chunks are drawn straight away so anything queued before has to go first
+    flush_render_commands();
+
+    // Impostors are redrawn inside this scope when zoomed out. Their quads are queued so they land in Commands
+    begin_gpu_scope("Chunks");
+    if (should_draw_lod(controller)) {
+        draw_cell_map_lod(em, controller, sprites);
+        cell_map_renderer->drew_impostors = true;
+        end_gpu_scope();
+        return;
+    }
+
+    set_shader(get_shader(AH_Tile_Shader));
+    draw_from(controller->location, controller->current_ortho_size);
+
+    // Every layer samples the same array so nothing is rebound between chunks
+    set_uniform_texture_array(SU_Sprites, sprites->texture);
+    set_uniform_v4(SU_Layer_Z, v4(layer_z[CML_Floor], layer_z[CML_Walls], 0.f, 0.f));
+
+    Rect viewport_in_world_space = get_viewport_in_world_space(controller);
+
+    for (int i = 0; i < CHUNK_CAP; ++i) {
+        Chunk* chunk = &em->chunks[i];
+
+        Rect chunk_rect = chunk_rect_from_index(i);
+
+        // Off screen chunks stay dirty until they're seen
+        if (!rect_overlaps_rect(viewport_in_world_space, chunk_rect, 0)) continue;
+
+        Chunk_Mesh* mesh = &cell_map_renderer->meshes[i];
+        int dirty_flags = CDF_Floor | CDF_Walls;
+        if ((chunk->dirty_flags & dirty_flags) || !mesh->is_built) {
+            build_chunk_mesh(mesh, chunk, i, sprites);
+            chunk->dirty_flags &= ~dirty_flags;
+            cell_map_renderer->chunks_rebuilt += 1;
+        }
+
+        if (mesh->instance_count == 0) continue;
+
+        f64 start_time = g_platform->time_in_seconds();
+
+        glBindVertexArray(mesh->vao);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, mesh->instance_count);
+
+        draw_state->stats.draw_call_duration += g_platform->time_in_seconds() - start_time;
+        draw_state->stats.num_draw_commands += 1;
+        draw_state->stats.num_draw_calls += 1;
+        draw_state->stats.vertices_drawn += mesh->instance_count * 6;
+        cell_map_renderer->chunks_drawn += 1;
+    }
+    end_gpu_scope();
+}
@@ -0,0 +1,65 @@
+#ifndef CELL_MAP_H
+#define CELL_MAP_H
+
+#include "controller.h"
+#include "opengl.h"
+
+#define PIXELS_PER_METER 32
+
+typedef enum Cell_Map_Layer {
+    CML_Floor,
+    CML_Walls,
+
+    CML_Count,
+} Cell_Map_Layer;
+
+// A tile is expanded into a quad by assets/shaders/tile.glsl so this is all that's uploaded per cell
+typedef struct Tile_Instance {
+    u16 x, y;
+    u16 layer; // In the tile sprite array
+    u8 cell_map_layer; // Picks the z
+    u8 flags; // Unused for now
+} Tile_Instance;
+
+typedef struct Chunk_Mesh {
+    GLuint vao, vbo;
+    int instance_count;
+    b32 is_built;
+    b32 impostor_is_stale; // Set whenever the mesh is rebuilt
+} Chunk_Mesh;
+
+// Zoomed out past LOD_PIXELS_PER_CELL every chunk is one quad out of an impostor drawn from its mesh. The impostors
+// are laid out like the world in one mipmapped texture so neighbouring chunks filter into each other
+#define LOD_PIXELS_PER_CELL 10.f
+#define IMPOSTOR_PIXELS_PER_CELL 8
+#define IMPOSTOR_CHUNK_PIXELS (CHUNK_SIZE * IMPOSTOR_PIXELS_PER_CELL)
+#define IMPOSTOR_TEXTURE_SIZE (WORLD_SIZE * IMPOSTOR_CHUNK_PIXELS)
+
+typedef struct Cell_Map_Renderer {
+    Chunk_Mesh meshes[CHUNK_CAP]; // Every layer's tiles. Floors go first so walls blend over them
+
+    // Changes which cells have a floor tile. If this changes every floor is rebuilt
+    b32 floor_shows_empty;
+
+    GLuint impostor_framebuffer;
+    GLuint impostor_mip_framebuffers[2]; // Read and draw. A redrawn impostor's mips are blitted down one level at a time
+    Texture2d impostors;
+
+    int chunks_drawn;
+    int chunks_rebuilt;
+    int impostors_redrawn;
+    b32 drew_impostors;
+
+    b32 is_initialized;
+} Cell_Map_Renderer;
+
+void init_cell_map(Platform* platform);
+
+// Builds any dirty visible chunk meshes then draws each visible chunk with one draw call, or one impostor quad when zoomed out
+void draw_cell_map(Entity_Manager* em, Controller* controller);
+b32 is_cell_map_stale(Entity_Manager* em, Controller* controller); // True if draw_cell_map would draw anything differently
+
+// Cells are small enough on screen that the world is drawn with less detail
+b32 should_draw_lod(Controller* controller);
+
+#endif /* CELL_MAP_H */
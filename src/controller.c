@@ -8,6 +8,7 @@ Controller* make_controller(Entity_Manager* em, Vector2 location, f32 ortho_size
     result->location = location;
     result->current_ortho_size = ortho_size;
     result->target_ortho_size  = ortho_size;
+    refresh_entity_chunk(em, &result->base);
     return result;
 }
 
@@ -62,6 +63,7 @@ static void tick_controller(Entity_Manager* em, Entity* entity, f32 dt) {
 
     if (is_key_pressed(KEY_D) || is_key_pressed(KEY_RIGHT)) controller->location.x += controller_move_speed * dt * ratio;
     if (is_key_pressed(KEY_A) || is_key_pressed(KEY_LEFT))  controller->location.x -= controller_move_speed * dt * ratio;
+    refresh_entity_chunk(em, entity);
 
     if (is_hovering_widget()) return;
     
@@ -70,6 +72,7 @@ static void tick_controller(Entity_Manager* em, Entity* entity, f32 dt) {
         f32 speed = ratio;
 
         controller->location = v2_add(controller->location, v2_mul(v2_inverse(mouse_delta), v2s(speed)));
+        refresh_entity_chunk(em, entity);
     }
 
     // Cell Mode
@@ -103,7 +106,10 @@ static void tick_controller(Entity_Manager* em, Entity* entity, f32 dt) {
             for (int x = start_x; x < end_x; ++x) {
                 for (int y = start_y; y < end_y; ++y) {
                     Cell* cell = find_cell_at(em, x, y);
-                    if (cell) cell->floor_type = CFT_Steel_Panel;
+                    if (cell) {
+                        cell->floor_type = CFT_Steel_Panel;
+                        mark_cell_dirty(em, x, y, CDF_Floor);
+                    }
                 }
             }
         } break;
@@ -15,8 +15,10 @@ typedef struct Controller_Selection {
     Vector2 current;
 } Controller_Selection;
 
-#define MAX_CAMERA_ORTHO_SIZE 35.f
+// Zoomed all the way out the whole world fits the window's height
+#define MAX_CAMERA_ORTHO_SIZE ((WORLD_SIZE * CHUNK_SIZE) / 2.f)
 #define MIN_CAMERA_ORTHO_SIZE 5.f
+#define START_CAMERA_ORTHO_SIZE 35.f
 typedef struct Controller {
     DEFINE_CHILD_ENTITY;
     f32 current_ortho_size;
@@ -78,9 +78,149 @@ void init_debug(Platform* platform) {
     if (g_debug_state->is_initialized) return;
 }
 
+#if ALLOCATION_TRACKING
+static const char* file_basename(const char* path) {
+    const char* result = path;
+    for (const char* at = path; *at; ++at) {
+        if (*at == '/' || *at == '\\') result = at + 1;
+    }
+    return result;
+}
+
+static void dump_allocations_csv(void) {
+    System_Time time = g_platform->local_time();
+
+    char path[2048];
+    sprintf(path, "%sallocations_%02u_%02u_%04u_%02u_%02u_%02u.csv", LOGS_PATH, time.month, time.day_of_month, time.year, time.hour, time.minute, time.second);
+
+    File_Handle file;
+    if (!g_platform->open_file(from_cstr(path), FF_Write | FF_Create, &file)) {
+        o_log_error("[Debug] Failed to open %s to dump allocations", path);
+        return;
+    }
+
+    Builder builder = make_builder(g_platform->frame_arena, 4096);
+    printf_builder(&builder, "allocator,file,line,current,peak,total,alloc_count,free_count\n");
+    for (int i = 0; i < g_allocation_tracker_count; ++i) {
+        Allocation_Tracker* tracker = g_allocation_trackers[i];
+        for (int j = 0; j < ALLOCATION_SITE_CAP; ++j) {
+            Allocation_Site* site = &tracker->sites[j];
+            if (!site->file) continue;
+
+            Allocation_Stats stats = site->stats;
+            printf_builder(&builder, "%s,%s,%i,%llu,%llu,%llu,%i,%i\n", tracker->name, file_basename(site->file), site->line, stats.current, stats.peak, stats.total, stats.alloc_count, stats.free_count);
+        }
+    }
+
+    g_platform->write_file(file, builder.data, builder.count);
+    g_platform->close_file(&file);
+    o_log("[Debug] Dumped allocations to %s", path);
+}
+
+#define ALLOCATION_TOP_SITES 4
+
+static void do_allocations_ui(void) {
+    for (int i = 0; i < g_allocation_tracker_count; ++i) {
+        Allocation_Tracker* tracker = g_allocation_trackers[i];
+        Allocation_Stats stats = tracker->stats;
+
+        Builder builder = make_builder(g_platform->frame_arena, 256);
+        printf_builder(&builder, "%s: ", tracker->name);
+        bytes_to_string_builder(&builder, stats.current);
+        printf_builder(&builder, " (peak ");
+        bytes_to_string_builder(&builder, stats.peak);
+        printf_builder(&builder, ") %i allocs %i frees", stats.alloc_count, stats.free_count);
+        if (tracker->dropped_count) printf_builder(&builder, " %i untracked", tracker->dropped_count);
+        gui_label(builder_to_string(builder));
+
+        // Show the sites holding the most memory right now
+        int top[ALLOCATION_TOP_SITES];
+        int top_count = 0;
+        for (int j = 0; j < ALLOCATION_SITE_CAP; ++j) {
+            Allocation_Site* site = &tracker->sites[j];
+            if (!site->file) continue;
+
+            int insert = top_count;
+            while (insert > 0 && tracker->sites[top[insert - 1]].stats.current < site->stats.current) insert -= 1;
+            if (insert >= ALLOCATION_TOP_SITES) continue;
+
+            if (top_count < ALLOCATION_TOP_SITES) top_count += 1;
+            for (int k = top_count - 1; k > insert; --k) top[k] = top[k - 1];
+            top[insert] = j;
+        }
+
+        for (int j = 0; j < top_count; ++j) {
+            Allocation_Site* site = &tracker->sites[top[j]];
+
+            builder = make_builder(g_platform->frame_arena, 256);
+            printf_builder(&builder, "    %s(%i): ", file_basename(site->file), site->line);
+            bytes_to_string_builder(&builder, site->stats.current);
+            printf_builder(&builder, " in %i allocs", site->stats.alloc_count - site->stats.free_count);
+            gui_label(builder_to_string(builder));
+        }
+    }
+}
+#endif
+
 void do_debug_ui(void) {
     gui_col_layout_size(24.f * g_platform->dpi_scale, true) {
         gui_label_printf("Show Pathfind Debug");
         gui_checkbox(gui_id_from_ptr_index(g_debug_state, 0), &g_debug_state->draw_pathfinding);
     }
+
+    gui_col_layout_size(24.f * g_platform->dpi_scale, true) {
+        gui_label_printf("Half Resolution World Layer");
+        gui_checkbox(gui_id_from_ptr_index(g_debug_state, 8), &g_debug_state->half_res_world_layer);
+    }
+
+    gui_col_layout_size(24.f * g_platform->dpi_scale, true) {
+        b32 run = false;
+        gui_label_printf("Run Hash Table Benchmark");
+        if (gui_checkbox(gui_id_from_ptr_index(g_debug_state, 3), &run)) run_hash_table_benchmark();
+    }
+
+    gui_col_layout_size(24.f * g_platform->dpi_scale, true) {
+        b32 run = false;
+        gui_label_printf("Run Hash Function Benchmark");
+        if (gui_checkbox(gui_id_from_ptr_index(g_debug_state, 4), &run)) run_hash_function_benchmark();
+    }
+
+    gui_col_layout_size(24.f * g_platform->dpi_scale, true) {
+        b32 run = false;
+        gui_label_printf("Run Software Raster Benchmark");
+        if (gui_checkbox(gui_id_from_ptr_index(g_debug_state, 5), &run)) run_raster_benchmark();
+    }
+
+    gui_col_layout_size(24.f * g_platform->dpi_scale, true) {
+        b32 run = false;
+        gui_label_printf("Run Glyph Cache Benchmark");
+        if (gui_checkbox(gui_id_from_ptr_index(g_debug_state, 6), &run)) run_glyph_cache_benchmark();
+    }
+
+    gui_col_layout_size(24.f * g_platform->dpi_scale, true) {
+        b32 run = false;
+        gui_label_printf("Run Glyph Lookup Benchmark");
+        if (gui_checkbox(gui_id_from_ptr_index(g_debug_state, 7), &run)) run_glyph_lookup_benchmark();
+    }
+
+    gui_col_layout_size(24.f * g_platform->dpi_scale, true) {
+        b32 run = false;
+        gui_label_printf("Run Zoom Benchmark");
+        if (gui_checkbox(gui_id_from_ptr_index(g_debug_state, 9), &run)) run_zoom_benchmark();
+    }
+
+#if ALLOCATION_TRACKING
+    gui_col_layout_size(24.f * g_platform->dpi_scale, true) {
+        gui_label_printf("Show Allocations");
+        gui_checkbox(gui_id_from_ptr_index(g_debug_state, 1), &g_debug_state->show_allocations);
+    }
+
+    gui_col_layout_size(24.f * g_platform->dpi_scale, true) {
+        b32 dump = false;
+        gui_label_printf("Dump Allocations CSV");
+        if (gui_checkbox(gui_id_from_ptr_index(g_debug_state, 2), &dump)) dump_allocations_csv();
+    }
+
+    if (g_debug_state->show_allocations) do_allocations_ui();
+#endif
 }
\ No newline at end of file
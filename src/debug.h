@@ -21,6 +21,8 @@ void shutdown_logger(void);
 
 typedef struct Debug_State {
     b32 draw_pathfinding;
+    b32 show_allocations;
+    b32 half_res_world_layer;
 
     b32 is_initialized;
 } Debug_State;
@@ -30,4 +32,23 @@ extern Debug_State* g_debug_state;
 void init_debug(Platform* platform);
 void do_debug_ui(void);
 
+// See benchmark.c
+void run_hash_table_benchmark(void);
+void run_hash_function_benchmark(void);
+void run_glyph_cache_benchmark(void);
+void run_glyph_lookup_benchmark(void);
+
+// The software raster benchmark draws the world into a cpu target alongside the next frames. The game asks each
+// frame if it wants one and draws the world again between begin and end
+void run_raster_benchmark(void);
+b32 wants_raster_benchmark_frame(void);
+void begin_raster_benchmark_frame(void);
+void end_raster_benchmark_frame(void);
+
+// The zoom benchmark holds the camera at steps from the closest zoom to the furthest and logs what the frames cost at
+// each. The game asks each frame for the zoom to draw at and reports the frame after drawing it
+void run_zoom_benchmark(void);
+b32 get_zoom_benchmark_ortho_size(f32* ortho_size);
+void end_zoom_benchmark_frame(f64 tick_time, f64 draw_time, b32 drew_lod);
+
 #endif /* DEBUG_H */
\ No newline at end of file
@@ -11,6 +11,27 @@
 #define STB_TRUETYPE_IMPLEMENTATION
 #include <stb/stb_truetype.h>
 
+typedef struct Draw_Stats {
+    int num_draw_commands; // Draws asked for before merging
+    int num_draw_calls;
+    int vertices_drawn;
+
+    f64 draw_call_duration;
+    f64 ring_wait_duration; // Time spent waiting on the gpu to finish with a ring buffer region
+    usize vertex_bytes;     // Written to the imm rings
+
+    int glyphs_rasterized; // Glyph cache misses
+    int glyphs_evicted;    // Shelves emptied to make room
+    f64 glyph_raster_duration;
+
+    int text_layout_hits;
+    int text_layout_misses; // Strings laid out glyph by glyph
+
+    int layers_redrawn;
+    usize layer_pixels_drawn;      // Into layers that had to be drawn again
+    usize layer_pixels_composited; // What drawing every composited layer at full resolution would have filled
+} Draw_Stats;
+
 typedef struct Draw_State {
     Framebuffer back_buffer;
     Framebuffer hdr_buffer;
@@ -20,10 +41,13 @@ typedef struct Draw_State {
     Matrix4 view_matrix;
     Matrix4 model_matrix;
 
-    int num_draw_calls;
-    int vertices_drawn;
+    // Window space rect that commands flushed after begin_clip_rect are clipped to
+    Rect scissor;
+    b32 has_scissor;
 
-    f64 draw_call_duration;
+    // Stats are collected over a frame. The debug ui draws before the frame is flushed so it shows last_stats
+    Draw_Stats stats;
+    Draw_Stats last_stats;
 
     b32 is_initialized;
 } Draw_State;
@@ -48,7 +72,7 @@ void draw_mesh(Mesh* m, Vector3 position, Quaternion rotation, Vector3 scale) {
     draw_state->model_matrix = m4_mul(m4_mul(m4_translate(position), m4_rotate(rotation)), m4_scale(scale));
     refresh_shader_transform();
 
-    set_uniform_v4("color", v4s(1.f));
+    set_uniform_v4(SU_Color, v4s(1.f));
 
     glBindVertexArray(m->vao);
     glBindBuffer(GL_ARRAY_BUFFER, m->vbo);
@@ -73,125 +97,621 @@ void set_mesh_vertex_format(void) {
     glEnableVertexAttribArray(uv_loc);
 }
 
-b32 init_font_collection(u8* data, int len, Allocator asset_memory, Font_Collection* collection) {
+// Returns the index of a new zeroed page
+static int push_codepoint_page(Font_Collection* collection) {
+    if (collection->page_count == collection->page_cap) {
+        collection->page_cap *= 2;
+        collection->pages = mem_realloc(collection->asset_memory, collection->pages, sizeof(u16) * CODEPOINT_PAGE_SIZE * collection->page_cap);
+    }
+    int index = collection->page_count++;
+    mem_set(collection->pages + index * CODEPOINT_PAGE_SIZE, 0, sizeof(u16) * CODEPOINT_PAGE_SIZE);
+    return index;
+}
+
+static void set_codepoint_glyph(Font_Collection* collection, u32 codepoint, u16 glyph) {
+    if (codepoint < CODEPOINT_PAGE_SIZE) {
+        collection->latin1_glyphs[codepoint] = glyph;
+        return;
+    }
+    if (codepoint >= CODEPOINT_PAGE_SIZE * CODEPOINT_PAGE_COUNT || !glyph) return;
+
+    int page  = codepoint / CODEPOINT_PAGE_SIZE;
+    int index = collection->page_indices[page];
+    if (index <= 0) {
+        index = push_codepoint_page(collection);
+        collection->page_indices[page] = (s16)index;
+    }
+    collection->pages[index * CODEPOINT_PAGE_SIZE + codepoint % CODEPOINT_PAGE_SIZE] = glyph;
+}
+
+// The tables only depend on the cmap subtable STBTT picked so that's what they're cached by. Returns false for
+// formats parse_cmap can't read
+static b32 hash_cmap(Font_Collection* collection, u64* hash) {
+    u8* cmap = collection->info.data + collection->info.index_map;
+
+    u32 size = 0;
+    switch (ttUSHORT(cmap)) {
+    case 4:  size = ttUSHORT(cmap + 2); break;
+    case 12:
+    case 13: size = ttULONG(cmap + 4); break;
+    default: return false;
+    }
+
+    *hash = hash_bytes(cmap, size);
+    return true;
+}
+
+// Walks every segment or group of a format 4, 12 or 13 cmap once. Glyphs come out the same as stbtt_FindGlyphIndex
+static void parse_cmap(Font_Collection* collection) {
+    u8* cmap = collection->info.data + collection->info.index_map;
+    u16 format = ttUSHORT(cmap);
+
+    if (format == 4) {
+        int segment_count = ttUSHORT(cmap + 6) / 2;
+        u8* end_codes        = cmap + 14;
+        u8* start_codes      = end_codes + segment_count * 2 + 2;
+        u8* id_deltas        = start_codes + segment_count * 2;
+        u8* id_range_offsets = id_deltas + segment_count * 2;
+
+        for (int i = 0; i < segment_count; ++i) {
+            u32 start = ttUSHORT(start_codes + i * 2);
+            u32 end   = ttUSHORT(end_codes + i * 2);
+            s16 delta = ttSHORT(id_deltas + i * 2);
+            u16 range_offset = ttUSHORT(id_range_offsets + i * 2);
+
+            // The last segment is only there to end the table
+            if (end == 0xFFFF) end = 0xFFFE;
+
+            for (u32 codepoint = start; codepoint <= end; ++codepoint) {
+                // Like STBTT the delta isn't added to glyphs from the glyph id array
+                u16 glyph;
+                if (range_offset == 0) glyph = (u16)(codepoint + delta);
+                else glyph = ttUSHORT(id_range_offsets + i * 2 + range_offset + (codepoint - start) * 2);
+                set_codepoint_glyph(collection, codepoint, glyph);
+            }
+        }
+    } else {
+        u32 group_count = ttULONG(cmap + 12);
+        for (u32 i = 0; i < group_count; ++i) {
+            u8* group = cmap + 16 + i * 12;
+            u32 start = ttULONG(group);
+            u32 end   = ttULONG(group + 4);
+            u32 start_glyph = ttULONG(group + 8);
+            if (end >= CODEPOINT_PAGE_SIZE * CODEPOINT_PAGE_COUNT) end = CODEPOINT_PAGE_SIZE * CODEPOINT_PAGE_COUNT - 1;
+
+            for (u32 codepoint = start; codepoint <= end; ++codepoint) {
+                u32 glyph = format == 12 ? start_glyph + codepoint - start : start_glyph;
+                set_codepoint_glyph(collection, codepoint, (u16)glyph);
+            }
+        }
+    }
+}
+
+#define CODEPOINT_CACHE_MAGIC   0x504D434F // "OCMP"
+#define CODEPOINT_CACHE_VERSION 1
+
+// Followed by latin1_glyphs, page_indices, then page_count pages
+typedef struct Codepoint_Cache_Header {
+    u32 magic;
+    u32 version;
+    u64 cmap_hash;
+    int page_count;
+    int reserved;
+} Codepoint_Cache_Header;
+
+static b32 read_codepoint_cache(Font_Collection* collection, String path, u64 cmap_hash) {
+    Temp_Memory temp_memory = begin_temp_memory(g_platform->frame_arena);
+
+    b32 result = false;
+    String file;
+    if (read_file_into_string(path, &file, g_platform->frame_arena) && file.len >= (int)sizeof(Codepoint_Cache_Header)) {
+        Codepoint_Cache_Header* header = (Codepoint_Cache_Header*)file.data;
+
+        int tables_size = (int)(sizeof(collection->latin1_glyphs) + sizeof(collection->page_indices));
+        int pages_size  = header->page_count * CODEPOINT_PAGE_SIZE * (int)sizeof(u16);
+        b32 is_valid = header->magic == CODEPOINT_CACHE_MAGIC && header->version == CODEPOINT_CACHE_VERSION && header->cmap_hash == cmap_hash;
+        is_valid = is_valid && header->page_count > 0 && header->page_count <= CODEPOINT_PAGE_COUNT + 1;
+        is_valid = is_valid && file.len >= (int)sizeof(Codepoint_Cache_Header) + tables_size + pages_size;
+
+        // Parsed tables always point every page somewhere so anything out of range is a corrupt file
+        if (is_valid) {
+            s16* page_indices = (s16*)(file.data + sizeof(Codepoint_Cache_Header) + sizeof(collection->latin1_glyphs));
+            for (int i = 0; i < CODEPOINT_PAGE_COUNT; ++i) {
+                if (page_indices[i] < 0 || page_indices[i] >= header->page_count) {
+                    o_log_warning("[Draw] %s has a codepoint page out of range. Parsing the cmap again", (const char*)path.data);
+                    is_valid = false;
+                    break;
+                }
+            }
+        }
+
+        if (is_valid) {
+            u8* at = file.data + sizeof(Codepoint_Cache_Header);
+            mem_copy(collection->latin1_glyphs, at, sizeof(collection->latin1_glyphs));
+            at += sizeof(collection->latin1_glyphs);
+            mem_copy(collection->page_indices, at, sizeof(collection->page_indices));
+            at += sizeof(collection->page_indices);
+
+            collection->page_count = header->page_count;
+            collection->page_cap   = header->page_count;
+            collection->pages      = mem_alloc_array(collection->asset_memory, u16, collection->page_cap * CODEPOINT_PAGE_SIZE);
+            mem_copy(collection->pages, at, pages_size);
+            result = true;
+        }
+    }
+
+    end_temp_memory(temp_memory);
+    return result;
+}
+
+static void write_codepoint_cache(Font_Collection* collection, String path, u64 cmap_hash) {
+    File_Handle file;
+    if (!g_platform->open_file(path, FF_Write | FF_Create, &file)) {
+        o_log_warning("[Draw] Failed to open %s to cache codepoints", (const char*)path.data);
+        return;
+    }
+
+    Codepoint_Cache_Header header = {
+        .magic      = CODEPOINT_CACHE_MAGIC,
+        .version    = CODEPOINT_CACHE_VERSION,
+        .cmap_hash  = cmap_hash,
+        .page_count = collection->page_count,
+    };
+    g_platform->write_file(file, (u8*)&header, sizeof(header));
+    g_platform->write_file(file, (u8*)collection->latin1_glyphs, sizeof(collection->latin1_glyphs));
+    g_platform->write_file(file, (u8*)collection->page_indices, sizeof(collection->page_indices));
+    g_platform->write_file(file, (u8*)collection->pages, collection->page_count * CODEPOINT_PAGE_SIZE * (int)sizeof(u16));
+    g_platform->close_file(&file);
+}
+
+// Codepoint tables are read from cache_path if they were cached from the same cmap. Otherwise they're parsed and
+// written there. An empty cache_path always parses
+b32 init_font_collection(u8* data, int len, String cache_path, Allocator asset_memory, Font_Collection* collection) {
     *collection = (Font_Collection) { 0 };
     if (!stbtt_InitFont(&collection->info, data, stbtt_GetFontOffsetForIndex(data, 0))) {
         return false;
     }
 
-    collection->codepoint_count = collection->info.numGlyphs;
-    collection->codepoint_indices = mem_alloc_array(asset_memory, int, collection->codepoint_count);
-    
-    int glyphs_found = 0;
-    // Ask STBTT for the glyph indices.
-    // @TODO(colby): linearly search the codepoint space because STBTT doesn't expose CP->glyph idx;
-    //               later we will parse the ttf file in a similar way to STBTT.
-    //               Linear search is exactly 17 times slower than parsing for 65536 glyphs.
-    for (int codepoint = 0; codepoint < 0x110000; ++codepoint) {
-        int idx = stbtt_FindGlyphIndex(&collection->info, codepoint);
-        if (idx <= 0) continue;
-        glyphs_found += 1;
-        collection->codepoint_indices[idx] = codepoint;
-    }
-
     collection->asset_memory = asset_memory;
+    mem_set(collection->page_indices, -1, sizeof(collection->page_indices));
+
+    u64 cmap_hash = 0;
+    b32 can_parse = hash_cmap(collection, &cmap_hash);
+    if (can_parse && cache_path.len > 0 && read_codepoint_cache(collection, cache_path, cmap_hash)) return true;
+
+    // Page 0 is the empty page
+    collection->page_cap   = 16;
+    collection->page_count = 0;
+    collection->pages      = mem_alloc_array(asset_memory, u16, collection->page_cap * CODEPOINT_PAGE_SIZE);
+    push_codepoint_page(collection);
+
+    if (can_parse) {
+        parse_cmap(collection);
+
+        // Pages the cmap didn't touch don't have any glyphs
+        for (int i = 0; i < CODEPOINT_PAGE_COUNT; ++i) {
+            if (collection->page_indices[i] < 0) collection->page_indices[i] = 0;
+        }
+
+        if (cache_path.len > 0) write_codepoint_cache(collection, cache_path, cmap_hash);
+    } else {
+        for (int codepoint = 0; codepoint < CODEPOINT_PAGE_SIZE; ++codepoint) {
+            collection->latin1_glyphs[codepoint] = (u16)stbtt_FindGlyphIndex(&collection->info, codepoint);
+        }
+    }
 
     return true;
 }
 
-#define FONT_ATLAS_SIZE 4096
-Font* font_at_size(Font_Collection* collection, int size) {
-    size = CLAMP(size, 2, 512);
+// Only other cmap formats get here. Their pages are filled by asking STBTT for each codepoint
+static int load_codepoint_page(Font_Collection* collection, int page) {
+    u16 glyphs[CODEPOINT_PAGE_SIZE];
+    b32 has_glyphs = false;
 
-    for (int i = 0; i < collection->font_count; ++i) {
-        Font* f = &collection->fonts[i];
-        if (f->size == size) return f;
+    Rune first = (Rune)(page * CODEPOINT_PAGE_SIZE);
+    for (int i = 0; i < CODEPOINT_PAGE_SIZE; ++i) {
+        glyphs[i] = (u16)stbtt_FindGlyphIndex(&collection->info, first + i);
+        if (glyphs[i]) has_glyphs = true;
     }
 
+    int index = 0;
+    if (has_glyphs) {
+        index = push_codepoint_page(collection);
+        mem_copy(collection->pages + index * CODEPOINT_PAGE_SIZE, glyphs, sizeof(glyphs));
+    }
+
+    collection->page_indices[page] = (s16)index;
+    return index;
+}
+
+int glyph_index_from_rune(Font_Collection* collection, Rune r) {
+    if (r < CODEPOINT_PAGE_SIZE) return collection->latin1_glyphs[r];
+    if (r >= CODEPOINT_PAGE_SIZE * CODEPOINT_PAGE_COUNT) return 0;
+
+    int page = collection->page_indices[r / CODEPOINT_PAGE_SIZE];
+    if (page < 0) page = load_codepoint_page(collection, r / CODEPOINT_PAGE_SIZE);
+    return collection->pages[page * CODEPOINT_PAGE_SIZE + r % CODEPOINT_PAGE_SIZE];
+}
+
+// Every font's glyphs are rasterized into one shared atlas the first time they're drawn. The atlas is split into
+// shelves of similar height. When it's full the least recently used shelf is emptied for the new glyph
+#define GLYPH_ATLAS_SIZE 2048
+#define GLYPH_CACHE_CAP 8192
+#define GLYPH_SHELF_CAP 512
+#define GLYPH_PADDING 1
+
+// Distance field glyphs are made once at SDF_GLYPH_SIZE and scaled to any size. The field reaches SDF_PADDING pixels
+// past the outline where it fades to 0. The outline is at SDF_ON_EDGE
+#define SDF_GLYPH_SIZE 32
+#define SDF_PADDING 4
+#define SDF_ON_EDGE 128
+#define SDF_PIXEL_DIST_SCALE ((f32)SDF_ON_EDGE / (f32)SDF_PADDING)
+
+// Bitmap glyphs are sampled nearest and distance fields linearly so they get separate atlases
+typedef enum Glyph_Page {
+    GP_Bitmap,
+    GP_Distance,
+
+    GP_Count,
+} Glyph_Page;
+
+typedef struct Glyph_Shelf {
+    Glyph_Page page;
+    int y, height;
+    int x; // Where the next glyph goes
+    f64 last_used; // Frame time any glyph on the shelf was last looked up
+} Glyph_Shelf;
+
+typedef struct Cached_Glyph {
+    Font_Glyph glyph;
+    u64 key;
+    int shelf; // -1 for glyphs with nothing to draw like spaces
+    int area;
+    int next_free;
+} Cached_Glyph;
+
+typedef struct Glyph_Cache {
+    Texture2d atlases[GP_Count];
+
+    Glyph_Shelf shelves[GLYPH_SHELF_CAP];
+    int shelf_count;
+    int shelf_bottoms[GP_Count]; // y of the next new shelf on each page
+
+    Cached_Glyph glyphs[GLYPH_CACHE_CAP];
+    int glyph_count;
+    int first_free; // -1 if glyphs below glyph_count are all used
+    int used_count;
+    int used_area;
+
+    Hash_Table lookup; // Key u64 font cache id << 32 | glyph index, Value int index into glyphs
+    u32 next_font_id;
+    u32 generation; // Bumped whenever a glyph is freed so anything holding onto uvs knows to look them up again
+
+    b32 is_initialized;
+} Glyph_Cache;
+
+static Glyph_Cache* glyph_cache = 0;
+
+static void init_glyph_cache(Platform* platform) {
+    glyph_cache = mem_alloc_struct(platform->permanent_arena, Glyph_Cache);
+
+    // The lookup is on the heap so it outlives the permanent arena reset on a code reload. Its procs don't
+    if (glyph_cache->is_initialized) {
+        glyph_cache->lookup.func      = hash_pod;
+        glyph_cache->lookup.allocator = heap_allocator();
+        return;
+    }
+    glyph_cache->is_initialized = true;
+
+    for (int i = 0; i < GP_Count; ++i) {
+        glyph_cache->atlases[i] = (Texture2d) {
+            .width  = GLYPH_ATLAS_SIZE,
+            .height = GLYPH_ATLAS_SIZE,
+            .depth  = 1,
+        };
+        upload_texture2d(&glyph_cache->atlases[i]);
+    }
+
+    // Distances have to be interpolated between texels to get a smooth outline when scaled up
+    glBindTexture(GL_TEXTURE_2D, glyph_cache->atlases[GP_Distance].id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, g_gl_context->bound_texture);
+
+    glyph_cache->first_free = -1;
+    glyph_cache->lookup = make_pod_hash_table(u64, int, heap_allocator());
+    reserve_hash_table(&glyph_cache->lookup, GLYPH_CACHE_CAP);
+}
+
+Texture2d glyph_atlas(Font* f) { return glyph_cache->atlases[f->is_sdf ? GP_Distance : GP_Bitmap]; }
+
+static b32 is_distance_atlas(GLuint id) { return id != 0 && id == glyph_cache->atlases[GP_Distance].id; }
+
+static void free_cached_glyph(int index) {
+    Cached_Glyph* cached = &glyph_cache->glyphs[index];
+    remove_hash_table(&glyph_cache->lookup, cached->key);
+
+    glyph_cache->used_count -= 1;
+    glyph_cache->used_area  -= cached->area;
+
+    cached->key = 0;
+    cached->next_free = glyph_cache->first_free;
+    glyph_cache->first_free = index;
+    glyph_cache->generation += 1;
+}
+
+static void evict_glyph_shelf(int shelf_index) {
+    for (int i = 0; i < glyph_cache->glyph_count; ++i) {
+        Cached_Glyph* cached = &glyph_cache->glyphs[i];
+        if (cached->key && cached->shelf == shelf_index) free_cached_glyph(i);
+    }
+    glyph_cache->shelves[shelf_index].x = 0;
+    draw_state->stats.glyphs_evicted += 1;
+}
+
+void evict_font_glyphs(Font* f) {
+    for (int i = 0; i < glyph_cache->glyph_count; ++i) {
+        Cached_Glyph* cached = &glyph_cache->glyphs[i];
+        if (cached->key && (u32)(cached->key >> 32) == f->cache_id) free_cached_glyph(i);
+    }
+}
+
+// Returns the shelf for a width x height rect and moves its cursor past it or -1 if nothing can be evicted
+static int find_glyph_shelf(Glyph_Page page, int width, int height, int* x, int* y) {
+    // Heights are rounded up so shelves can be shared by similar glyphs and reused after eviction
+    int shelf_height = (height + 3) & ~3;
+
+    int best = -1;
+    for (int i = 0; i < glyph_cache->shelf_count; ++i) {
+        Glyph_Shelf* shelf = &glyph_cache->shelves[i];
+        if (shelf->page != page) continue;
+        if (shelf->height < shelf_height || shelf->height > shelf_height + shelf_height / 2) continue;
+        if (shelf->x + width > GLYPH_ATLAS_SIZE) continue;
+        if (best == -1 || shelf->height < glyph_cache->shelves[best].height) best = i;
+    }
+
+    int* bottom = &glyph_cache->shelf_bottoms[page];
+    if (best == -1 && glyph_cache->shelf_count < GLYPH_SHELF_CAP && *bottom + shelf_height <= GLYPH_ATLAS_SIZE) {
+        best = glyph_cache->shelf_count++;
+        glyph_cache->shelves[best] = (Glyph_Shelf) { .page = page, .y = *bottom, .height = shelf_height };
+        *bottom += shelf_height;
+    }
+
+    // Glyphs drawn this frame may still be queued so only older shelves can be emptied
+    if (best == -1) {
+        for (int i = 0; i < glyph_cache->shelf_count; ++i) {
+            Glyph_Shelf* shelf = &glyph_cache->shelves[i];
+            if (shelf->page != page) continue;
+            if (shelf->height < shelf_height || shelf->last_used >= g_platform->current_frame_time) continue;
+            if (best == -1 || shelf->last_used < glyph_cache->shelves[best].last_used) best = i;
+        }
+        if (best == -1) return -1;
+        evict_glyph_shelf(best);
+    }
+
+    Glyph_Shelf* shelf = &glyph_cache->shelves[best];
+    *x = shelf->x;
+    *y = shelf->y;
+    shelf->x += width;
+    shelf->last_used = g_platform->current_frame_time;
+    return best;
+}
+
+static Cached_Glyph* cache_glyph(Font* f, int glyph_index, u64 key) {
+    f64 start_time = g_platform->time_in_seconds();
+
+    Glyph_Page page = f->is_sdf ? GP_Distance : GP_Bitmap;
+    int h_oversample = f->h_oversample;
+    int v_oversample = f->v_oversample;
+    f32 glyph_scale = f->scale * f->glyph_size / (f32)f->size; // From font units to pixels at glyph_size
+    f32 scale_x = glyph_scale * (f32)h_oversample;
+    f32 scale_y = glyph_scale * (f32)v_oversample;
+
+    // Same sizes and offsets stbtt_PackFontRanges gives each glyph. Distance fields are made up front since
+    // stbtt only tells their size and offset by making them
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    u8* distances = 0;
+    if (f->is_sdf) {
+        int sdf_width, sdf_height;
+        distances = stbtt_GetGlyphSDF(f->info, glyph_scale, glyph_index, SDF_PADDING, SDF_ON_EDGE, SDF_PIXEL_DIST_SCALE, &sdf_width, &sdf_height, &x0, &y0);
+        if (distances) {
+            x1 = x0 + sdf_width;
+            y1 = y0 + sdf_height;
+        }
+    } else {
+        stbtt_GetGlyphBitmapBoxSubpixel(f->info, glyph_index, scale_x, scale_y, 0.f, 0.f, &x0, &y0, &x1, &y1);
+    }
+    int width  = x1 - x0 + h_oversample - 1;
+    int height = y1 - y0 + v_oversample - 1;
+    b32 is_empty = x1 <= x0 || y1 <= y0;
+
+    int advance, left_side_bearing;
+    stbtt_GetGlyphHMetrics(f->info, glyph_index, &advance, &left_side_bearing);
+
+    // Running out of slots empties the shelf that went longest without being drawn, same as running out of space
+    if (glyph_cache->first_free == -1 && glyph_cache->glyph_count == GLYPH_CACHE_CAP) {
+        int oldest = -1;
+        for (int i = 0; i < glyph_cache->shelf_count; ++i) {
+            Glyph_Shelf* candidate = &glyph_cache->shelves[i];
+            if (candidate->x == 0 || candidate->last_used >= g_platform->current_frame_time) continue;
+            if (oldest == -1 || candidate->last_used < glyph_cache->shelves[oldest].last_used) oldest = i;
+        }
+        if (oldest != -1) evict_glyph_shelf(oldest);
+    }
+
+    int shelf = -1;
+    int atlas_x = 0, atlas_y = 0;
+    if (!is_empty) {
+        shelf = find_glyph_shelf(page, width + GLYPH_PADDING, height + GLYPH_PADDING, &atlas_x, &atlas_y);
+        if (shelf == -1) {
+            o_log_warning("[Draw] Glyph cache is full of glyphs drawn this frame");
+            if (distances) stbtt_FreeSDF(distances, 0);
+            return 0;
+        }
+    }
+
+    int index = glyph_cache->first_free;
+    if (index != -1) {
+        glyph_cache->first_free = glyph_cache->glyphs[index].next_free;
+    } else if (glyph_cache->glyph_count < GLYPH_CACHE_CAP) {
+        index = glyph_cache->glyph_count++;
+    } else {
+        o_log_warning("[Draw] Glyph cache is out of glyphs drawn before this frame");
+        if (distances) stbtt_FreeSDF(distances, 0);
+        return 0;
+    }
+
+    f32 sub_x = 0.f, sub_y = 0.f;
+    if (!is_empty) {
+        Temp_Memory temp_memory = begin_temp_memory(g_platform->frame_arena);
+        u8* pixels = distances;
+        if (!pixels) {
+            pixels = mem_alloc_array(g_platform->frame_arena, u8, width * height);
+            mem_set(pixels, 0, width * height);
+            stbtt_MakeGlyphBitmapSubpixelPrefilter(f->info, pixels, width, height, width, scale_x, scale_y, 0.f, 0.f, h_oversample, v_oversample, &sub_x, &sub_y, glyph_index);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, glyph_cache->atlases[page].id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, atlas_x, atlas_y, width, height, GL_RED, GL_UNSIGNED_BYTE, pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, g_gl_context->bound_texture);
+
+        end_temp_memory(temp_memory);
+    }
+    if (distances) stbtt_FreeSDF(distances, 0);
+
+    // The atlas isn't flipped so v goes down the atlas
+    f32 atlas_size = (f32)GLYPH_ATLAS_SIZE;
+    Cached_Glyph* cached = &glyph_cache->glyphs[index];
+    *cached = (Cached_Glyph) {
+        .glyph = {
+            .width     = (f32)(is_empty ? 0 : width) / (f32)h_oversample,
+            .height    = (f32)(is_empty ? 0 : height) / (f32)v_oversample,
+            .bearing_x = (f32)x0 / (f32)h_oversample + sub_x,
+            .bearing_y = (f32)y0 / (f32)v_oversample + sub_y,
+            .advance   = (f32)advance * glyph_scale,
+            .uv0       = v2((f32)atlas_x / atlas_size, (f32)(atlas_y + height) / atlas_size),
+            .uv1       = v2((f32)(atlas_x + width) / atlas_size, (f32)atlas_y / atlas_size),
+        },
+        .key   = key,
+        .shelf = shelf,
+        .area  = is_empty ? 0 : width * height,
+    };
+    if (is_empty) cached->glyph.uv0 = cached->glyph.uv1 = v2z();
+
+    push_hash_table(&glyph_cache->lookup, key, index);
+    glyph_cache->used_count += 1;
+    glyph_cache->used_area  += cached->area;
+
+    draw_state->stats.glyphs_rasterized += 1;
+    draw_state->stats.glyph_raster_duration += g_platform->time_in_seconds() - start_time;
+
+    return cached;
+}
+
+// Occupancy and shelf usage are over both atlases
+void get_glyph_cache_stats(int* glyph_count, f32* occupancy, f32* shelf_usage) {
+    f32 atlas_area = (f32)GLYPH_ATLAS_SIZE * (f32)GLYPH_ATLAS_SIZE * GP_Count;
+
+    int shelf_bottom = 0;
+    for (int i = 0; i < GP_Count; ++i) shelf_bottom += glyph_cache->shelf_bottoms[i];
+
+    *glyph_count = glyph_cache->used_count;
+    *occupancy   = (f32)glyph_cache->used_area / atlas_area;
+    *shelf_usage = (f32)shelf_bottom / (f32)(GLYPH_ATLAS_SIZE * GP_Count);
+}
+
+static Font* push_font(Font_Collection* collection, int size) {
     assert(collection->font_count + 1 < FONT_CAP);
 
     int ascent, descent, line_gap;
     stbtt_GetFontVMetrics(&collection->info, &ascent, &descent, &line_gap);
 
     Font* f = &collection->fonts[collection->font_count++];
+    *f = (Font) { 0 };
 
-    f->size = size;
-    f->info = &collection->info;
-    f->glyph_count = collection->codepoint_count;
+    f->size  = size;
+    f->info  = &collection->info;
     f->owner = collection;
 
-    f32 font_scale = stbtt_ScaleForPixelHeight(&collection->info, (f32)size);
-    f->ascent   = (f32)ascent * font_scale;
-    f->descent  = (f32)descent * font_scale;
-    f->line_gap = (f32)line_gap * font_scale;
+    f->scale    = stbtt_ScaleForPixelHeight(&collection->info, (f32)size);
+    f->ascent   = (f32)ascent * f->scale;
+    f->descent  = (f32)descent * f->scale;
+    f->line_gap = (f32)line_gap * f->scale;
+
+    return f;
+}
+
+// Only metrics are made here. Glyphs are rasterized into the glyph cache when they're first drawn
+Font* font_at_size(Font_Collection* collection, int size) {
+    size = CLAMP(size, 2, 512);
+
+    for (int i = 0; i < collection->font_count; ++i) {
+        Font* f = &collection->fonts[i];
+        if (f->size == size && !f->is_sdf) return f;
+    }
+
+    Font* f = push_font(collection, size);
+    f->glyph_size = (f32)size;
+    f->cache_id   = ++glyph_cache->next_font_id;
 
-    int h_oversample = 1;
-    int v_oversample = 1;
+    f->h_oversample = 1;
+    f->v_oversample = 1;
 
     if (size <= 36) {
-        h_oversample = 2;
-        v_oversample = 2;
+        f->h_oversample = 2;
+        f->v_oversample = 2;
     }
     if (size <= 12) {
-        h_oversample = 4;
-        v_oversample = 4;
+        f->h_oversample = 4;
+        f->v_oversample = 4;
     }
     if (size <= 8) {
-        h_oversample = 8;
-        v_oversample = 8;
+        f->h_oversample = 8;
+        f->v_oversample = 8;
     }
 
-    Texture2d* atlas = &f->atlas;
-    atlas->depth  = 1;
-    atlas->width  = FONT_ATLAS_SIZE;
-    atlas->height = FONT_ATLAS_SIZE;
-
-    atlas->pixels = mem_alloc_array(collection->asset_memory, u8, atlas->width * atlas->height); // @Leak
+    return f;
+}
 
-    stbtt_pack_context pc;
-    stbtt_packedchar* pdata = mem_alloc_array(collection->asset_memory, stbtt_packedchar, collection->codepoint_count); // @Leak
+// Every size shares the collection's distance field glyphs so only the metrics differ
+Font* sdf_font_at_size(Font_Collection* collection, int size) {
+    size = CLAMP(size, 2, 512);
 
-    stbtt_pack_range pr;
-    stbtt_PackBegin(&pc, atlas->pixels, atlas->width, atlas->height, 0, 1, 0);
-    pr.chardata_for_range               = pdata;
-    pr.array_of_unicode_codepoints      = collection->codepoint_indices;
-    pr.first_unicode_codepoint_in_range = 0;
-    pr.num_chars                        = collection->codepoint_count;
-    pr.font_size                        = (f32)size;
+    for (int i = 0; i < collection->font_count; ++i) {
+        Font* f = &collection->fonts[i];
+        if (f->size == size && f->is_sdf) return f;
+    }
 
-    stbtt_PackSetSkipMissingCodepoints(&pc, 1);
-    stbtt_PackSetOversampling(&pc, h_oversample, v_oversample);
-    stbtt_PackFontRanges(&pc, collection->info.data, 0, &pr, 1);
-    stbtt_PackEnd(&pc);
+    if (!collection->sdf_cache_id) collection->sdf_cache_id = ++glyph_cache->next_font_id;
 
-    b32 ok = upload_texture2d(atlas);
-    if (!ok) assert(false);
+    Font* f = push_font(collection, size);
+    f->glyph_size   = (f32)SDF_GLYPH_SIZE;
+    f->cache_id     = collection->sdf_cache_id;
+    f->is_sdf       = true;
+    f->h_oversample = 1;
+    f->v_oversample = 1;
 
-    f->glyphs = mem_alloc_array(collection->asset_memory, Font_Glyph, collection->codepoint_count);
-    for (int i = 0; i < collection->codepoint_count; ++i) {
-        Font_Glyph* g = f->glyphs + i;
+    return f;
+}
 
-        g->uv0 = v2((f32)pdata[i].x0 / (f32)atlas->width, (f32)pdata[i].y1 / (f32)atlas->width);
-        g->uv1 = v2((f32)pdata[i].x1 / (f32)atlas->width, (f32)pdata[i].y0 / (f32)atlas->width);
+static Cached_Glyph* find_cached_glyph(Font* f, Rune r) {
+    int glyph_index = glyph_index_from_rune(f->owner, r);
+    if (glyph_index <= 0) return 0;
 
-        g->width     = ((f32)pdata[i].x1 - pdata[i].x0) / (f32)h_oversample;
-        g->height    = ((f32)pdata[i].y1 - pdata[i].y0) / (f32)v_oversample;
-        g->bearing_x = pdata[i].xoff;
-        g->bearing_y = pdata[i].yoff;
-        g->advance   = pdata[i].xadvance;
-    }
+    u64 key = ((u64)f->cache_id << 32) | (u64)glyph_index;
+    int* found = find_hash_table(&glyph_cache->lookup, key);
+    if (!found) return cache_glyph(f, glyph_index, key);
 
-    return f;
+    Cached_Glyph* cached = &glyph_cache->glyphs[*found];
+    if (cached->shelf >= 0) glyph_cache->shelves[cached->shelf].last_used = g_platform->current_frame_time;
+    return cached;
 }
 
 Font_Glyph* glyph_from_rune(Font* f, Rune r) {
-    int index = stbtt_FindGlyphIndex(f->info, r);
-    if (index > 0) {
-        assert(index < f->glyph_count);
-        return &f->glyphs[index];
-    }
-
-    return 0;
+    Cached_Glyph* cached = find_cached_glyph(f, r);
+    return cached ? &cached->glyph : 0;
 }
 
 Font_Collection* g_font_collection = 0;
@@ -203,31 +723,479 @@ typedef struct Immediate_Vertex {
     Vector4 color;
 } Immediate_Vertex;
 
-// Must be multiple of 3
+// Quads are most of what imm draws so they get their own smaller vertex and share one static index buffer
+typedef struct Quad_Vertex {
+    Vector3 position;
+    s16 uv[2];   // Signed normalized so the -1 "no texture" uv still works
+    u8 color[4]; // Normalized RGBA8
+} Quad_Vertex;
+
+// Per region. Must be multiple of 3
 #define MAX_IMM_VERTS (4096 * 3)
 
-typedef struct Immediate_Renderer {
+// Per region. 4 vertices each so the quad indices fit in a u16
+#define MAX_IMM_QUADS (65536 / 4)
+
+// Vertices are written straight into a mapped buffer split into regions. Each flush draws from where the last one
+// stopped in the same region. Only a full region or the end of a frame fences it and moves to the next one, so the
+// cpu only waits if it laps a region the gpu is still reading
+#define IMM_RING_REGIONS 3
+
+typedef struct Imm_Ring {
     GLuint vao, vbo;
-    Immediate_Vertex vertices[MAX_IMM_VERTS];
+    int vertex_size;
+    int region_cap; // In vertices
+
+    // With buffer storage the whole ring stays mapped. Otherwise each region is mapped unsynchronized while it's written
+    b32 is_persistent;
+    b32 is_cpu; // Plain memory with one region and no gl objects. Used while capturing
+    u8* ring;
+    u8* vertices; // Where the current flush's vertices start
+    GLsync region_fences[IMM_RING_REGIONS];
+    int region;
+
+    int start; // First vertex of the current flush in the region
+    int count; // Vertices used in the region
+} Imm_Ring;
+
+// Each of these has to fit in its field of the sort key
+#define MAX_RENDER_COMMANDS 4096
+#define MAX_RENDER_VIEWS    256
+#define MAX_RENDER_SHADERS  256
+#define MAX_RENDER_TEXTURES 256
+
+// Everything between an imm_begin and imm_flush along with the state that was bound at imm_flush
+typedef struct Render_Command {
+    int view;
+    Shader* shader;
+    GLuint texture;
+    GLint texture_location;
+
+    int first_vertex;
     int vertex_count;
+
+    int first_quad;
+    int quad_count;
+} Render_Command;
+
+typedef struct Render_View {
+    Matrix4 projection;
+    Matrix4 view;
+
+    Rect scissor;
+    b32 has_scissor;
+} Render_View;
+
+typedef struct Immediate_Renderer {
+    Imm_Ring triangles; // Immediate_Vertex
+    Imm_Ring quads;     // Quad_Vertex
+    GLuint quad_ibo;
+
+    int command_start;
+    int command_quad_start;
+    f32 command_min_z;
+
+    Render_Command commands[MAX_RENDER_COMMANDS];
+    u64 sort_keys[MAX_RENDER_COMMANDS];
+    int command_count;
+
+    // A new view is pushed whenever the transform or scissor changes between commands. The view index is the layer in the sort key so passes keep their order
+    Render_View views[MAX_RENDER_VIEWS];
+    int view_count;
+
+    // Small per frame ids for the sort key. Pointers and gl names are too wide
+    Shader* shaders[MAX_RENDER_SHADERS];
+    int shader_count;
+    GLuint textures[MAX_RENDER_TEXTURES];
+    int texture_count;
+
+    // While capturing the rings are cpu memory and flushes rasterize into this instead of drawing with gl
+    Raster_Target* capture;
+    Imm_Ring gl_triangles;
+    Imm_Ring gl_quads;
+
+    Imm_Snapshot* snapshot; // Quads are copied into this as they're written
 } Immediate_Renderer;
 static Immediate_Renderer* imm_renderer = 0;
 
+// Strings are laid out once into quads and cached by their text, font, size and wrap width. Each layout also keeps
+// its quads packed for where it was last drawn so drawing it there again is a copy into the quad ring
+#define TEXT_LAYOUT_CAP 1024
+#define TEXT_LAYOUT_SHELF_CAP 8
+
+typedef struct Text_Quad {
+    Rect rect; // From where the string is drawn
+    Vector2 uv0, uv1;
+} Text_Quad;
+
+typedef struct Text_Layout {
+    u64 key;
+    Vector2 extent; // What font_string_rect gives
+
+    // What it was laid out from. Keys can collide so a hit is only trusted if these match too
+    u8* text;
+    int text_len;
+    int text_cap;
+    Font* font;
+    f32 size;
+    f32 max_width;
+
+    Text_Quad* quads;
+    int quad_count;
+    int quad_cap;
+
+    // Reusing a layout skips the glyph lookups that keep these from being evicted so it touches them itself. A
+    // layout on more shelves than this is laid out every time
+    int shelves[TEXT_LAYOUT_SHELF_CAP];
+    int shelf_count;
+    u32 glyph_generation;
+
+    Quad_Vertex* vertices; // 4 per quad
+    b32 has_vertices;
+    Vector3 drawn_at;
+    u32 drawn_color;
+
+    f64 last_used;
+    int next_free;
+} Text_Layout;
+
+typedef struct Text_Layout_Cache {
+    Text_Layout layouts[TEXT_LAYOUT_CAP];
+    int layout_count;
+    int first_free; // -1 if layouts below layout_count are all used
+
+    Hash_Table lookup; // Key u64 from text_layout_key, Value int index into layouts
+
+    Text_Layout scratch; // Used when every layout was drawn this frame
+
+    b32 is_initialized;
+} Text_Layout_Cache;
+
+static Text_Layout_Cache* text_layout_cache = 0;
+
+static void init_text_layout_cache(Platform* platform) {
+    text_layout_cache = mem_alloc_struct(platform->permanent_arena, Text_Layout_Cache);
+
+    // Same as the glyph cache the lookup and quads are on the heap so they outlive a code reload
+    if (text_layout_cache->is_initialized) {
+        text_layout_cache->lookup.func      = hash_pod;
+        text_layout_cache->lookup.allocator = heap_allocator();
+        return;
+    }
+    text_layout_cache->is_initialized = true;
+
+    text_layout_cache->first_free = -1;
+    text_layout_cache->lookup = make_pod_hash_table(u64, int, heap_allocator());
+    reserve_hash_table(&text_layout_cache->lookup, TEXT_LAYOUT_CAP);
+}
+
+// Points vertices at the rest of the region from start. Nothing past start has been drawn from since the fence
+static void map_imm_region(Imm_Ring* ring) {
+    GLsizeiptr region_size = (GLsizeiptr)ring->vertex_size * ring->region_cap;
+    GLsizeiptr offset = region_size * ring->region + (GLsizeiptr)ring->vertex_size * ring->start;
+    if (ring->is_persistent) {
+        ring->vertices = ring->ring + offset;
+    } else {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+        glBindBuffer(GL_ARRAY_BUFFER, ring->vbo);
+        ring->vertices = glMapBufferRange(GL_ARRAY_BUFFER, offset, region_size - (GLsizeiptr)ring->vertex_size * ring->start, flags);
+        assert(ring->vertices);
+    }
+}
+
+static void begin_imm_region(Imm_Ring* ring) {
+    ring->start = 0;
+    ring->count = 0;
+
+    if (ring->is_cpu) {
+        ring->vertices = ring->ring;
+        return;
+    }
+
+    GLsync fence = ring->region_fences[ring->region];
+    if (fence) {
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            f64 start_time = g_platform->time_in_seconds();
+            while (result == GL_TIMEOUT_EXPIRED) result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            draw_state->stats.ring_wait_duration += g_platform->time_in_seconds() - start_time;
+        }
+        glDeleteSync(fence);
+        ring->region_fences[ring->region] = 0;
+    }
+
+    map_imm_region(ring);
+}
+
+// Makes the current flush's vertices visible to the gpu. Only the unsynchronized path has anything to do
+static void end_imm_region(Imm_Ring* ring) {
+    if (ring->is_persistent || ring->is_cpu) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, ring->vbo);
+    if (ring->count > ring->start) glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr)ring->vertex_size * (ring->count - ring->start));
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    ring->vertices = 0;
+}
+
+static void next_imm_region(Imm_Ring* ring) {
+    if (ring->is_cpu) {
+        begin_imm_region(ring);
+        return;
+    }
+
+    ring->region_fences[ring->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ring->region = (ring->region + 1) % IMM_RING_REGIONS;
+    begin_imm_region(ring);
+}
+
+// After a flush the next one's vertices go right after its own. The capture's cpu rings are read back right away so
+// they just start over
+static void continue_imm_region(Imm_Ring* ring) {
+    if (ring->is_cpu || ring->count == ring->region_cap) {
+        next_imm_region(ring);
+        return;
+    }
+
+    ring->start = ring->count;
+    map_imm_region(ring);
+}
+
+// Where the next vertex goes
+inline u8* imm_ring_vertex(Imm_Ring* ring) {
+    return ring->vertices + (usize)ring->vertex_size * (ring->count - ring->start);
+}
+
+// Leaves the ring's vao bound so the caller can set up the vertex format
+static void init_imm_ring(Imm_Ring* ring, int vertex_size, int region_cap) {
+    ring->vertex_size = vertex_size;
+    ring->region_cap  = region_cap;
+
+    glGenVertexArrays(1, &ring->vao);
+    glBindVertexArray(ring->vao);
+
+    glGenBuffers(1, &ring->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, ring->vbo);
+
+    GLsizeiptr ring_size = (GLsizeiptr)vertex_size * region_cap * IMM_RING_REGIONS;
+    if (g_gl_context->has_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, ring_size, 0, flags);
+        ring->ring = glMapBufferRange(GL_ARRAY_BUFFER, 0, ring_size, flags);
+        ring->is_persistent = true;
+        assert(ring->ring);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, ring_size, 0, GL_STREAM_DRAW);
+    }
+}
+
 #define FAR_CLIP_PLANE 1000.f
 #define NEAR_CLIP_PLANE 0.001f
 
+// Each frame writes timestamps into its own set of queries and reads back the set GPU_TIMER_LATENCY frames old, so
+// asking for a result never waits on the gpu. A set that still isn't done by then is dropped
+#define GPU_TIMER_LATENCY 3
+#define GPU_TIMER_FRAMES  (GPU_TIMER_LATENCY + 1)
+
+// Every begin and end is a sample. A scope opened again under the same parent adds its sample to the first one, so
+// work that repeats through the frame like flushes shows up once with its total
+#define GPU_SAMPLE_CAP (GPU_SCOPE_CAP * 4)
+
+typedef struct GPU_Timer_Frame {
+    GLuint queries[GPU_SAMPLE_CAP * 2]; // Begin and end timestamp per sample
+    int sample_scopes[GPU_SAMPLE_CAP];
+    int sample_count;
+
+    char names[GPU_SCOPE_CAP][GPU_SCOPE_NAME_CAP]; // Copied so they outlive a code reload
+    int parents[GPU_SCOPE_CAP]; // -1 for the outermost scopes
+    int depths[GPU_SCOPE_CAP];
+    int scope_count;
+    int dropped_count; // Samples that didn't fit. Their time is missing from the totals
+
+    GLuint last_query; // Timestamps land in order so once this one is there they all are
+} GPU_Timer_Frame;
+
+typedef struct GPU_Timer {
+    GPU_Timer_Frame frames[GPU_TIMER_FRAMES];
+    int current;
+
+    int open_samples[GPU_SCOPE_CAP]; // -1 for a sample that didn't fit
+    int open_count;
+
+    GPU_Scope_Time times[GPU_SCOPE_CAP]; // The last set read back, children right after their parent
+    int time_count;
+    f64 total_duration;
+    int dropped_count;
+
+    b32 is_initialized;
+} GPU_Timer;
+
+static GPU_Timer* gpu_timer = 0;
+
+static void init_gpu_timer(Platform* platform) {
+    gpu_timer = mem_alloc_struct(platform->permanent_arena, GPU_Timer);
+
+    if (gpu_timer->is_initialized) return;
+    gpu_timer->is_initialized = true;
+
+    for (int i = 0; i < GPU_TIMER_FRAMES; ++i) {
+        glGenQueries(GPU_SAMPLE_CAP * 2, gpu_timer->frames[i].queries);
+    }
+}
+
+static int find_gpu_scope(GPU_Timer_Frame* frame, const char* name, int parent) {
+    for (int i = 0; i < frame->scope_count; ++i) {
+        if (frame->parents[i] == parent && str_cmp(frame->names[i], name) == 0) return i;
+    }
+
+    if (frame->scope_count == GPU_SCOPE_CAP) return -1;
+
+    int index = frame->scope_count++;
+    frame->parents[index] = parent;
+    frame->depths[index]  = gpu_timer->open_count;
+    int name_len = MIN(str_len(name), GPU_SCOPE_NAME_CAP - 1);
+    mem_copy(frame->names[index], name, name_len);
+    frame->names[index][name_len] = 0;
+    return index;
+}
+
+void begin_gpu_scope(const char* name) {
+    GPU_Timer_Frame* frame = &gpu_timer->frames[gpu_timer->current];
+    assert(gpu_timer->open_count < GPU_SCOPE_CAP);
+
+    // Inside a dropped sample there's no parent to add to so everything in it is dropped too
+    int parent = -1;
+    int scope  = -1;
+    if (gpu_timer->open_count > 0) {
+        int parent_sample = gpu_timer->open_samples[gpu_timer->open_count - 1];
+        if (parent_sample >= 0) parent = frame->sample_scopes[parent_sample];
+    }
+    if (gpu_timer->open_count == 0 || parent >= 0) scope = find_gpu_scope(frame, name, parent);
+
+    if (scope < 0 || frame->sample_count == GPU_SAMPLE_CAP) {
+        frame->dropped_count += 1;
+        gpu_timer->open_samples[gpu_timer->open_count++] = -1;
+        return;
+    }
+
+    int sample = frame->sample_count++;
+    frame->sample_scopes[sample] = scope;
+    glQueryCounter(frame->queries[sample * 2], GL_TIMESTAMP);
+    gpu_timer->open_samples[gpu_timer->open_count++] = sample;
+}
+
+void end_gpu_scope(void) {
+    assert(gpu_timer->open_count > 0);
+    int sample = gpu_timer->open_samples[--gpu_timer->open_count];
+    if (sample < 0) return;
+
+    GPU_Timer_Frame* frame = &gpu_timer->frames[gpu_timer->current];
+    glQueryCounter(frame->queries[sample * 2 + 1], GL_TIMESTAMP);
+    frame->last_query = frame->queries[sample * 2 + 1];
+}
+
+// Scopes are in the order they were first opened, which puts a child opened after a reused parent's siblings in the
+// wrong place. Walking the tree puts every child right after its parent
+static void push_gpu_scope_times(GPU_Timer_Frame* frame, f64* durations, int parent) {
+    for (int i = 0; i < frame->scope_count; ++i) {
+        if (frame->parents[i] != parent) continue;
+
+        GPU_Scope_Time* time = &gpu_timer->times[gpu_timer->time_count++];
+        mem_copy(time->name, frame->names[i], GPU_SCOPE_NAME_CAP);
+        time->depth    = frame->depths[i];
+        time->duration = durations[i];
+
+        // Nested scopes are already inside their parent
+        if (parent < 0) gpu_timer->total_duration += time->duration;
+
+        push_gpu_scope_times(frame, durations, i);
+    }
+}
+
+static void read_gpu_timer_frame(GPU_Timer_Frame* frame) {
+    if (!frame->sample_count) return;
+
+    GLint is_available = 0;
+    glGetQueryObjectiv(frame->last_query, GL_QUERY_RESULT_AVAILABLE, &is_available);
+    if (!is_available) return;
+
+    f64 durations[GPU_SCOPE_CAP] = { 0 };
+    for (int i = 0; i < frame->sample_count; ++i) {
+        GLuint64 begin, end;
+        glGetQueryObjectui64v(frame->queries[i * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame->queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+        durations[frame->sample_scopes[i]] += (f64)(end - begin) / 1000000000.0;
+    }
+
+    gpu_timer->time_count = 0;
+    gpu_timer->total_duration = 0.0;
+    gpu_timer->dropped_count = frame->dropped_count;
+    push_gpu_scope_times(frame, durations, -1);
+}
+
+void next_gpu_frame(void) {
+    // Anything still open ends with the frame
+    while (gpu_timer->open_count > 0) end_gpu_scope();
+
+    gpu_timer->current = (gpu_timer->current + 1) % GPU_TIMER_FRAMES;
+
+    // The set about to be reused is the oldest one
+    GPU_Timer_Frame* frame = &gpu_timer->frames[gpu_timer->current];
+    read_gpu_timer_frame(frame);
+    frame->sample_count  = 0;
+    frame->scope_count   = 0;
+    frame->dropped_count = 0;
+}
+
+GPU_Scope_Time* get_gpu_scope_times(int* count, f64* total_duration, int* dropped_count) {
+    *count = gpu_timer->time_count;
+    if (total_duration) *total_duration = gpu_timer->total_duration;
+    if (dropped_count) *dropped_count = gpu_timer->dropped_count;
+    return gpu_timer->times;
+}
+
 void init_draw(Platform* platform) {
     imm_renderer      = mem_alloc_struct(platform->permanent_arena, Immediate_Renderer);
     draw_state        = mem_alloc_struct(platform->permanent_arena, Draw_State);
+    init_glyph_cache(platform);
+    init_text_layout_cache(platform);
+    init_gpu_timer(platform);
 
     if (draw_state->is_initialized) return;
     draw_state->is_initialized = true;
 
-    glGenVertexArrays(1, &imm_renderer->vao);
-    glBindVertexArray(imm_renderer->vao);
+    init_imm_ring(&imm_renderer->triangles, sizeof(Immediate_Vertex), MAX_IMM_VERTS);
+    set_imm_vertex_format();
+    begin_imm_region(&imm_renderer->triangles);
+
+    init_imm_ring(&imm_renderer->quads, sizeof(Quad_Vertex), MAX_IMM_QUADS * 4);
+    set_imm_quad_vertex_format();
+    begin_imm_region(&imm_renderer->quads);
 
-    glGenBuffers(1, &imm_renderer->vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, imm_renderer->vbo);
+    // Every quad is the same two triangles so one index buffer covers a whole region. The ring offset is the base vertex
+    {
+        Temp_Memory temp_memory = begin_temp_memory(platform->frame_arena);
+        u16* indices = mem_alloc_array(platform->frame_arena, u16, MAX_IMM_QUADS * 6);
+        for (int i = 0; i < MAX_IMM_QUADS; ++i) {
+            int base = i * 4;
+
+            // Same winding as the old 6 vertex rects. Corners go bottom left, bottom right, top right, top left
+            u16* quad = indices + i * 6;
+            quad[0] = (u16)(base + 3);
+            quad[1] = (u16)(base + 0);
+            quad[2] = (u16)(base + 2);
+            quad[3] = (u16)(base + 0);
+            quad[4] = (u16)(base + 1);
+            quad[5] = (u16)(base + 2);
+        }
+
+        // Element buffer binding is part of the quad vao which is still bound
+        glGenBuffers(1, &imm_renderer->quad_ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, imm_renderer->quad_ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(u16) * MAX_IMM_QUADS * 6, indices, GL_STATIC_DRAW);
+        end_temp_memory(temp_memory);
+    }
+
+    o_log_verbose("[Draw] Streaming imm vertices through %s ring buffers", imm_renderer->triangles.is_persistent ? "persistently mapped" : "unsynchronized");
 
     glEnable(GL_FRAMEBUFFER_SRGB); 
     glDepthMask(GL_TRUE);
@@ -259,10 +1227,17 @@ void resize_draw(int new_width, int new_height) {
 }
 
 void refresh_shader_transform(void) {
-    set_uniform_m4("view",         draw_state->view_matrix);
-    set_uniform_m4("projection",   draw_state->projection_matrix);
+    set_uniform_m4(SU_View,       draw_state->view_matrix);
+    set_uniform_m4(SU_Projection, draw_state->projection_matrix);
+}
+
+void begin_clip_rect(Rect rect) {
+    draw_state->scissor     = rect;
+    draw_state->has_scissor = true;
 }
 
+void end_clip_rect(void) { draw_state->has_scissor = false; }
+
 void draw_right_handed(Rect viewport) {
     Vector2 draw_size = rect_size(viewport);
     f32 aspect_ratio  = draw_size.width / draw_size.height;
@@ -275,7 +1250,7 @@ void draw_right_handed(Rect viewport) {
     refresh_shader_transform();
 }
 
-static void draw_ortho(Vector3 pos, Quaternion rot, f32 aspect_ratio, f32 ortho_size) {
+void draw_ortho(Vector3 pos, Quaternion rot, f32 aspect_ratio, f32 ortho_size) {
     draw_state->projection_matrix = m4_ortho(ortho_size, aspect_ratio, FAR_CLIP_PLANE, NEAR_CLIP_PLANE);
     draw_state->view_matrix       = m4_mul(m4_rotate(quat_inverse(rot)), m4_translate(v3_inverse(pos)));
     draw_state->model_matrix      = m4_identity();
@@ -283,6 +1258,64 @@ static void draw_ortho(Vector3 pos, Quaternion rot, f32 aspect_ratio, f32 ortho_
     refresh_shader_transform();
 }
 
+b32 begin_draw_layer(Draw_Layer* layer, u64 key, f32 scale) {
+    int width  = MAX((int)((f32)g_platform->window_width * scale), 1);
+    int height = MAX((int)((f32)g_platform->window_height * scale), 1);
+
+    b32 same_size = layer->framebuffer.handle && layer->framebuffer.width == width && layer->framebuffer.height == height;
+    if (layer->is_valid && same_size && layer->key == key) return false;
+
+    if (!same_size) {
+        if (layer->framebuffer.handle) resize_framebuffer(&layer->framebuffer, width, height);
+        else init_framebuffer(width, height, FF_Color | FF_Depth, &layer->framebuffer);
+    }
+
+    // Anything queued so far was meant for whatever was bound before
+    flush_render_commands();
+
+    begin_framebuffer(layer->framebuffer);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    begin_gpu_scope("Layer");
+
+    // Alpha is kept as coverage. Otherwise a partly transparent tile over the background leaves the layer partly
+    // transparent too and the composite lets the clear color through
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    layer->key      = key;
+    layer->is_valid = false;
+
+    draw_state->stats.layers_redrawn += 1;
+    draw_state->stats.layer_pixels_drawn += (usize)width * (usize)height;
+    return true;
+}
+
+void end_draw_layer(Draw_Layer* layer) {
+    flush_render_commands();
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    end_gpu_scope();
+    end_framebuffer();
+    glViewport(0, 0, g_platform->window_width, g_platform->window_height);
+
+    layer->is_valid = true;
+}
+
+void invalidate_draw_layer(Draw_Layer* layer) { layer->is_valid = false; }
+
+void composite_draw_layer(Draw_Layer* layer, f32 z) {
+    Rect viewport = { v2z(), v2((f32)g_platform->window_width, (f32)g_platform->window_height) };
+
+    set_shader(get_shader(AH_Basic2d_Shader));
+    draw_right_handed(viewport);
+    set_uniform_texture(SU_Diffuse, layer->framebuffer.color[FCI_Color]);
+    imm_begin();
+    imm_textured_rect(viewport, z, v2z(), v2s(1.f), v4s(1.f));
+    imm_flush();
+
+    draw_state->stats.layer_pixels_composited += (usize)g_platform->window_width * (usize)g_platform->window_height;
+}
+
 void draw_persp(Vector3 pos, Quaternion rot, f32 aspect_ratio, f32 fov) {
     draw_state->projection_matrix = m4_persp(fov, aspect_ratio, FAR_CLIP_PLANE, NEAR_CLIP_PLANE);
     draw_state->view_matrix       = m4_mul(m4_rotate(quat_inverse(rot)), m4_translate(v3_inverse(pos)));
@@ -300,13 +1333,56 @@ void draw_from(Vector2 pos, f32 ortho_size) {
 }
 
 void imm_begin(void) {
-    imm_renderer->vertex_count = 0;
+    b32 is_full = imm_renderer->command_count == MAX_RENDER_COMMANDS ||
+                  imm_renderer->view_count    == MAX_RENDER_VIEWS    ||
+                  imm_renderer->shader_count  == MAX_RENDER_SHADERS  ||
+                  imm_renderer->texture_count == MAX_RENDER_TEXTURES;
+    if (is_full) flush_render_commands();
+
+    imm_renderer->command_start      = imm_renderer->triangles.count;
+    imm_renderer->command_quad_start = imm_renderer->quads.count;
+    imm_renderer->command_min_z      = F32_MAX;
 }
 
-void imm_flush(void) {
-    if (imm_renderer->vertex_count == 0) return;
+static int find_or_add_render_shader(Shader* shader) {
+    for (int i = 0; i < imm_renderer->shader_count; ++i) {
+        if (imm_renderer->shaders[i] == shader) return i;
+    }
+    imm_renderer->shaders[imm_renderer->shader_count] = shader;
+    return imm_renderer->shader_count++;
+}
 
-    f64 start_time = g_platform->time_in_seconds();
+static int find_or_add_render_texture(GLuint texture) {
+    for (int i = 0; i < imm_renderer->texture_count; ++i) {
+        if (imm_renderer->textures[i] == texture) return i;
+    }
+    imm_renderer->textures[imm_renderer->texture_count] = texture;
+    return imm_renderer->texture_count++;
+}
+
+static int current_render_view(void) {
+    if (imm_renderer->view_count > 0) {
+        Render_View* last = &imm_renderer->views[imm_renderer->view_count - 1];
+        b32 same_projection = mem_cmp(&last->projection, &draw_state->projection_matrix, sizeof(Matrix4)) == 0;
+        b32 same_view       = mem_cmp(&last->view, &draw_state->view_matrix, sizeof(Matrix4)) == 0;
+        b32 same_scissor    = last->has_scissor == draw_state->has_scissor && (!last->has_scissor || mem_cmp(&last->scissor, &draw_state->scissor, sizeof(Rect)) == 0);
+        if (same_projection && same_view && same_scissor) return imm_renderer->view_count - 1;
+    }
+
+    imm_renderer->views[imm_renderer->view_count] = (Render_View) { 
+        .projection  = draw_state->projection_matrix, 
+        .view        = draw_state->view_matrix,
+        .scissor     = draw_state->scissor,
+        .has_scissor = draw_state->has_scissor,
+    };
+    return imm_renderer->view_count++;
+}
+
+// Queues the vertices since imm_begin. Nothing is drawn until flush_render_commands
+void imm_flush(void) {
+    int vertex_count = imm_renderer->triangles.count - imm_renderer->command_start;
+    int quad_count   = (imm_renderer->quads.count - imm_renderer->command_quad_start) / 4;
+    if (vertex_count == 0 && quad_count == 0) return;
 
     Shader* bound_shader = get_bound_shader();
     static b32 thrown_bound_shader_error = false;
@@ -315,21 +1391,347 @@ void imm_flush(void) {
             o_log_error("[Draw] Tried to flush imm_renderer when no shader was bound. \n");
             thrown_bound_shader_error = true;
         }
+        imm_renderer->triangles.count = imm_renderer->command_start;
+        imm_renderer->quads.count     = imm_renderer->command_quad_start;
         return;
     }
     thrown_bound_shader_error = false;
 
-    glBindVertexArray(imm_renderer->vao);
-    glBindBuffer(GL_ARRAY_BUFFER, imm_renderer->vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(imm_renderer->vertices[0]) * imm_renderer->vertex_count, imm_renderer->vertices, GL_STREAM_DRAW);
+    Render_Command command = {
+        .view             = current_render_view(),
+        .shader           = bound_shader,
+        .texture          = g_gl_context->bound_texture,
+        .texture_location = g_gl_context->bound_texture_location,
+        .first_vertex     = imm_renderer->command_start,
+        .vertex_count     = vertex_count,
+        .first_quad       = imm_renderer->command_quad_start / 4,
+        .quad_count       = quad_count,
+    };
+
+    // Farthest z in the command. Further is more negative so ascending order draws back to front
+    f32 depth_01 = (imm_renderer->command_min_z + FAR_CLIP_PLANE) / FAR_CLIP_PLANE;
+    if (depth_01 < 0.f) depth_01 = 0.f;
+    if (depth_01 > 1.f) depth_01 = 1.f;
+
+    // layer:8 | depth:24 | shader:8 | texture:8 | command index:16
+    // Everything blends so depth goes above the state. Sorting by state first would draw translucent commands out of
+    // order across shaders and textures. Commands at the same depth are still grouped by state
+    u64 shader_id  = (u64)find_or_add_render_shader(bound_shader);
+    u64 texture_id = (u64)find_or_add_render_texture(command.texture);
+    u64 depth      = (u64)(depth_01 * (f32)0xFFFFFF);
+    u64 index      = (u64)imm_renderer->command_count;
+
+    imm_renderer->sort_keys[imm_renderer->command_count] = ((u64)command.view << 56) | (depth << 32) | (shader_id << 24) | (texture_id << 16) | index;
+    imm_renderer->commands[imm_renderer->command_count] = command;
+    imm_renderer->command_count += 1;
+    imm_renderer->command_start      = imm_renderer->triangles.count;
+    imm_renderer->command_quad_start = imm_renderer->quads.count;
+    imm_renderer->command_min_z      = F32_MAX;
+
+    draw_state->stats.num_draw_commands += 1;
+}
 
-    set_imm_vertex_format();
-    
-    glDrawArrays(GL_TRIANGLES, 0, imm_renderer->vertex_count);
+// Bottom up merge sort that ping pongs between the buffers. Returns whichever one holds the result
+static u64* sort_render_keys(u64* keys, u64* scratch, int count) {
+    for (int width = 1; width < count; width *= 2) {
+        for (int i = 0; i < count; i += width * 2) {
+            int left = i;
+            int mid  = i + width < count ? i + width : count;
+            int end  = i + width * 2 < count ? i + width * 2 : count;
+
+            int a = left;
+            int b = mid;
+            for (int j = left; j < end; ++j) {
+                if (a < mid && (b >= end || keys[a] < keys[b])) scratch[j] = keys[a++];
+                else scratch[j] = keys[b++];
+            }
+        }
+
+        u64* temp = keys;
+        keys = scratch;
+        scratch = temp;
+    }
 
-    draw_state->draw_call_duration += g_platform->time_in_seconds() - start_time;
-    draw_state->num_draw_calls += 1;
-    draw_state->vertices_drawn += imm_renderer->vertex_count;
+    return keys;
+}
+
+static Imm_Ring make_cpu_imm_ring(int vertex_size, int region_cap) {
+    Imm_Ring result = {
+        .vertex_size = vertex_size,
+        .region_cap  = region_cap,
+        .is_cpu      = true,
+        .ring        = mem_alloc(heap_allocator(), (usize)vertex_size * region_cap),
+    };
+    begin_imm_region(&result);
+    return result;
+}
+
+void begin_raster_capture(Raster_Target* target) {
+    assert(!imm_renderer->capture);
+
+    // Anything already queued is for gl
+    flush_render_commands();
+
+    imm_renderer->gl_triangles = imm_renderer->triangles;
+    imm_renderer->gl_quads     = imm_renderer->quads;
+    imm_renderer->triangles    = make_cpu_imm_ring(sizeof(Immediate_Vertex), MAX_IMM_VERTS);
+    imm_renderer->quads        = make_cpu_imm_ring(sizeof(Quad_Vertex), MAX_IMM_QUADS * 4);
+    imm_renderer->capture      = target;
+}
+
+void end_raster_capture(void) {
+    assert(imm_renderer->capture);
+    flush_render_commands();
+
+    mem_free(heap_allocator(), imm_renderer->triangles.ring);
+    mem_free(heap_allocator(), imm_renderer->quads.ring);
+    imm_renderer->triangles = imm_renderer->gl_triangles;
+    imm_renderer->quads     = imm_renderer->gl_quads;
+    imm_renderer->capture   = 0;
+}
+
+b32 is_raster_capturing(void) { return imm_renderer->capture != 0; }
+
+// Textures are read back from gl the first time a target sees them. Gl hands sRGB textures back without decoding
+static Raster_Texture* find_or_read_raster_texture(Raster_Target* target, GLuint id) {
+    if (!id) return 0;
+
+    Raster_Texture* found = find_raster_texture(target, id);
+    if (found) return found;
+
+    GLint width, height, internal_format;
+    glBindTexture(GL_TEXTURE_2D, id);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+
+    b32 is_srgb = internal_format == GL_SRGB_ALPHA || internal_format == GL_SRGB8_ALPHA8;
+    Raster_Texture* result = add_raster_texture(target, id, width, height, is_srgb);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, result->pixels);
+    if (is_distance_atlas(id)) result->distance_per_texel = SDF_PIXEL_DIST_SCALE / 255.f;
+
+    // The active unit is still the one the caller last set a texture on
+    glBindTexture(GL_TEXTURE_2D, g_gl_context->bound_texture);
+    return result;
+}
+
+static f32 unpack_snorm16(s16 x) {
+    f32 result = (f32)x / 32767.f;
+    return result < -1.f ? -1.f : result;
+}
+
+// Rasterizes the sorted commands into the capture target. Each command's triangles go before its quads
+static void raster_render_commands(u64* sorted, int command_count) {
+    Raster_Target* target = imm_renderer->capture;
+    Immediate_Vertex* triangle_vertices = (Immediate_Vertex*)imm_renderer->triangles.vertices;
+    Quad_Vertex* quad_vertices = (Quad_Vertex*)imm_renderer->quads.vertices;
+
+    for (int i = 0; i < command_count; ++i) {
+        Render_Command* command = &imm_renderer->commands[sorted[i] & 0xFFFF];
+        Render_View* view = &imm_renderer->views[command->view];
+        Matrix4 mvp = m4_mul(view->projection, view->view);
+
+        // Same box draw_render_commands gives glScissor
+        if (view->has_scissor) {
+            Vector2 size = rect_size(view->scissor);
+            set_raster_scissor(target, (int)view->scissor.min.x, (int)view->scissor.min.y, (int)MAX(size.width, 0.f), (int)MAX(size.height, 0.f));
+        } else {
+            clear_raster_scissor(target);
+        }
+
+        // The font shaders take their alpha from an atlas. Everything else drawn through imm is basic2d
+        Raster_Shading shading = RS_Textured;
+        if (command->shader->uniform_indices[SU_Atlas] >= 0)          shading = RS_Coverage;
+        if (command->shader->uniform_indices[SU_Distance_Atlas] >= 0) shading = RS_Distance;
+        Raster_Texture* texture = find_or_read_raster_texture(target, command->texture);
+
+        int vertex_count = command->vertex_count + command->quad_count * 6;
+        Raster_Vertex* vertices = mem_alloc_array(g_platform->frame_arena, Raster_Vertex, vertex_count);
+        Raster_Vertex* at = vertices;
+
+        for (int j = 0; j < command->vertex_count; ++j) {
+            Immediate_Vertex* v = &triangle_vertices[command->first_vertex + j];
+            *at++ = (Raster_Vertex) { v->position, v->uv, v->color };
+        }
+
+        static const int quad_indices[6] = { 3, 0, 2, 0, 1, 2 };
+        for (int j = 0; j < command->quad_count; ++j) {
+            Quad_Vertex* quad = &quad_vertices[(command->first_quad + j) * 4];
+            for (int k = 0; k < 6; ++k) {
+                Quad_Vertex* v = &quad[quad_indices[k]];
+                *at++ = (Raster_Vertex) {
+                    .position = v->position,
+                    .uv       = v2(unpack_snorm16(v->uv[0]), unpack_snorm16(v->uv[1])),
+                    .color    = v4(v->color[0] / 255.f, v->color[1] / 255.f, v->color[2] / 255.f, v->color[3] / 255.f),
+                };
+            }
+        }
+
+        raster_triangles(target, mvp, shading, texture, vertices, vertex_count);
+    }
+    clear_raster_scissor(target);
+}
+
+// The region is fenced once a frame even if it isn't full so a region never holds more than a frame of vertices
+void next_imm_frame(void) {
+    assert(imm_renderer->command_count == 0);
+
+    Imm_Ring* rings[] = { &imm_renderer->triangles, &imm_renderer->quads };
+    for (int i = 0; i < array_count(rings); ++i) {
+        Imm_Ring* ring = rings[i];
+        if (ring->is_cpu || ring->count == 0) continue;
+
+        end_imm_region(ring);
+        next_imm_region(ring);
+    }
+
+    imm_renderer->command_start      = imm_renderer->triangles.count;
+    imm_renderer->command_quad_start = imm_renderer->quads.count;
+}
+
+// Draws the sorted commands straight out of the rings
+static void draw_render_commands(u64* sorted, int command_count) {
+    Imm_Ring* triangles = &imm_renderer->triangles;
+    Imm_Ring* quads     = &imm_renderer->quads;
+
+    draw_state->stats.vertex_bytes += (usize)(triangles->count - triangles->start) * triangles->vertex_size + (usize)(quads->count - quads->start) * quads->vertex_size;
+
+    // The vertices are already in the rings. Runs of matching state become one multi draw per ring over their ranges
+    end_imm_region(triangles);
+    end_imm_region(quads);
+    int triangle_base = triangles->region_cap * triangles->region;
+    int quad_base     = quads->region_cap * quads->region;
+
+    GLint*   triangle_firsts = mem_alloc_array(g_platform->frame_arena, GLint, command_count);
+    GLsizei* triangle_counts = mem_alloc_array(g_platform->frame_arena, GLsizei, command_count);
+    GLsizei* quad_counts     = mem_alloc_array(g_platform->frame_arena, GLsizei, command_count);
+    void**   quad_offsets    = mem_alloc_array(g_platform->frame_arena, void*, command_count);
+    GLint*   quad_bases      = mem_alloc_array(g_platform->frame_arena, GLint, command_count);
+
+    Render_Command* bound = 0;
+    b32 used_scissor = false;
+    for (int i = 0; i < command_count;) {
+        Render_Command* first = &imm_renderer->commands[sorted[i] & 0xFFFF];
+
+        // Consecutive keys with the same layer, shader and texture merge. Merging anything further apart would
+        // draw it out of depth order
+        int j = i + 1;
+        for (; j < command_count; ++j) {
+            u64 state_mask = 0xFF000000FFFF0000ull;
+            if ((sorted[j] & state_mask) != (sorted[i] & state_mask)) break;
+        }
+
+        if (!bound || bound->shader != first->shader) {
+            set_shader(first->shader);
+            bound = 0;
+        }
+        if (!bound || bound->view != first->view) {
+            Render_View* view = &imm_renderer->views[first->view];
+            set_uniform_m4(SU_View, view->view);
+            set_uniform_m4(SU_Projection, view->projection);
+
+            if (view->has_scissor) {
+                Vector2 size = rect_size(view->scissor);
+                glEnable(GL_SCISSOR_TEST);
+                glScissor((GLint)view->scissor.min.x, (GLint)view->scissor.min.y, (GLsizei)MAX(size.width, 0.f), (GLsizei)MAX(size.height, 0.f));
+                used_scissor = true;
+            } else if (used_scissor) {
+                glDisable(GL_SCISSOR_TEST);
+            }
+        }
+        if (first->texture && (!bound || bound->texture != first->texture)) set_uniform_texture_at(first->texture_location, first->texture);
+        bound = first;
+
+        // The run goes out as multi draws over whichever ring each command used. Switching rings draws what's
+        // pending first so commands stay in order. Within a command the triangles land before the quads
+        int triangle_run = 0;
+        int quad_run = 0;
+        for (int k = i; k <= j; ++k) {
+            Render_Command* command = k < j ? &imm_renderer->commands[sorted[k] & 0xFFFF] : 0;
+
+            // Pending triangles always came before the pending quads
+            b32 flush_quads     = quad_run > 0 && (!command || command->vertex_count > 0);
+            b32 flush_triangles = triangle_run > 0 && (!command || command->quad_count > 0 || flush_quads);
+            if (flush_triangles) {
+                glBindVertexArray(triangles->vao);
+                glMultiDrawArrays(GL_TRIANGLES, triangle_firsts, triangle_counts, triangle_run);
+                draw_state->stats.num_draw_calls += 1;
+                triangle_run = 0;
+            }
+            if (flush_quads) {
+                glBindVertexArray(quads->vao);
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, quad_counts, GL_UNSIGNED_SHORT, (const void* const*)quad_offsets, quad_run, quad_bases);
+                draw_state->stats.num_draw_calls += 1;
+                quad_run = 0;
+            }
+            if (!command) break;
+
+            if (command->vertex_count > 0) {
+                triangle_firsts[triangle_run] = triangle_base + command->first_vertex;
+                triangle_counts[triangle_run] = command->vertex_count;
+                triangle_run += 1;
+            }
+            if (command->quad_count > 0) {
+                quad_counts[quad_run]  = command->quad_count * 6;
+                quad_offsets[quad_run] = (void*)(sizeof(u16) * 6 * command->first_quad);
+                quad_bases[quad_run]   = quad_base;
+                quad_run += 1;
+            }
+            draw_state->stats.vertices_drawn += command->vertex_count + command->quad_count * 4;
+        }
+
+        i = j;
+    }
+
+    if (used_scissor) glDisable(GL_SCISSOR_TEST);
+}
+
+void flush_render_commands(void) {
+    Imm_Ring* triangles = &imm_renderer->triangles;
+    Imm_Ring* quads     = &imm_renderer->quads;
+
+    // Nothing queued means nothing was written past the last flush
+    int command_count = imm_renderer->command_count;
+    if (command_count == 0) return;
+
+    f64 start_time = g_platform->time_in_seconds();
+
+    // Whatever the caller had bound is put back after so they can keep going
+    Shader* old_shader = get_bound_shader();
+    GLuint old_texture = g_gl_context->bound_texture;
+    GLint old_texture_location = g_gl_context->bound_texture_location;
+
+    Temp_Memory temp_memory = begin_temp_memory(g_platform->frame_arena);
+
+    u64* keys = mem_alloc_array(g_platform->frame_arena, u64, command_count * 2);
+    u64* scratch = keys + command_count;
+    mem_copy(keys, imm_renderer->sort_keys, sizeof(u64) * command_count);
+
+    // Keys are unique because the low bits are the command index
+    u64* sorted = sort_render_keys(keys, scratch, command_count);
+
+    if (imm_renderer->capture) raster_render_commands(sorted, command_count);
+    else gpu_scope("Commands") draw_render_commands(sorted, command_count);
+
+    end_temp_memory(temp_memory);
+
+    continue_imm_region(triangles);
+    continue_imm_region(quads);
+
+    imm_renderer->command_start      = triangles->count;
+    imm_renderer->command_quad_start = quads->count;
+    imm_renderer->command_count = 0;
+    imm_renderer->view_count    = 0;
+    imm_renderer->shader_count  = 0;
+    imm_renderer->texture_count = 0;
+
+    set_shader(old_shader);
+    if (old_shader) {
+        refresh_shader_transform();
+        if (old_texture) set_uniform_texture_at(old_texture_location, old_texture);
+    }
+
+    draw_state->stats.draw_call_duration += g_platform->time_in_seconds() - start_time;
 }
 
 void set_imm_vertex_format(void) {
@@ -350,36 +1752,116 @@ void set_imm_vertex_format(void) {
     glEnableVertexAttribArray(color_loc);
 }
 
+void set_imm_quad_vertex_format(void) {
+    GLuint position_loc = 0;
+    glVertexAttribPointer(position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(Quad_Vertex), 0);
+    glEnableVertexAttribArray(position_loc);
+
+    // No normal. The shaders get the default attribute value
+    glDisableVertexAttribArray(1);
+
+    GLuint uv_loc = 2;
+    glVertexAttribPointer(uv_loc, 2, GL_SHORT, GL_TRUE, sizeof(Quad_Vertex), (void*)sizeof(Vector3));
+    glEnableVertexAttribArray(uv_loc);
+
+    GLuint color_loc = 3;
+    glVertexAttribPointer(color_loc, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Quad_Vertex), (void*)(sizeof(Vector3) + sizeof(s16) * 2));
+    glEnableVertexAttribArray(color_loc);
+}
+
+static void track_command_z(f32 z) {
+    if (z < imm_renderer->command_min_z) imm_renderer->command_min_z = z;
+
+    Imm_Snapshot* snapshot = imm_renderer->snapshot;
+    if (snapshot && z < snapshot->min_z) snapshot->min_z = z;
+}
+
+static void push_snapshot_quads(Quad_Vertex* vertices, int quad_count) {
+    Imm_Snapshot* s = imm_renderer->snapshot;
+    if (!s || !quad_count) return;
+
+    if (s->quad_count + quad_count > s->quad_cap) {
+        int new_cap = MAX(s->quad_count + quad_count, s->quad_cap * 2);
+        s->vertices = mem_realloc(heap_allocator(), s->vertices, sizeof(Quad_Vertex) * 4 * new_cap);
+        s->quad_cap = new_cap;
+    }
+    mem_copy((Quad_Vertex*)s->vertices + s->quad_count * 4, vertices, sizeof(Quad_Vertex) * 4 * quad_count);
+    s->quad_count += quad_count;
+}
+
 void imm_vertex(Vector3 position, Vector3 normal, Vector2 uv, Vector4 color) {
-    if (imm_renderer->vertex_count == MAX_IMM_VERTS) {
+    Imm_Ring* ring = &imm_renderer->triangles;
+    if (ring->count == ring->region_cap) {
         imm_flush();
+        flush_render_commands();
         imm_begin();
     }
 
-    Immediate_Vertex* this_vertex = imm_renderer->vertices + imm_renderer->vertex_count++;
+    track_command_z(position.z);
+    if (imm_renderer->snapshot) imm_renderer->snapshot->is_valid = false;
+
+    // This is gpu visible write combined memory so only ever write it
+    Immediate_Vertex* this_vertex = (Immediate_Vertex*)imm_ring_vertex(ring);
+    ring->count += 1;
     *this_vertex = (Immediate_Vertex) { position, normal, uv, color };
 }
 
-void imm_textured_rect(Rect rect, f32 z, Vector2 uv0, Vector2 uv1, Vector4 color) {
-    Vector3 top_left_pos      = v3(rect.min.x, rect.max.y, z);
-    Vector3 top_right_pos     = v3xy(rect.max, z);
-    Vector3 bottom_left_pos   = v3xy(rect.min, z);
-    Vector3 bottom_right_pos  = v3(rect.max.x, rect.min.y, z);
+// -1 is the shaders' no texture uv. It's packed as -32768 since that's exactly -1 under both the pre 4.2 rule of
+// (2c + 1) / 65535 that a 3.3 context may use and the newer max(c / 32767, -1). -32767 would come out above -1
+static s16 pack_snorm16(f32 x) {
+    if (x <= -1.f) return -32768;
+    if (x > 1.f) x = 1.f;
+    return (s16)(x * 32767.f + (x < 0.f ? -0.5f : 0.5f));
+}
 
-    Vector2 top_left_uv       = v2(uv0.x, uv1.y);
-    Vector2 top_right_uv      = v2(uv1.x, uv1.y);
-    Vector2 bottom_left_uv    = v2(uv0.x, uv0.y);
-    Vector2 bottom_right_uv   = v2(uv1.x, uv0.y);
+static u8 pack_unorm8(f32 x) {
+    if (x < 0.f) x = 0.f;
+    if (x > 1.f) x = 1.f;
+    return (u8)(x * 255.f + 0.5f);
+}
+
+void imm_quad(Vector3 p0, Vector3 p1, Vector3 p2, Vector3 p3, Vector2 uv0, Vector2 uv1, Vector4 color) {
+    Imm_Ring* ring = &imm_renderer->quads;
+    if (ring->count == ring->region_cap) {
+        imm_flush();
+        flush_render_commands();
+        imm_begin();
+    }
 
-    Vector3 normal = v3z(); // @Incomplete
+    track_command_z(p0.z);
+    track_command_z(p1.z);
+    track_command_z(p2.z);
+    track_command_z(p3.z);
+
+    s16 u0 = pack_snorm16(uv0.x);
+    s16 v0 = pack_snorm16(uv0.y);
+    s16 u1 = pack_snorm16(uv1.x);
+    s16 v1 = pack_snorm16(uv1.y);
+    u8 r = pack_unorm8(color.r);
+    u8 g = pack_unorm8(color.g);
+    u8 b = pack_unorm8(color.b);
+    u8 a = pack_unorm8(color.a);
+
+    Quad_Vertex quad[4] = {
+        { p0, { u0, v0 }, { r, g, b, a } },
+        { p1, { u1, v0 }, { r, g, b, a } },
+        { p2, { u1, v1 }, { r, g, b, a } },
+        { p3, { u0, v1 }, { r, g, b, a } },
+    };
+    push_snapshot_quads(quad, 1);
+
+    // This is gpu visible write combined memory so only ever write it
+    mem_copy(imm_ring_vertex(ring), quad, sizeof(quad));
+    ring->count += 4;
+}
 
-    imm_vertex(top_left_pos, normal, top_left_uv, color);
-    imm_vertex(bottom_left_pos, normal, bottom_left_uv, color);
-    imm_vertex(top_right_pos, normal, top_right_uv, color);
+void imm_textured_rect(Rect rect, f32 z, Vector2 uv0, Vector2 uv1, Vector4 color) {
+    Vector3 bottom_left_pos   = v3xy(rect.min, z);
+    Vector3 bottom_right_pos  = v3(rect.max.x, rect.min.y, z);
+    Vector3 top_right_pos     = v3xy(rect.max, z);
+    Vector3 top_left_pos      = v3(rect.min.x, rect.max.y, z);
 
-    imm_vertex(bottom_left_pos, normal, bottom_left_uv, color);
-    imm_vertex(bottom_right_pos, normal, bottom_right_uv, color);
-    imm_vertex(top_right_pos, normal, top_right_uv, color);
+    imm_quad(bottom_left_pos, bottom_right_pos, top_right_pos, top_left_pos, uv0, uv1, color);
 }
 
 void imm_textured_border_rect(Rect rect, f32 z, f32 thickness, Vector2 uv0, Vector2 uv1, Vector4 color) {
@@ -425,20 +1907,7 @@ void imm_textured_line(Vector2 a1, Vector2 a2, f32 z, f32 thickness, Vector2 uv0
     Vector3 top_right     = v3xy(v2_add(a2, perp), z);
     Vector3 bottom_right  = v3xy(v2_add(a1, perp), z);
 
-    Vector2 top_left_uv       = v2(uv0.x, uv1.y);
-    Vector2 top_right_uv      = v2(uv1.x, uv1.y);
-    Vector2 bottom_left_uv    = v2(uv0.x, uv0.y);
-    Vector2 bottom_right_uv   = v2(uv1.x, uv0.y);
-    
-    Vector3 normal = v3s(0.f); // @Incomplete
-
-    imm_vertex(top_left, normal, top_left_uv, color);
-    imm_vertex(bottom_left, normal, bottom_left_uv, color);
-    imm_vertex(top_right, normal, top_right_uv, color);
-
-    imm_vertex(bottom_left, normal, bottom_left_uv, color);
-    imm_vertex(bottom_right, normal, bottom_right_uv, color);
-    imm_vertex(top_right, normal, top_right_uv, color);
+    imm_quad(bottom_left, bottom_right, top_right, top_left, uv0, uv1, color);
 }
 
 void imm_arrow(Vector2 a1, Vector2 a2, f32 z, f32 thickness, Vector4 color) {
@@ -479,10 +1948,10 @@ void imm_textured_circle(f32 radius, int segments, Vector2 xy, f32 z, Vector2 uv
 }
 
 void imm_glyph(Font_Glyph* g, Font* font, f32 size, Vector2 xy, f32 z, Vector4 color) {
-    f32 scale = size / (f32)font->size;
+    f32 scale = size / font->glyph_size;
 
     // Draw font from bottom up. Yes this makes doing paragraphs harder but it goes along with OpenGL's coordinate system
-    xy = v2_sub(xy, v2(0.f, font->descent * scale));
+    xy = v2_sub(xy, v2(0.f, font->descent * size / (f32)font->size));
     f32 x0 = xy.x + g->bearing_x * scale;
     f32 y1 = xy.y - g->bearing_y * scale;
     f32 x1 = x0 + g->width * scale;
@@ -502,75 +1971,295 @@ Font_Glyph* imm_rune(Rune r, Font* font, f32 size, Vector2 xy, f32 z, Vector4 co
     return 0;
 }
 
-void imm_string(String str, Font* font, f32 size, f32 max_width, Vector2 xy, f32 z, Vector4 color) {
-    Vector2 orig_xy = xy;
+static u64 text_layout_key(String str, Font* font, f32 size, f32 max_width) {
+    u32 size_bits, width_bits;
+    mem_copy(&size_bits, &size, sizeof(u32));
+    mem_copy(&width_bits, &max_width, sizeof(u32));
+
+    u64 params[4] = {
+        hash_bytes(str.data, str.len),
+        (u64)(usize)font,
+        ((u64)size_bits << 32) | (u64)width_bits,
+        (u64)str.len,
+    };
+    u64 key = hash_bytes(params, sizeof(params));
+    return key ? key : 1; // 0 is a free layout
+}
+
+static void push_text_quad(Text_Layout* layout, Cached_Glyph* cached, Rect rect) {
+    if (layout->quad_count == layout->quad_cap) {
+        layout->quad_cap = layout->quad_cap ? layout->quad_cap * 2 : 16;
+        layout->quads    = mem_realloc(heap_allocator(), layout->quads, sizeof(Text_Quad) * layout->quad_cap);
+        layout->vertices = mem_realloc(heap_allocator(), layout->vertices, sizeof(Quad_Vertex) * 4 * layout->quad_cap);
+    }
+    layout->quads[layout->quad_count++] = (Text_Quad) { rect, cached->glyph.uv0, cached->glyph.uv1 };
+
+    // A shelf_count past the cap means the layout can't be reused
+    if (layout->shelf_count > TEXT_LAYOUT_SHELF_CAP) return;
+    for (int i = 0; i < layout->shelf_count; ++i) {
+        if (layout->shelves[i] == cached->shelf) return;
+    }
+    if (layout->shelf_count < TEXT_LAYOUT_SHELF_CAP) layout->shelves[layout->shelf_count] = cached->shelf;
+    layout->shelf_count += 1;
+}
+
+// Lines go down from xy like imm_string always has. The extent is measured the way font_string_rect always has
+static void build_text_layout(Text_Layout* layout, u64 key, String str, Font* font, f32 size, f32 max_width) {
+    draw_state->stats.text_layout_misses += 1;
+
+    layout->key          = key;
+    layout->quad_count   = 0;
+    layout->shelf_count  = 0;
+    layout->has_vertices = false;
 
-    f32 scale = size / (f32)font->size;
+    if (str.len > layout->text_cap) {
+        layout->text_cap = MAX(str.len, layout->text_cap * 2);
+        layout->text     = mem_realloc(heap_allocator(), layout->text, layout->text_cap);
+    }
+    mem_copy(layout->text, str.data, str.len);
+    layout->text_len  = str.len;
+    layout->font      = font;
+    layout->size      = size;
+    layout->max_width = max_width;
+
+    f32 scale   = size / font->glyph_size;
+    f32 descent = font->descent * size / (f32)font->size;
+
+    Vector2 xy = v2z();
+    f32 width  = 0.f;
+    f32 height = size;
 
     Font_Glyph* space_g = glyph_from_rune(font, ' ');
+    f32 space_advance = space_g ? space_g->advance * scale : 0.f;
     for (int i = 0; i < str.len; ++i) {
-        if (xy.x + space_g->advance * scale > orig_xy.x + max_width) {
-            xy.x = orig_xy.x ;
+        if (xy.x + space_advance > max_width) {
+            xy.x = 0.f;
             xy.y -= size;
         }
 
         char c = str.data[i]; // @TODO(colby): UTF8
         switch (c) {
         case '\n': {
-            xy.x = orig_xy.x;
+            xy.x = 0.f;
             xy.y -= size;
         } break;
         case '\r': {
-            xy.x = orig_xy.x;
+            xy.x = 0.f;
         } break;
         case '\t': {
-            xy.x += space_g->advance * 4.f * scale;
+            xy.x += space_advance * 4.f;
         } break;
         default: {
-            Font_Glyph* g = imm_rune(c, font, size, xy, z, color);
-            if (g) xy.x += g->advance * scale;
+            Cached_Glyph* cached = find_cached_glyph(font, c);
+            if (!cached) break;
+
+            // Draw font from bottom up. Yes this makes doing paragraphs harder but it goes along with OpenGL's coordinate system
+            Font_Glyph* g = &cached->glyph;
+            if (g->width > 0.f) {
+                f32 x0 = xy.x + g->bearing_x * scale;
+                f32 y1 = xy.y - descent - g->bearing_y * scale;
+                f32 x1 = x0 + g->width * scale;
+                f32 y0 = y1 - g->height * scale;
+                push_text_quad(layout, cached, rect_from_raw(x0, y0, x1, y1));
+            }
+            xy.x += g->advance * scale;
         } break;
         }
+
+        if (xy.x > width) width = xy.x;
+        if (-xy.y > height) height = -xy.y;
     }
+
+    layout->extent = v2(width, height);
+
+    // Glyphs looked up above were touched this frame so anything evicted while laying out wasn't one of them
+    layout->glyph_generation = glyph_cache->generation;
 }
 
-Rect font_string_rect(String str, Font* font, f32 max_width) {
-    f32 width = 0.f;
-    f32 height = (f32)font->size;
+// Returns -1 if every layout was used this frame
+static int alloc_text_layout(void) {
+    Text_Layout_Cache* cache = text_layout_cache;
 
-    Vector2 xy = v2z();
-    Vector2 orig_xy = xy;
+    // When full everything that wasn't drawn this frame is let go
+    if (cache->first_free == -1 && cache->layout_count == TEXT_LAYOUT_CAP) {
+        for (int i = 0; i < cache->layout_count; ++i) {
+            Text_Layout* layout = &cache->layouts[i];
+            if (!layout->key || layout->last_used >= g_platform->current_frame_time) continue;
 
-    Font_Glyph* space_g = glyph_from_rune(font, ' ');
-    for (int i = 0; i < str.len; ++i) {
-        if (xy.x + space_g->advance > orig_xy.x + max_width) {
-            xy.x = orig_xy.x ;
-            xy.y += (f32)font->size;
+            remove_hash_table(&cache->lookup, layout->key);
+            layout->key = 0;
+            layout->next_free = cache->first_free;
+            cache->first_free = i;
         }
+    }
 
-        char c = str.data[i]; // @TODO(colby): UTF8
-        switch (c) {
-        case '\n': {
-            xy.x = orig_xy.x;
-            xy.y += (f32)font->size;
-        } break;
-        case '\r': {
-            xy.x = orig_xy.x;
-        } break;
-        case '\t': {
-            xy.x += space_g->advance * 4.f;
-        } break;
-        default: {
-            Font_Glyph* g = glyph_from_rune(font, c);
-            if (g) xy.x += g->advance;
-        } break;
+    int index = cache->first_free;
+    if (index != -1) {
+        cache->first_free = cache->layouts[index].next_free;
+        return index;
+    }
+    if (cache->layout_count < TEXT_LAYOUT_CAP) return cache->layout_count++;
+    return -1;
+}
+
+static Text_Layout* find_text_layout(String str, Font* font, f32 size, f32 max_width) {
+    Text_Layout_Cache* cache = text_layout_cache;
+    u64 key = text_layout_key(str, font, size, max_width);
+    f64 now = g_platform->current_frame_time;
+
+    Text_Layout* layout = 0;
+    int* found = find_hash_table(&cache->lookup, key);
+    if (found) {
+        layout = &cache->layouts[*found];
+
+        b32 is_same = layout->font == font && layout->size == size && layout->max_width == max_width &&
+                      layout->text_len == str.len && mem_cmp(layout->text, str.data, str.len) == 0;
+        b32 is_valid = is_same && layout->glyph_generation == glyph_cache->generation && layout->shelf_count <= TEXT_LAYOUT_SHELF_CAP;
+        if (is_valid) {
+            for (int i = 0; i < layout->shelf_count; ++i) {
+                if (layout->shelves[i] >= 0) glyph_cache->shelves[layout->shelves[i]].last_used = now;
+            }
+            draw_state->stats.text_layout_hits += 1;
+        } else {
+            build_text_layout(layout, key, str, font, size, max_width);
         }
+    } else {
+        int index = alloc_text_layout();
+        if (index == -1) {
+            layout = &cache->scratch;
+        } else {
+            layout = &cache->layouts[index];
+            push_hash_table(&cache->lookup, key, index);
+        }
+        build_text_layout(layout, key, str, font, size, max_width);
+    }
 
-        if (xy.x > width) width = xy.x;
-        if (xy.y > height) height = xy.y;
+    layout->last_used = now;
+    return layout;
+}
+
+// Copied as much as fits in the region at a time in case the ring fills partway through
+static void copy_imm_quads(Quad_Vertex* vertices, int quads_left, f32 min_z) {
+    push_snapshot_quads(vertices, quads_left);
+
+    Imm_Ring* ring = &imm_renderer->quads;
+    while (quads_left > 0) {
+        if (ring->count == ring->region_cap) {
+            imm_flush();
+            flush_render_commands();
+            imm_begin();
+        }
+        track_command_z(min_z);
+
+        int quad_count = MIN(quads_left, (ring->region_cap - ring->count) / 4);
+        mem_copy(imm_ring_vertex(ring), vertices, sizeof(Quad_Vertex) * 4 * quad_count);
+        ring->count += quad_count * 4;
+        vertices    += quad_count * 4;
+        quads_left  -= quad_count;
+    }
+}
+
+static void add_snapshot_shelf(Imm_Snapshot* s, int shelf) {
+    for (int i = 0; i < s->shelf_count; ++i) {
+        if (s->shelves[i] == shelf) return;
+    }
+
+    // Glyphs on shelves that can't be touched could be evicted out from under it
+    if (s->shelf_count == IMM_SNAPSHOT_SHELF_CAP) {
+        s->is_valid = false;
+        return;
+    }
+    s->shelves[s->shelf_count++] = shelf;
+}
+
+static void imm_text_layout(Text_Layout* layout, Vector2 xy, f32 z, Vector4 color) {
+    if (!layout->quad_count) return;
+
+    u8 rgba[4] = { pack_unorm8(color.r), pack_unorm8(color.g), pack_unorm8(color.b), pack_unorm8(color.a) };
+    u32 packed_color;
+    mem_copy(&packed_color, rgba, sizeof(u32));
+
+    // Same corners and uvs as imm_textured_rect
+    Vector3 at = v3xy(xy, z);
+    if (!layout->has_vertices || !v3_equal(layout->drawn_at, at) || layout->drawn_color != packed_color) {
+        for (int i = 0; i < layout->quad_count; ++i) {
+            Text_Quad* quad = &layout->quads[i];
+            Rect rect = { v2_add(quad->rect.min, xy), v2_add(quad->rect.max, xy) };
+            s16 u0 = pack_snorm16(quad->uv0.x);
+            s16 v0 = pack_snorm16(quad->uv0.y);
+            s16 u1 = pack_snorm16(quad->uv1.x);
+            s16 v1 = pack_snorm16(quad->uv1.y);
+
+            Quad_Vertex* v = layout->vertices + i * 4;
+            v[0] = (Quad_Vertex) { v3xy(rect.min, z), { u0, v0 }, { rgba[0], rgba[1], rgba[2], rgba[3] } };
+            v[1] = (Quad_Vertex) { v3(rect.max.x, rect.min.y, z), { u1, v0 }, { rgba[0], rgba[1], rgba[2], rgba[3] } };
+            v[2] = (Quad_Vertex) { v3xy(rect.max, z), { u1, v1 }, { rgba[0], rgba[1], rgba[2], rgba[3] } };
+            v[3] = (Quad_Vertex) { v3(rect.min.x, rect.max.y, z), { u0, v1 }, { rgba[0], rgba[1], rgba[2], rgba[3] } };
+        }
+        layout->has_vertices = true;
+        layout->drawn_at     = at;
+        layout->drawn_color  = packed_color;
+    }
+
+    Imm_Snapshot* snapshot = imm_renderer->snapshot;
+    if (snapshot) {
+        if (layout->shelf_count > TEXT_LAYOUT_SHELF_CAP) snapshot->is_valid = false;
+        for (int i = 0; i < layout->shelf_count && i < TEXT_LAYOUT_SHELF_CAP; ++i) {
+            if (layout->shelves[i] >= 0) add_snapshot_shelf(snapshot, layout->shelves[i]);
+        }
+    }
+
+    copy_imm_quads(layout->vertices, layout->quad_count, z);
+}
+
+void imm_string(String str, Font* font, f32 size, f32 max_width, Vector2 xy, f32 z, Vector4 color) {
+    Text_Layout* layout = find_text_layout(str, font, size, max_width);
+    imm_text_layout(layout, xy, z, color);
+}
+
+Rect font_string_rect(String str, Font* font, f32 max_width) {
+    Text_Layout* layout = find_text_layout(str, font, (f32)font->size, max_width);
+    return (Rect) { v2z(), layout->extent };
+}
+
+void begin_imm_snapshot(Imm_Snapshot* s) {
+    assert(!imm_renderer->snapshot);
+
+    s->quad_count       = 0;
+    s->min_z            = F32_MAX;
+    s->shelf_count      = 0;
+    s->glyph_generation = glyph_cache->generation;
+    s->is_valid         = true;
+    imm_renderer->snapshot = s;
+}
+
+int imm_snapshot_quad_count(Imm_Snapshot* s) { return s->quad_count; }
+
+void end_imm_snapshot(Imm_Snapshot* s) {
+    assert(imm_renderer->snapshot == s);
+    imm_renderer->snapshot = 0;
+
+    if (s->glyph_generation != glyph_cache->generation) s->is_valid = false;
+}
+
+b32 is_imm_snapshot_current(Imm_Snapshot* s) { return s->is_valid && s->glyph_generation == glyph_cache->generation; }
+
+void imm_snapshot(Imm_Snapshot* s, int first_quad, int quad_count) {
+    assert(is_imm_snapshot_current(s));
+    assert(first_quad + quad_count <= s->quad_count);
+
+    // Same as reusing a text layout, the glyphs have to be touched so they're still there when this is drawn
+    f64 now = g_platform->current_frame_time;
+    for (int i = 0; i < s->shelf_count; ++i) {
+        glyph_cache->shelves[s->shelves[i]].last_used = now;
     }
 
-    return (Rect) { v2z(), v2(width, height) };
+    copy_imm_quads((Quad_Vertex*)s->vertices + first_quad * 4, quad_count, s->min_z);
+}
+
+void free_imm_snapshot(Imm_Snapshot* s) {
+    if (s->vertices) mem_free(heap_allocator(), s->vertices);
+    *s = (Imm_Snapshot) { 0 };
 }
 
 void imm_textured_plane(Vector3 pos, Quaternion rot, Rect rect, Vector2 uv0, Vector2 uv1, Vector4 color) {
@@ -587,18 +2276,5 @@ void imm_textured_plane(Vector3 pos, Quaternion rot, Rect rect, Vector2 uv0, Vec
     Vector3 bottom_left_pos   = v3_add(pos, v3_add(back, left));
     Vector3 bottom_right_pos  = v3_add(pos, v3_add(back, right));
 
-    Vector2 top_left_uv       = v2(uv0.x, uv1.y);
-    Vector2 top_right_uv      = v2(uv1.x, uv1.y);
-    Vector2 bottom_left_uv    = v2(uv0.x, uv0.y);
-    Vector2 bottom_right_uv   = v2(uv1.x, uv0.y);
-
-    Vector3 normal = v3s(0.f); // @Incomplete
-
-    imm_vertex(top_left_pos, normal, top_left_uv, color);
-    imm_vertex(bottom_left_pos, normal, bottom_left_uv, color);
-    imm_vertex(top_right_pos, normal, top_right_uv, color);
-
-    imm_vertex(bottom_left_pos, normal, bottom_left_uv, color);
-    imm_vertex(bottom_right_pos, normal, bottom_right_uv, color);
-    imm_vertex(top_right_pos, normal, top_right_uv, color);
+    imm_quad(bottom_left_pos, bottom_right_pos, top_right_pos, top_left_pos, uv0, uv1, color);
 }
\ No newline at end of file
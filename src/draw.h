@@ -3,6 +3,7 @@
 
 #include "math.h"
 #include "opengl.h"
+#include "rasterizer.h"
 #include <stb/stb_truetype.h>
 
 typedef struct Mesh_Vertex {
@@ -38,47 +39,84 @@ struct Font_Collection;
 
 typedef struct Font {
     int size;
+    f32 scale; // From font units to pixels at size
     f32 ascent, descent, line_gap;
+    int h_oversample, v_oversample;
 
-    Font_Glyph* glyphs;
-    int glyph_count;
+    u32 cache_id; // Glyphs are cached by this and their glyph index
+    f32 glyph_size; // Pixel size glyph metrics are in. The font size except for distance fields which share one size
+    b32 is_sdf;
 
-    Texture2d atlas;
     stbtt_fontinfo* info; // @HACK(colby): This really sucks
     struct Font_Collection* owner;
 } Font;
 
 #define FONT_CAP 32
+#define CODEPOINT_PAGE_SIZE 256
+#define CODEPOINT_PAGE_COUNT (0x110000 / CODEPOINT_PAGE_SIZE)
 typedef struct Font_Collection {
     stbtt_fontinfo info;
 
     Font fonts[FONT_CAP];
     int font_count;
+    u32 sdf_cache_id; // Shared by every sdf font. 0 until one is made
 
-    int* codepoint_indices;
-    int codepoint_count;
+    // Codepoint to glyph index. Latin-1 is a flat array filled at init. The rest of unicode is split into pages that
+    // are filled the first time one of their codepoints is looked up
+    u16 latin1_glyphs[CODEPOINT_PAGE_SIZE];
+    s16 page_indices[CODEPOINT_PAGE_COUNT]; // Into pages. -1 until looked up. Pages without glyphs all use page 0
+    u16* pages; // CODEPOINT_PAGE_SIZE glyph indices each
+    int page_count;
+    int page_cap;
 
     Allocator asset_memory;
 } Font_Collection;
 
 Rect font_string_rect(String str, Font* font, f32 max_width);
 
-b32 init_font_collection(u8* data, int len, Allocator asset_memory, Font_Collection* collection);
+b32 init_font_collection(u8* data, int len, String cache_path, Allocator asset_memory, Font_Collection* collection);
 Font* font_at_size(Font_Collection* collection, int size);
+int glyph_index_from_rune(Font_Collection* collection, Rune r); // 0 if the font doesn't have it
+
+// Distance field fonts draw every size from one set of glyphs with the sdf_font shader. Use them for text that's scaled
+Font* sdf_font_at_size(Font_Collection* collection, int size);
+
+// Glyphs come out of a shared cache and are rasterized into its atlas the first time they're looked up. A glyph
+// looked up this frame stays valid until the next frame
 Font_Glyph* glyph_from_rune(Font* f, Rune r);
+Texture2d glyph_atlas(Font* f); // Bitmap and distance field glyphs are in different atlases
+void evict_font_glyphs(Font* f);
+void get_glyph_cache_stats(int* glyph_count, f32* occupancy, f32* shelf_usage);
 
 void init_draw(Platform* platform);
 void resize_draw(int new_width, int new_height);
 
 void refresh_shader_transform(void);
 void draw_right_handed(Rect viewport);
+void draw_ortho(Vector3 pos, Quaternion rot, f32 aspect_ratio, f32 ortho_size);
 void draw_from(Vector2 pos, f32 ortho_size); // Used for drawing our 2d scene using the back buffer for ortho size
 
+// imm_flush queues a command with the bound shader, texture and transform. flush_render_commands sorts them by
+// (layer, depth, shader, texture) and draws each run with the same state as one draw call. Layers are the
+// order the transform changed in so passes stay in order. Anything drawing straight to GL should flush first
 void imm_begin(void);
 void imm_flush(void);
+void flush_render_commands(void);
+void next_imm_frame(void); // Goes right after the last flush before the swap. Fences what the frame wrote
+
+// Between these, flushes rasterize into the target on the cpu instead of drawing with gl. Anything that draws
+// straight to gl has to check is_raster_capturing and go through imm instead
+void begin_raster_capture(Raster_Target* target);
+void end_raster_capture(void);
+b32 is_raster_capturing(void);
+
 void imm_vertex(Vector3 position, Vector3 normal, Vector2 uv, Vector4 color);
 void set_imm_vertex_format(void);
 
+// Corners go bottom left, bottom right, top right, top left. uv0 is the bottom left uv and uv1 the top right
+void imm_quad(Vector3 p0, Vector3 p1, Vector3 p2, Vector3 p3, Vector2 uv0, Vector2 uv1, Vector4 color);
+void set_imm_quad_vertex_format(void);
+
 void imm_textured_rect(Rect rect, f32 z, Vector2 uv0, Vector2 uv1, Vector4 color);
 inline void imm_rect(Rect rect, f32 z, Vector4 color) { imm_textured_rect(rect, z, v2s(-1.f), v2s(-1.f), color); }
 
@@ -97,6 +135,63 @@ inline void imm_string_2d(String str, Font* font, f32 max_width, Vector2 xy, f32
 void imm_textured_plane(Vector3 pos, Quaternion rot, Rect rect, Vector2 uv0, Vector2 uv1, Vector4 color);
 inline void imm_plane(Vector3 pos, Quaternion rot, Rect rect, Vector4 color) { imm_textured_plane(pos, rot, rect, v2s(-1.f), v2s(-1.f), color); }
 
+// A layer is a cached framebuffer that's drawn back over the screen. It's only drawn into again when its key changes,
+// the window resizes or it's invalidated. A scale under 1 draws it at lower resolution and it's upscaled when composited
+typedef struct Draw_Layer {
+    Framebuffer framebuffer;
+    u64 key; // Whatever the caller hashes from what's drawn into it
+    b32 is_valid;
+} Draw_Layer;
+
+b32 begin_draw_layer(Draw_Layer* layer, u64 key, f32 scale); // True if it has to be drawn. Draw it then end_draw_layer
+void end_draw_layer(Draw_Layer* layer);
+void invalidate_draw_layer(Draw_Layer* layer);
+void composite_draw_layer(Draw_Layer* layer, f32 z);
+
+#define GPU_SCOPE_CAP      32
+#define GPU_SCOPE_NAME_CAP 32
+
+typedef struct GPU_Scope_Time {
+    char name[GPU_SCOPE_NAME_CAP];
+    int depth; // How many scopes it's inside
+    f64 duration;
+} GPU_Scope_Time;
+
+// Times the gl work between begin and end on the gpu. Scopes can nest. next_gpu_frame goes right before the swap and
+// the times come back a few frames later from get_gpu_scope_times. The total is only the outermost scopes. Opening a
+// scope again under the same parent adds to it. Dropped is how many didn't fit, whose time the total is missing
+void begin_gpu_scope(const char* name);
+void end_gpu_scope(void);
+#define gpu_scope(name) defer_loop(begin_gpu_scope(name), end_gpu_scope())
+void next_gpu_frame(void);
+GPU_Scope_Time* get_gpu_scope_times(int* count, f64* total_duration, int* dropped_count);
+
+#define IMM_SNAPSHOT_SHELF_CAP 32
+
+// Keeps a copy of the quads written between begin_imm_snapshot and end_imm_snapshot so they can be drawn again
+// without being built. Quads are copied in as they're written since the ring can't be read back. Only quads are
+// kept so writing triangles in between makes it invalid. It stops being current once a glyph in it is evicted
+typedef struct Imm_Snapshot {
+    void* vertices; // 4 per quad
+    int quad_count;
+    int quad_cap;
+    f32 min_z;
+
+    int shelves[IMM_SNAPSHOT_SHELF_CAP]; // Glyph cache shelves the text in it is on
+    int shelf_count;
+    u32 glyph_generation;
+
+    b32 is_valid;
+} Imm_Snapshot;
+
+void begin_imm_snapshot(Imm_Snapshot* s);
+int imm_snapshot_quad_count(Imm_Snapshot* s); // Written so far
+void end_imm_snapshot(Imm_Snapshot* s);
+b32 is_imm_snapshot_current(Imm_Snapshot* s);
+void imm_snapshot(Imm_Snapshot* s, int first_quad, int quad_count);
+void free_imm_snapshot(Imm_Snapshot* s);
+
+// Commands flushed between these are clipped to a window space rect. A clip change starts a new layer like a transform change
 void begin_clip_rect(Rect rect);
 void end_clip_rect(void);
 
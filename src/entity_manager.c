@@ -62,9 +62,68 @@ void* find_entity_by_id(Entity_Manager* em, Entity_Id id) {
     return 0;
 }
 
+static int chunk_index_from_location(Vector2 location) {
+    // Anything outside the world goes in the closest edge chunk
+    int chunk_x = CLAMP((int)location.x / CHUNK_SIZE, 0, WORLD_SIZE - 1);
+    int chunk_y = CLAMP((int)location.y / CHUNK_SIZE, 0, WORLD_SIZE - 1);
+    return chunk_x + chunk_y * WORLD_SIZE;
+}
+
+static void link_entity_to_chunk(Entity_Manager* em, Entity* entity, int chunk) {
+    entity->chunk = chunk;
+    entity->prev_in_chunk = 0;
+    entity->next_in_chunk = em->chunk_entities[chunk];
+    if (entity->next_in_chunk) entity->next_in_chunk->prev_in_chunk = entity;
+    em->chunk_entities[chunk] = entity;
+}
+
+static void unlink_entity_from_chunk(Entity_Manager* em, Entity* entity) {
+    if (entity->prev_in_chunk) entity->prev_in_chunk->next_in_chunk = entity->next_in_chunk;
+    else em->chunk_entities[entity->chunk] = entity->next_in_chunk;
+    if (entity->next_in_chunk) entity->next_in_chunk->prev_in_chunk = entity->prev_in_chunk;
+    entity->next_in_chunk = 0;
+    entity->prev_in_chunk = 0;
+}
+
+void refresh_entity_chunk(Entity_Manager* em, Entity* entity) {
+    Rect* reach = &em->entity_reach;
+    reach->min = v2(MIN(reach->min.x, entity->bounds.min.x), MIN(reach->min.y, entity->bounds.min.y));
+    reach->max = v2(MAX(reach->max.x, entity->bounds.max.x), MAX(reach->max.y, entity->bounds.max.y));
+
+    int chunk = chunk_index_from_location(entity->location);
+    if (chunk == entity->chunk) return;
+
+    unlink_entity_from_chunk(em, entity);
+    link_entity_to_chunk(em, entity, chunk);
+}
+
+Entity** find_entities_in_rect(Entity_Manager* em, Rect rect, Allocator allocator, int* count) {
+    *count = 0;
+    if (!em->entity_count) return 0;
+
+    Vector2 query_min = v2_sub(rect.min, em->entity_reach.max);
+    Vector2 query_max = v2_sub(rect.max, em->entity_reach.min);
+    int x0 = CLAMP((int)query_min.x / CHUNK_SIZE, 0, WORLD_SIZE - 1);
+    int y0 = CLAMP((int)query_min.y / CHUNK_SIZE, 0, WORLD_SIZE - 1);
+    int x1 = CLAMP((int)query_max.x / CHUNK_SIZE, 0, WORLD_SIZE - 1);
+    int y1 = CLAMP((int)query_max.y / CHUNK_SIZE, 0, WORLD_SIZE - 1);
+
+    // Sized for the worst case since counting the reachable buckets first would walk them twice
+    Entity** result = mem_alloc_array(allocator, Entity*, em->entity_count);
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            for (Entity* entity = em->chunk_entities[x + y * WORLD_SIZE]; entity; entity = entity->next_in_chunk) {
+                if (rect_overlaps_rect(rect, move_rect(entity->bounds, entity->location), 0)) result[(*count)++] = entity;
+            }
+        }
+    }
+
+    return result;
+}
+
 Cell* find_cell_at(Entity_Manager* em, int x, int y) {
-    if (x > CHUNK_SIZE * WORLD_SIZE || x < 0) return 0;
-    if (y > CHUNK_SIZE * WORLD_SIZE || y < 0) return 0;
+    if (x >= CHUNK_SIZE * WORLD_SIZE || x < 0) return 0;
+    if (y >= CHUNK_SIZE * WORLD_SIZE || y < 0) return 0;
 
     int chunk_x = x / CHUNK_SIZE;
     int chunk_y = y / CHUNK_SIZE;
@@ -73,10 +132,19 @@ Cell* find_cell_at(Entity_Manager* em, int x, int y) {
 
     int local_x = x - chunk_x * CHUNK_SIZE;
     int local_y = y - chunk_y * CHUNK_SIZE;
-    assert(local_x <= CHUNK_SIZE && local_y <= CHUNK_SIZE);
+    assert(local_x < CHUNK_SIZE && local_y < CHUNK_SIZE);
     return &chunk->cells[local_x + local_y * CHUNK_SIZE];
 }
 
+void mark_cell_dirty(Entity_Manager* em, int x, int y, int flags) {
+    if (x >= CHUNK_SIZE * WORLD_SIZE || x < 0) return;
+    if (y >= CHUNK_SIZE * WORLD_SIZE || y < 0) return;
+
+    int chunk_x = x / CHUNK_SIZE;
+    int chunk_y = y / CHUNK_SIZE;
+    em->chunks[chunk_x + chunk_y * WORLD_SIZE].dirty_flags |= flags;
+}
+
 static u64 hash_generic(void* a, void* b, int size) {
     if (b) {
         for (int i = 0; i < size; ++i) {
@@ -85,12 +153,13 @@ static u64 hash_generic(void* a, void* b, int size) {
         return true;
     }
 
-    return fnv1_hash(a, size);
+    return hash_bytes(a, size);
 }
 
 Entity_Manager* make_entity_manager(Allocator allocator) {
     Entity_Manager* result = mem_alloc_struct(allocator, Entity_Manager);
     result->entity_memory = pool_allocator(allocator, ENTITY_CAP + ENTITY_CAP / 2, 256);
+    track_allocator(&result->entity_memory, allocator, "Entity Memory", true);
     return result;
 }
 
@@ -114,6 +183,9 @@ void* _make_entity(Entity_Manager* em, int size, Entity_Type type) {
         }
     }
 
+    // Starts at the origin's chunk until whoever made it sets a location and refreshes it
+    link_entity_to_chunk(em, result, chunk_index_from_location(result->location));
+
     return result;
 }
 
@@ -122,6 +194,8 @@ static void refresh_wall_visual(Entity_Manager* em, int x, int y, b32 first) {
     if (!cell) return;
     if (cell->content != CC_Wall && !first) return;
 
+    mark_cell_dirty(em, x, y, CDF_Walls);
+
     b32 has_north = false;
     Cell* north = find_cell_at(em, x, y + 1);
     if (north && north->content == CC_Wall) {
@@ -197,7 +271,7 @@ static u64 hash_path_cell(void* a, void* b, int size) {
         return cell_ref_equals(a_cell->parent, b_cell->parent);
     }
 
-    return fnv1_hash(a, size);
+    return hash_bytes(a, size);
 }
 
 static u64 hash_cell_ref(void* a, void* b, int size) {
@@ -211,7 +285,7 @@ static u64 hash_cell_ref(void* a, void* b, int size) {
         return cell_ref_equals(*a_t, *b_t);
     }
 
-    return fnv1_hash(a, size);
+    return hash_bytes(a, size);
 }
 
 static f32 pathfind_heuristic(Cell_Ref a, Cell_Ref b) {
@@ -235,6 +309,9 @@ static b32 is_cell_traversable(Cell* cell) {
 }
 
 static Path_Cell* find_path_cell(Path_Map* map, Cell_Ref ref) { 
+    if (ref.x < 0 || ref.x >= CHUNK_SIZE * WORLD_SIZE) return 0;
+    if (ref.y < 0 || ref.y >= CHUNK_SIZE * WORLD_SIZE) return 0;
+
     Path_Cell* cell = &map->cells[ref.x + ref.y * CHUNK_SIZE * WORLD_SIZE];
     if (!cell->is_initialized) return 0;
     
@@ -281,9 +358,11 @@ b32 pathfind(Entity_Manager* em, Cell_Ref source, Cell_Ref dest, Path* path) {
     Cell* dest_cell = find_cell_by_ref(em, dest);
     if (!dest_cell || !is_cell_traversable(dest_cell)) return false;
 
+    // On the heap so a path can be let go of with free_path. The permanent arena never gave this back
     int cell_count = CHUNK_SIZE * CHUNK_SIZE * WORLD_SIZE * WORLD_SIZE;
-    Path_Map path_map = { .cells = mem_alloc_array(g_platform->permanent_arena, Path_Cell, cell_count), };
-    // mem_set(path_map.cells, 0, sizeof(Path_Cell) * cell_count); This is super expensive
+    path->path_map = (Path_Map) { .cells = mem_alloc_array(heap_allocator(), Path_Cell, cell_count), };
+    mem_set(path->path_map.cells, 0, sizeof(Path_Cell) * cell_count);
+    Path_Map path_map = path->path_map;
 
     set_path_cell(&path_map, source, false);
 
@@ -326,7 +405,7 @@ b32 pathfind(Entity_Manager* em, Cell_Ref source, Cell_Ref dest, Path* path) {
                 final_cell = *find_path_cell(&path_map, final_ref);
             }
 
-            path->points = mem_alloc_array(g_platform->permanent_arena, Cell_Ref, point_count);
+            path->points = mem_alloc_array(heap_allocator(), Cell_Ref, point_count);
             path->point_count = point_count;
 
             final_ref = current_ref;
@@ -369,7 +448,7 @@ b32 pathfind(Entity_Manager* em, Cell_Ref source, Cell_Ref dest, Path* path) {
                 Path_Cell* a_cell = find_path_cell(&path_map, a_ref);
                 Path_Cell* b_cell = find_path_cell(&path_map, b_ref);
 
-                is_passable = a_cell->is_passable && b_cell->is_passable;
+                is_passable = a_cell && b_cell && a_cell->is_passable && b_cell->is_passable;
             }
 
             // If we're not passable or we're on the closed list try another neighbor
@@ -394,23 +473,25 @@ b32 pathfind(Entity_Manager* em, Cell_Ref source, Cell_Ref dest, Path* path) {
     return false;
 }
 
-#if 0
+void free_path(Path* path) {
+    if (path->points) mem_free(heap_allocator(), path->points);
+    if (path->path_map.cells) mem_free(heap_allocator(), path->path_map.cells);
+    *path = (Path) { 0 };
+}
 
 void draw_pathfind_debug(Entity_Manager* em, Path path) {
     if (!path.path_map.cells) return;
 
     Controller* controller = find_entity_by_id(em, em->controller_id);
+    if (!controller) return;
 
     Vector2 mouse_pos_in_world = get_mouse_pos_in_world_space(controller);
     Cell_Ref mouse_cell = cell_ref_from_location(mouse_pos_in_world);
+    b32 draws_text = controller->current_ortho_size <= 15.f;
 
-    set_shader(find_shader(from_cstr("assets/shaders/font")));
+    set_shader(get_shader(AH_Basic2d_Shader));
     draw_from(controller->location, controller->current_ortho_size);
 
-    Font_Collection* fc = find_font_collection(from_cstr("assets/fonts/Menlo-Regular"));
-    Font* font = font_at_size(fc, 48);
-    set_uniform_texture("atlas", font->atlas);
-
     imm_begin();
     for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE * WORLD_SIZE * WORLD_SIZE; ++i) {
         Path_Cell cell = path.path_map.cells[i];
@@ -421,22 +502,50 @@ void draw_pathfind_debug(Entity_Manager* em, Path path) {
         Vector2 draw_min = v2((f32)ref.x, (f32)ref.y);
         Rect draw_rect = { draw_min, v2_add(draw_min, v2s(1.f)) };
 
+#if DEBUG_BUILD
         f32 r = (cell.times_touched) / 20.f;
+#else
+        f32 r = 0.f;
+#endif
         f32 g = cell.g / cell.f;
         f32 b = cell.h / cell.f;
 
         imm_rect(draw_rect, -4.f, v4(r, g, b, 0.5f));
+    }
+    for (int i = 0; i < path.point_count; ++i) {
+        Vector2 draw_min = v2((f32)path.points[i].x, (f32)path.points[i].y);
+        imm_rect((Rect) { v2_add(draw_min, v2s(0.25f)), v2_add(draw_min, v2s(0.75f)) }, -4.f, v4(1.f, 1.f, 1.f, 0.8f));
+    }
+    imm_flush();
 
-        f32 dist_between_cells = distance_between_cells(mouse_cell, ref);
-        if (dist_between_cells < 5.f && controller->current_ortho_size <= 15.f) {
-            char buffer[64];
-            sprintf(buffer, "F: %.2f\nG: %.2f\nH: %.2f\nTT: %i", cell.f, cell.g, cell.h, cell.times_touched);
+    if (!draws_text) return;
 
-            imm_string(from_cstr(buffer), font, 0.2f, 1000.f, v2(draw_min.x, draw_min.y + 1.f - 0.2f), -4.f, v4s(1.f));
+    // Drawn at world scale so a distance field font stays sharp at any zoom
+    Font_Collection* fc = get_font_collection(AH_Menlo_Font);
+    if (!fc) return;
+    Font* font = sdf_font_at_size(fc, 48);
+    set_shader(get_shader(AH_Sdf_Font_Shader));
+    draw_from(controller->location, controller->current_ortho_size);
+    set_uniform_texture(SU_Distance_Atlas, glyph_atlas(font));
 
-        }
+    imm_begin();
+    for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE * WORLD_SIZE * WORLD_SIZE; ++i) {
+        Path_Cell cell = path.path_map.cells[i];
+        if (!cell.is_initialized) continue;
+
+        Cell_Ref ref = cell_ref_from_index(i);
+        if (distance_between_cells(mouse_cell, ref) >= 5.f) continue;
+
+#if DEBUG_BUILD
+        int times_touched = cell.times_touched;
+#else
+        int times_touched = 0;
+#endif
+        char buffer[64];
+        sprintf(buffer, "F: %.2f\nG: %.2f\nH: %.2f\nTT: %i", cell.f, cell.g, cell.h, times_touched);
+
+        Vector2 draw_min = v2((f32)ref.x, (f32)ref.y);
+        imm_string(from_cstr(buffer), font, 0.2f, 1000.f, v2(draw_min.x, draw_min.y + 1.f - 0.2f), -4.f, v4s(1.f));
     }
     imm_flush();
 }
-
-#endif
@@ -59,8 +59,16 @@ inline Rect rect_from_cell(Cell_Ref a) { return (Rect) { v2((f32)a.x, (f32)a.y),
 
 #define CHUNK_SIZE 16
 #define CELLS_PER_CHUNK (CHUNK_SIZE * CHUNK_SIZE)
+
+// Which cached chunk meshes need to be rebuilt. See cell_map.c
+typedef enum Chunk_Dirty_Flags {
+    CDF_Floor = (1 << 0),
+    CDF_Walls = (1 << 1),
+} Chunk_Dirty_Flags;
+
 typedef struct Chunk {
     Cell cells[CELLS_PER_CHUNK];
+    int dirty_flags;
 } Chunk;
 
 typedef u32 Entity_Id; // Invalid Entity_Id is 0
@@ -77,6 +85,9 @@ entry(Entity_Type, type) \
 entry(Vector2, location) \
 entry(f32, rotation) \
 entry(Rect, bounds) \
+entry(int, chunk) \
+entry(struct Entity*, next_in_chunk) \
+entry(struct Entity*, prev_in_chunk) \
 entry(void*, derived)
 
 #define DEFINE_ENTITY_STRUCT(t, n) t n;
@@ -105,6 +116,11 @@ typedef struct Entity_Manager {
 
     Entity_Id controller_id;
 
+    // Every entity is linked into the bucket of the chunk its location is in. The reach is how far past its location
+    // any entity's bounds have gone, so queries grow by it to find big entities in neighbouring chunks
+    Entity* chunk_entities[CHUNK_CAP];
+    Rect entity_reach;
+
     Allocator entity_memory;
 } Entity_Manager;
 
@@ -132,17 +148,25 @@ Cell_Ref ref_from_rect_iterator(Cell_Rect_Iterator iter);
 #define cell_rect_iterator(p0, p1) Cell_Rect_Iterator iter = { p0, p1, 0 }; can_step_cell_rect_iterator(iter); ++iter.index
 
 void* find_entity_by_id(Entity_Manager* em, Entity_Id id);
+
+// Entities whose bounds moved to their location overlap the rect. Only the chunk buckets the rect can reach are looked at
+Entity** find_entities_in_rect(Entity_Manager* em, Rect rect, Allocator allocator, int* count);
+
+// Call after changing an entity's location or bounds so find_entities_in_rect looks for it in the right chunk
+void refresh_entity_chunk(Entity_Manager* em, Entity* entity);
 Cell* find_cell_at(Entity_Manager* em, int x, int y);
 Cell* find_cell_by_ref(Entity_Manager* em, Cell_Ref ref) { return find_cell_at(em, ref.x, ref.y); }
+void mark_cell_dirty(Entity_Manager* em, int x, int y, int flags);
 Entity_Manager* make_entity_manager(Allocator allocator);
 
 void* _make_entity(Entity_Manager* em, int size, Entity_Type type);
 #define make_entity(em, type) _make_entity(em, sizeof(type), ET_ ## type)
 
+// The lod color is what the entity's bounds are filled with when zoomed out. 0 isn't drawn
 #define ENTITY_FUNCTIONS(entry) \
-entry(ET_Controller, tick_controller, draw_null) \
-entry(ET_Pawn, tick_pawn, draw_pawn) \
-entry(ET_Furniture, tick_furniture, draw_furniture) \
+entry(ET_Controller, tick_controller, draw_null, 0) \
+entry(ET_Pawn, tick_pawn, draw_pawn, 0xFF0033FF) \
+entry(ET_Furniture, tick_furniture, draw_furniture, 0x00B33380) \
 
 void tick_null(Entity_Manager* em, Entity* entity, f32 dt) { }
 void draw_null(Entity_Manager* em, Entity* entity) { }
@@ -166,17 +190,16 @@ typedef struct Path_Map {
 typedef struct Path {
     Cell_Ref* points;
     int point_count;
+
+    Path_Map path_map; // Every cell the search looked at, found or not. Kept for draw_pathfind_debug
 } Path;
 
 /**
  * A* Pathfinding
  */
 b32 pathfind(Entity_Manager* em, Cell_Ref source, Cell_Ref dest, Path* path);
-
-#if 0
+void free_path(Path* path);
 
 void draw_pathfind_debug(Entity_Manager* em, Path path);
 
-#endif
-
 #endif /* ENTITY_MANAGER_H */
\ No newline at end of file
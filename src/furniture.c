@@ -4,7 +4,9 @@ Furniture* make_furniture(Entity_Manager* em, Furniture_Defintion* definition, C
     Furniture* result = make_entity(em, Furniture);
     result->definition = definition;
     result->location = v2((f32)location.x, (f32)location.y);
+    result->bounds   = (Rect) { v2z(), v2((f32)definition->size_x, (f32)definition->size_y) };
     result->direction = direction;
+    refresh_entity_chunk(em, &result->base);
     return result;
 }
 
@@ -21,6 +23,7 @@ void draw_furniture(Entity_Manager* em, Entity* entity) {
     Cell_Ref p0 = tile_at;
     Cell_Ref p1 = { tile_at.x + definition->size_x - 1, tile_at.y + definition->size_y - 1 };
 
+    set_shader(get_shader(AH_Basic2d_Shader));
     imm_begin();
     for (cell_rect_iterator(p0, p1)) {
         Cell_Ref at = ref_from_rect_iterator(iter);
@@ -10,7 +10,7 @@ static u64 hash_gui_id(void* a, void* b, int size) {
         return a_id->whole == b_id->whole;
     }
 
-    return fnv1_hash(a, size);
+    return hash_bytes(a, size);
 }
 
 typedef enum GUI_Widget_Type {
@@ -60,6 +60,15 @@ typedef struct GUI_Widget_State {
     };
 } GUI_Widget_State;
 
+// A run of widgets under the same clip in the snapshot
+typedef struct GUI_Batch {
+    b32 has_clip;
+    Rect clip;
+
+    int first_quad;
+    int quad_count;
+} GUI_Batch;
+
 #define STYLE_VARIABLES(macro) \
 macro(Font_Collection*, font) \
 macro(int, font_size) \
@@ -90,6 +99,20 @@ typedef struct GUI_State {
 
     f32 scale;
 
+    // What the widgets drew last time they changed. A frame that hashes the same draws this again instead
+    u64 last_hash;
+    Imm_Snapshot snapshot;
+    int batch_count;
+    GUI_Batch batches[GUI_WIDGET_CAP];
+    b32 was_reused;
+
+    // A frame whose inputs hash the same as the last build skips building. Hover only matters over these
+    u64 last_inputs_hash;
+    b32 skipped_build;
+    int hot_rect_count;
+    Rect hot_rects[GUI_WIDGET_CAP];
+    int built_frames; // Counted up for whoever wants to show it
+
     int current_frame;
     f64 start_time;
     f64 last_duration;
@@ -99,14 +122,23 @@ typedef struct GUI_State {
 
 static GUI_State* gui_state;
 
-#define push_widget(widget) assert(gui_state->widget_count < GUI_WIDGET_CAP); gui_state->widgets[gui_state->widget_count++] = widget
+#define push_widget(widget) assert(gui_state->widget_count < GUI_WIDGET_CAP); gui_state->widgets[gui_state->widget_count++] = clip_widget(widget)
 #define push_layout(layout) assert(gui_state->layout_count < GUI_WIDGET_CAP); gui_state->layouts[gui_state->layout_count++] = layout
 
 #define push_style(name, value) assert(gui_state->name ## _count < GUI_WIDGET_CAP); gui_state->name[gui_state->name ## _count++] = value;
 #define pop_style(name, value) assert(gui_state->name ## _count > 0); gui_state->name ## _count -= 1;
 #define get_style(name) gui_state->name[gui_state->name ## _count - 1]
 
-static Font* get_font(void) { return font_at_size(get_style(font), (int)((f32)get_style(font_size) * gui_state->scale)); }
+// Distance field so every dpi scale shares the same glyphs
+static Font* get_font(void) { return sdf_font_at_size(get_style(font), (int)((f32)get_style(font_size) * gui_state->scale)); }
+
+static GUI_Widget clip_widget(GUI_Widget widget) {
+    if (gui_state->clip_count) {
+        widget.flags |= GWF_Has_Clip;
+        widget.clip   = gui_state->clips[gui_state->clip_count - 1];
+    }
+    return widget;
+}
 
 static void set_focus(GUI_Id id) {
     gui_state->focused = id;
@@ -257,6 +289,7 @@ void gui_label_printf(const char* fmt, ...) {
 b32 gui_checkbox_rect(GUI_Id id, Rect rect, b32* value) {
     Vector2 mouse_pos = v2((f32)g_platform->input.state.mouse_x, (f32)g_platform->input.state.mouse_y);
     b32 mouse_over = rect_overlaps_point(rect, mouse_pos);
+    if (gui_state->clip_count) mouse_over = mouse_over && rect_overlaps_point(gui_state->clips[gui_state->clip_count - 1], mouse_pos);
 
     b32 triggered = false;
     if (mouse_over) gui_state->hovered = id;
@@ -298,6 +331,25 @@ void gui_panel_rect(Rect rect) {
     push_widget(the_widget);
 }
 
+void gui_push_clip_rect(Rect rect) {
+    assert(gui_state->clip_count < GUI_WIDGET_CAP);
+
+    // Nested clips only ever shrink
+    if (gui_state->clip_count) {
+        Rect parent = gui_state->clips[gui_state->clip_count - 1];
+        rect.min = v2(MAX(rect.min.x, parent.min.x), MAX(rect.min.y, parent.min.y));
+        rect.max = v2(MIN(rect.max.x, parent.max.x), MIN(rect.max.y, parent.max.y));
+    }
+    gui_state->clips[gui_state->clip_count++] = rect;
+}
+
+b32 gui_pop_clip(void) {
+    if (!gui_state->clip_count) return 0;
+
+    gui_state->clip_count -= 1;
+    return 1;
+}
+
 b32 is_hovering_widget(void) { return gui_state->hovered.whole != 0; }
 
 void init_gui(Platform* platform) {
@@ -307,13 +359,13 @@ void init_gui(Platform* platform) {
     gui_state->is_initialized = true;
     gui_state->scale = platform->dpi_scale;
 
-    Font_Collection* fc = find_font_collection(from_cstr("assets/fonts/Menlo-Regular"));
+    Font_Collection* fc = get_font_collection(AH_Menlo_Font);
     push_style(font, fc)
     push_style(font_size, 14);
     push_style(foreground_color, rgba_from_hex(0xFBF1C7FF));
     push_style(background_color, rgba_from_hex(0x282828FF));
 
-    gui_state->widget_state = make_hash_table(GUI_Id, GUI_Widget_State, hash_gui_id, platform->permanent_arena);
+    gui_state->widget_state = make_pod_hash_table(GUI_Id, GUI_Widget_State, platform->permanent_arena);
     reserve_hash_table(&gui_state->widget_state, GUI_WIDGET_CAP);
 }
 
@@ -324,12 +376,114 @@ void begin_gui(void) {
 
     gui_state->current_frame += 1;
     gui_state->focus_was_set = false;
+    gui_state->skipped_build = false;
 
     gui_state->start_time = g_platform->time_in_seconds();
 }
 
+static void draw_widget(GUI_Widget widget, f32 z) {
+    switch (widget.type) {
+    case GWT_Label: {
+        // @TODO(colby): Alignment
+        f32 max_width = widget.bounds.max.x - widget.bounds.min.x;
+        Vector2 xy = v2(widget.bounds.min.x, widget.bounds.max.y - (f32)widget.font->size);
+        imm_string_2d(widget.label, widget.font, max_width, xy, z, widget.color);
+    } break;
+    case GWT_Checkbox: {
+        Vector4 background_color = v4(1.f, 1.f, 1.f, 0.5f);
+        if (gui_state->hovered.whole == widget.id.whole) background_color.a = 0.7f;
+        if (gui_state->focused.whole == widget.id.whole) background_color.a = 1.f;
+        imm_rect(widget.bounds, z, background_color);
+
+        if (widget.is_checked) {
+            Vector4 foreground_color = background_color;
+            foreground_color.xyz = v3s(0.f);
+            foreground_color.a += 0.2f;
+            imm_rect((Rect) { v2_add(widget.bounds.min, v2s(10.f)), v2_sub(widget.bounds.max, v2s(10.f)) }, z, foreground_color);
+        }
+    } break;
+    case GWT_Panel:
+        imm_rect(widget.bounds, z, widget.color);
+        break;
+    default: invalid_code_path;
+    };
+}
+
+// Everything that changes what a widget draws. Labels are hashed by their text since they're copied every frame
+static u64 hash_gui_frame(Rect viewport) {
+    Hash_State state = begin_hash();
+    hash_state_bytes(&state, &viewport, sizeof(viewport));
+
+    for (int i = 0; i < gui_state->widget_count; ++i) {
+        GUI_Widget* widget = &gui_state->widgets[i];
+        hash_state_bytes(&state, &widget->id, sizeof(widget->id));
+        hash_state_bytes(&state, &widget->type, sizeof(widget->type));
+        hash_state_bytes(&state, &widget->flags, sizeof(widget->flags));
+        hash_state_bytes(&state, &widget->bounds, sizeof(widget->bounds));
+        if (widget->flags & GWF_Has_Clip) hash_state_bytes(&state, &widget->clip, sizeof(widget->clip));
+        hash_state_bytes(&state, &widget->color, sizeof(widget->color));
+
+        switch (widget->type) {
+        case GWT_Label:
+            hash_state_bytes(&state, &widget->font, sizeof(widget->font));
+            hash_state_bytes(&state, &widget->alignment, sizeof(widget->alignment));
+            hash_state_bytes(&state, &widget->label.len, sizeof(widget->label.len));
+            hash_state_bytes(&state, widget->label.data, (usize)widget->label.len);
+            break;
+        case GWT_Checkbox: {
+            b32 checkbox_state[3] = { 
+                widget->is_checked, 
+                gui_state->hovered.whole == widget->id.whole, 
+                gui_state->focused.whole == widget->id.whole,
+            };
+            hash_state_bytes(&state, checkbox_state, sizeof(checkbox_state));
+        } break;
+        default: break;
+        };
+    }
+
+    return end_hash(&state);
+}
+
+b32 gui_needs_build(u64 inputs_hash) {
+    Rect viewport = viewport_rect();
+    Input* input = &g_platform->input;
+    Vector2 mouse_pos = v2((f32)input->state.mouse_x, (f32)input->state.mouse_y);
+
+    // The mouse only changes anything while it's over a checkbox, one is hovered or focused, or a button goes up or down
+    b32 mouse_matters = gui_state->hovered.whole || gui_state->focused.whole;
+    mouse_matters = mouse_matters || mem_cmp(input->state.mouse_buttons_down, input->prev_state.mouse_buttons_down, sizeof(input->state.mouse_buttons_down)) != 0;
+    for (int i = 0; i < gui_state->hot_rect_count && !mouse_matters; ++i) {
+        mouse_matters = rect_overlaps_point(gui_state->hot_rects[i], mouse_pos);
+    }
+
+    Hash_State state = begin_hash();
+    hash_state_bytes(&state, &inputs_hash, sizeof(inputs_hash));
+    hash_state_bytes(&state, &viewport, sizeof(viewport));
+    hash_state_bytes(&state, &gui_state->scale, sizeof(gui_state->scale));
+    if (mouse_matters) {
+        hash_state_bytes(&state, &mouse_pos, sizeof(mouse_pos));
+        hash_state_bytes(&state, input->state.mouse_buttons_down, sizeof(input->state.mouse_buttons_down));
+        hash_state_bytes(&state, input->prev_state.mouse_buttons_down, sizeof(input->prev_state.mouse_buttons_down));
+    }
+    u64 hash = end_hash(&state);
+
+    if (hash == gui_state->last_inputs_hash && is_imm_snapshot_current(&gui_state->snapshot)) {
+        gui_state->skipped_build = true;
+        return false;
+    }
+    gui_state->last_inputs_hash = hash;
+    return true;
+}
+
+static b32 same_widget_clip(GUI_Widget* a, GUI_Widget* b) {
+    if ((a->flags & GWF_Has_Clip) != (b->flags & GWF_Has_Clip)) return false;
+    if (!(a->flags & GWF_Has_Clip)) return true;
+    return mem_cmp(&a->clip, &b->clip, sizeof(Rect)) == 0;
+}
+
 void end_gui(f32 dt) {
-    set_shader(find_shader(from_cstr("assets/shaders/font")));
+    set_shader(get_shader(AH_Sdf_Font_Shader));
     
     Rect viewport = { v2z(), v2((f32)g_platform->window_width, (f32)g_platform->window_height) };
 
@@ -337,43 +491,67 @@ void end_gui(f32 dt) {
 
     f32 gui_z = -1.f;
 
-    for (int i = 0; i < gui_state->widget_count; ++i) {
-        GUI_Widget widget = gui_state->widgets[i];
-
-        switch (widget.type) {
-        case GWT_Label: 
-            imm_begin();    
-            set_uniform_texture("atlas", widget.font->atlas);
-            // @TODO(colby): Alignment
-            f32 max_width = widget.bounds.max.x - widget.bounds.min.x;
-            Vector2 xy = v2(widget.bounds.min.x, widget.bounds.max.y - (f32)widget.font->size);
-            imm_string_2d(widget.label, widget.font, max_width, xy, gui_z, widget.color);
-            imm_flush();
-            break;
-        case GWT_Checkbox:
+    // Every widget goes through the sdf font shader. Rects are untextured quads and all distance field fonts share one
+    // atlas, so everything under the same clip is one command. Each distinct clip is a sub batch with its own scissor
+    // in the order it first showed up
+    set_uniform_texture(SU_Distance_Atlas, glyph_atlas(get_font()));
+
+    u64 frame_hash = gui_state->skipped_build ? gui_state->last_hash : hash_gui_frame(viewport);
+    gui_state->was_reused = gui_state->skipped_build || (frame_hash == gui_state->last_hash && is_imm_snapshot_current(&gui_state->snapshot));
+
+    if (gui_state->was_reused) {
+        for (int i = 0; i < gui_state->batch_count; ++i) {
+            GUI_Batch* batch = &gui_state->batches[i];
+            if (batch->has_clip) begin_clip_rect(batch->clip);
+            else end_clip_rect();
+
             imm_begin();
-            
-            Vector4 background_color = v4(1.f, 1.f, 1.f, 0.5f);
-            if (gui_state->hovered.whole == widget.id.whole) background_color.a = 0.7f;
-            if (gui_state->focused.whole == widget.id.whole) background_color.a = 1.f;
-            imm_rect(widget.bounds, gui_z, background_color);
-
-            if (widget.is_checked) {
-                Vector4 foreground_color = background_color;
-                foreground_color.xyz = v3s(0.f);
-                foreground_color.a += 0.2f;
-                imm_rect((Rect) { v2_add(widget.bounds.min, v2s(10.f)), v2_sub(widget.bounds.max, v2s(10.f)) }, gui_z, foreground_color);
-            
-            }
+            imm_snapshot(&gui_state->snapshot, batch->first_quad, batch->quad_count);
             imm_flush();
-            break;
-        case GWT_Panel:
+        }
+    } else {
+        b32* drawn = mem_alloc_array(g_platform->frame_arena, b32, gui_state->widget_count);
+        mem_set(drawn, 0, sizeof(b32) * gui_state->widget_count);
+
+        gui_state->batch_count = 0;
+        begin_imm_snapshot(&gui_state->snapshot);
+        for (int i = 0; i < gui_state->widget_count; ++i) {
+            if (drawn[i]) continue;
+
+            GUI_Widget* first = &gui_state->widgets[i];
+            GUI_Batch* batch = &gui_state->batches[gui_state->batch_count++];
+            batch->has_clip   = (first->flags & GWF_Has_Clip) != 0;
+            batch->clip       = first->clip;
+            batch->first_quad = imm_snapshot_quad_count(&gui_state->snapshot);
+
+            if (batch->has_clip) begin_clip_rect(batch->clip);
+            else end_clip_rect();
+
             imm_begin();
-            imm_rect(widget.bounds, gui_z, widget.color);
+            for (int j = i; j < gui_state->widget_count; ++j) {
+                GUI_Widget* widget = &gui_state->widgets[j];
+                if (drawn[j] || !same_widget_clip(first, widget)) continue;
+
+                draw_widget(*widget, gui_z);
+                drawn[j] = true;
+            }
             imm_flush();
-            break;
-        default: invalid_code_path;
-        };
+
+            batch->quad_count = imm_snapshot_quad_count(&gui_state->snapshot) - batch->first_quad;
+        }
+        end_imm_snapshot(&gui_state->snapshot);
+
+        gui_state->last_hash = gui_state->snapshot.is_valid ? frame_hash : 0;
+    }
+    end_clip_rect();
+
+    if (!gui_state->skipped_build) {
+        gui_state->built_frames += 1;
+        gui_state->hot_rect_count = 0;
+        for (int i = 0; i < gui_state->widget_count; ++i) {
+            GUI_Widget* widget = &gui_state->widgets[i];
+            if (widget->type == GWT_Checkbox) gui_state->hot_rects[gui_state->hot_rect_count++] = widget->bounds;
+        }
     }
 
     gui_state->widget_count = 0;
@@ -45,12 +45,22 @@ b32 gui_checkbox(GUI_Id id, b32* value);
 
 void gui_panel_rect(Rect rect);
 
+// Widgets pushed inside a clip are cut off at the intersection of every clip around them
+void gui_push_clip_rect(Rect rect);
+b32 gui_pop_clip(void);
+#define gui_clip_rect(rect) defer_loop(gui_push_clip_rect(rect), gui_pop_clip())
+
 void init_gui(Platform* platform);
 
 void begin_gui(void);
 void end_gui(f32 dt);
 #define do_gui(dt) defer_loop(begin_gui(), end_gui(dt))
 
+// Only builds the widgets when the caller's hash of what they show, the viewport or the mouse over something it can
+// change is different from the last build. Otherwise nothing is pushed and end_gui draws the last build's quads again
+b32 gui_needs_build(u64 inputs_hash);
+#define do_cached_gui(dt, inputs_hash) do_gui(dt) if (gui_needs_build(inputs_hash))
+
 b32 is_hovering_widget(void);
 
 #endif /* GUI_H */
\ No newline at end of file
@@ -165,40 +165,70 @@ inline void _assert_implementation(b32 cond, b32 do_segfault, u32 line, char* fi
 
 #define array_count(x) (sizeof(x) / sizeof(x[0]))
 
+#if COMPILER_MSVC
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit. -1 if none are set
+inline int first_set_bit(u32 x) {
+#if COMPILER_MSVC
+    unsigned long index;
+    return _BitScanForward(&index, x) ? (int)index : -1;
+#else
+    return x ? __builtin_ctz(x) : -1;
+#endif
+}
+
+// Index of the highest set bit. -1 if none are set
+inline int last_set_bit(u64 x) {
+#if COMPILER_MSVC
+    unsigned long index;
+    return _BitScanReverse64(&index, x) ? (int)index : -1;
+#else
+    return x ? 63 - __builtin_clzll(x) : -1;
+#endif
+}
+
 // @NOTE(colby): Maybe one day we wont use the cruntime
 #define mem_copy    memcpy
 #define mem_move    memmove
 #define mem_set     memset
+#define mem_cmp     memcmp
 #define str_len     (int)strlen
 #define str_cmp     strcmp
 
+#ifndef ALLOCATION_TRACKING
+#define ALLOCATION_TRACKING DEBUG_BUILD
+#endif
+
+struct Allocation_Tracker;
+
 typedef struct Allocator {
     void* data;
     void* (*proc)(struct Allocator allocator, void* ptr, usize size, usize alignment);
+    struct Allocation_Tracker* tracker; // Only used when ALLOCATION_TRACKING is on. See track_allocator
 } Allocator;
 
-inline void* mem_alloc_aligned(Allocator allocator, usize size, usize alignment) {
-    return allocator.proc(allocator, 0, size, alignment);
-}
+void* _mem_call_tracked(Allocator allocator, void* ptr, usize size, usize alignment, const char* file, int line);
 
-inline void* mem_alloc(Allocator allocator, usize size) { 
-    return mem_alloc_aligned(allocator, size, 4);
+inline void* _mem_call(Allocator allocator, void* ptr, usize size, usize alignment, const char* file, int line) {
+#if ALLOCATION_TRACKING
+    if (allocator.tracker) return _mem_call_tracked(allocator, ptr, size, alignment, file, line);
+#endif
+    return allocator.proc(allocator, ptr, size, alignment);
 }
 
-#define mem_alloc_struct(allocator, type) mem_alloc(allocator, sizeof(type))
-#define mem_alloc_array(allocator, type, count) mem_alloc(allocator, sizeof(type) * count)
+// These are macros so the tracker can attribute every allocation to its call site
+#define mem_alloc_aligned(allocator, size, alignment) _mem_call(allocator, 0, size, alignment, __FILE__, __LINE__)
+#define mem_alloc(allocator, size) mem_alloc_aligned(allocator, size, 4)
 
-inline void* mem_realloc_aligned(Allocator allocator, void* ptr, usize size, usize alignment) {
-    return allocator.proc(allocator, ptr, size, alignment);
-}
+#define mem_alloc_struct(allocator, type) mem_alloc(allocator, sizeof(type))
+#define mem_alloc_array(allocator, type, count) mem_alloc(allocator, sizeof(type) * (count))
 
-inline void* mem_realloc(Allocator allocator, void* ptr, usize size) {
-    return allocator.proc(allocator, ptr, size, 4);
-}
+#define mem_realloc_aligned(allocator, ptr, size, alignment) _mem_call(allocator, ptr, size, alignment, __FILE__, __LINE__)
+#define mem_realloc(allocator, ptr, size) mem_realloc_aligned(allocator, ptr, size, 4)
 
-inline void mem_free(Allocator allocator, void* ptr) {
-    allocator.proc(allocator, ptr, 0, 0);
-}
+#define mem_free(allocator, ptr) _mem_call(allocator, ptr, 0, 0, __FILE__, __LINE__)
 
 Allocator heap_allocator(void);
 Allocator null_allocator(void); // Used for like stack allocated things
@@ -211,9 +241,15 @@ typedef struct Memory_Arena {
 
 Allocator arena_allocator_raw(void* base, usize size);
 Allocator arena_allocator(Allocator allocator, usize size);
+
+void note_allocator_reset(struct Allocation_Tracker* tracker);
 inline void reset_arena(Allocator allocator) {
     Memory_Arena* arena = allocator.data;
     arena->used = 0;
+
+#if ALLOCATION_TRACKING
+    if (allocator.tracker) note_allocator_reset(allocator.tracker);
+#endif
 }
 
 typedef struct Temp_Memory {
@@ -246,6 +282,73 @@ typedef struct Pool_Allocator {
 
 Allocator pool_allocator(Allocator allocator, int bucket_count, int bucket_size);
 
+#define TLSF_ALIGNMENT 16
+#define TLSF_SL_INDEX_COUNT_LOG2 5
+#define TLSF_SL_INDEX_COUNT (1 << TLSF_SL_INDEX_COUNT_LOG2)
+#define TLSF_FL_INDEX_SHIFT (TLSF_SL_INDEX_COUNT_LOG2 + 4) // log2 of TLSF_ALIGNMENT
+#define TLSF_FL_INDEX_MAX 32 // Biggest single block is 2gb
+#define TLSF_FL_INDEX_COUNT (TLSF_FL_INDEX_MAX - TLSF_FL_INDEX_SHIFT + 1)
+
+// O(1) general purpose allocator that really frees. Lives at the front of its memory block so its free lists survive hot reloads
+typedef struct TLSF_Allocator {
+    u32 fl_bitmap;
+    u32 sl_bitmap[TLSF_FL_INDEX_COUNT];
+    struct TLSF_Block* free_blocks[TLSF_FL_INDEX_COUNT][TLSF_SL_INDEX_COUNT];
+
+    usize used;
+    usize peak;
+    usize total;
+
+    b32 is_initialized;
+} TLSF_Allocator;
+
+Allocator tlsf_allocator(Allocator allocator, usize size);
+
+typedef struct Allocation_Stats {
+    usize current;
+    usize peak;
+    usize total;
+    int alloc_count;
+    int free_count;
+} Allocation_Stats;
+
+typedef struct Allocation_Site {
+    const char* file;
+    int line;
+    Allocation_Stats stats;
+} Allocation_Site;
+
+typedef struct Live_Allocation {
+    void* ptr;
+    usize size;
+    int site;
+} Live_Allocation;
+
+// Must be a power of 2
+#define ALLOCATION_SITE_CAP 256
+#define LIVE_ALLOCATION_CAP (1 << 16)
+
+typedef struct Allocation_Tracker {
+    const char* name;
+    Allocation_Stats stats;
+
+    Allocation_Site sites[ALLOCATION_SITE_CAP];
+    int site_count;
+
+    // Only allocators that really free (heap, pool) keep a table of live allocations so frees can be attributed
+    Live_Allocation* live;
+    int live_count;
+    int dropped_count;
+} Allocation_Tracker;
+
+#define ALLOCATION_TRACKER_CAP 32
+extern Allocation_Tracker* g_allocation_trackers[ALLOCATION_TRACKER_CAP];
+extern int g_allocation_tracker_count;
+
+// Tracker memory comes from backing. Frees are only attributed when tracks_frees is set since arenas never free
+void track_allocator(Allocator* allocator, Allocator backing, const char* name, b32 tracks_frees);
+void clear_allocation_trackers(void);
+
 typedef u32 Rune;
 
 int rune_size(Rune r);
@@ -335,17 +438,80 @@ inline u64 fnv1_hash(void* s, usize size) {
     return hash;
 }
 
-typedef struct Hash_Bucket {
-    u64 hash;
-    int index;
+// wyhash style hash that eats 8 or 16 bytes at a time. Keys of 4, 8 and 16 bytes take a short path with no loop or branches
+#define HASH_SECRET0 0xa0761d6478bd642full
+#define HASH_SECRET1 0xe7037ed1a0b428dbull
+#define HASH_SECRET2 0x8ebc6af09c88c6e3ull
+#define HASH_SECRET3 0x589965cc75374cc3ull
+
+// Full 64x64 -> 128 multiply. a gets the low half and b the high half
+inline void hash_multiply(u64* a, u64* b) {
+#if COMPILER_MSVC
+    u64 high;
+    u64 low = _umul128(*a, *b, &high);
+#else
+    __uint128_t product = (__uint128_t)*a * *b;
+    u64 low  = (u64)product;
+    u64 high = (u64)(product >> 64);
+#endif
+    *a = low;
+    *b = high;
+}
+
+inline u64 hash_mix(u64 a, u64 b) {
+    hash_multiply(&a, &b);
+    return a ^ b;
+}
 
-    struct Hash_Bucket* next;
-} Hash_Bucket;
+inline u64 hash_read_u32(u8* p) { u32 result; mem_copy(&result, p, sizeof(u32)); return result; }
+inline u64 hash_read_u64(u8* p) { u64 result; mem_copy(&result, p, sizeof(u64)); return result; }
+
+inline u64 hash_two_u64(u64 a, u64 b, u64 size) {
+    a ^= HASH_SECRET1;
+    b ^= HASH_SECRET0;
+    hash_multiply(&a, &b);
+    return hash_mix(a ^ HASH_SECRET0 ^ size, b ^ HASH_SECRET1);
+}
+
+inline u64 hash_u32(u32 x) { return hash_two_u64(x, (u64)x << 32, sizeof(u32)); }
+inline u64 hash_u64(u64 x) { return hash_two_u64(x, (x >> 32) | (x << 32), sizeof(u64)); }
+
+u64 _hash_bytes(void* data, usize size, u64 seed);
+
+inline u64 hash_bytes(void* data, usize size) {
+    switch (size) {
+    case 4:  return hash_u32((u32)hash_read_u32(data));
+    case 8:  return hash_u64(hash_read_u64(data));
+    case 16: return hash_two_u64(hash_read_u64(data), hash_read_u64((u8*)data + 8), 16);
+    }
+    return _hash_bytes(data, size, 0);
+}
+
+// For hashing data that shows up in pieces. Gives the same result as hash_bytes on the whole thing
+typedef struct Hash_State {
+    u64 seed, seed1, seed2;
+    u64 size;
+
+    // The first 16 bytes hold the tail of the last block since finishing may read back into it
+    u8 buffer[64];
+    int buffered;
+} Hash_State;
+
+Hash_State begin_hash(void);
+void hash_state_bytes(Hash_State* state, void* data, usize size);
+u64 end_hash(Hash_State* state);
 
 typedef u64 (Hash_Table_Func)(void* a, void* b, int size);
 
 u64 hash_string(void* a, void* b, int size);
 
+// Slots are probed a group at a time. Each slot has a control byte that is either empty, deleted or
+// the low 7 bits of the hash of the pair in it
+#define HASH_GROUP_SIZE 16
+#define HASH_CONTROL_EMPTY   ((u8)0x80)
+#define HASH_CONTROL_DELETED ((u8)0xFE)
+
+// Keys and values are dense arrays in insertion order. Removing a pair moves the last pair into its place
 typedef struct Hash_Table {
     void* keys;
     int key_size;
@@ -353,8 +519,13 @@ typedef struct Hash_Table {
     void* values;
     int value_size;
 
-    Hash_Bucket* buckets;
-    Hash_Bucket** bucket_layout;
+    u64* hashes;     // Per pair so growing never has to call func
+    int* pair_slots; // Per pair slot index
+
+    u8* control;       // Per slot control byte
+    int* slot_pairs;   // Per slot pair index
+    int slot_count;    // Power of 2 and a multiple of HASH_GROUP_SIZE
+    int deleted_count;
 
     int pair_count;
     int pair_cap;
@@ -366,7 +537,13 @@ typedef struct Hash_Table {
 Hash_Table _make_hash_table(int key_size, int value_size, Hash_Table_Func* func, Allocator allocator);
 #define make_hash_table(key, value, func, allocator) _make_hash_table(sizeof(key), sizeof(value), func, allocator)
 
+// For keys with no padding that are equal only when their bytes are. The table hashes and compares these
+// inline instead of calling through func
+u64 hash_pod(void* a, void* b, int size);
+#define make_pod_hash_table(key, value, allocator) _make_hash_table(sizeof(key), sizeof(value), hash_pod, allocator)
+
 void reserve_hash_table(Hash_Table* ht, int reserve_amount);
+void free_hash_table(Hash_Table* ht);
 
 void* _push_hash_table(Hash_Table* ht, void* key, int key_size, void* value, int value_size);
 #define push_hash_table(ht, key, value) _push_hash_table(ht, &key, sizeof(key), &value, sizeof(value))
@@ -2,7 +2,7 @@
 
 static usize get_alignment_offset(void* ptr, usize alignment) {
     if ((usize)ptr & (alignment - 1)) {
-        return alignment - ((usize)ptr & alignment);
+        return alignment - ((usize)ptr & (alignment - 1));
     }
     return 0;
 }
@@ -164,4 +164,403 @@ Allocator pool_allocator(Allocator allocator, int bucket_count, int bucket_cap)
     *header = (Pool_Allocator) { buckets, bucket_count, bucket_cap, allocator_data + sizeof(Pool_Allocator) };
 
     return (Allocator) { header, pool_alloc };
-}
\ No newline at end of file
+}
+
+// Two level segregated fit. First level splits by power of 2 and second level splits each of those
+// linearly so finding a free block is a couple of bit scans instead of a list walk
+//
+// Every block has a header that links it to its physical neighbours. Free blocks also store their
+// free list links at the start of their payload
+
+#define TLSF_BLOCK_FREE ((usize)1)
+
+typedef struct TLSF_Block {
+    struct TLSF_Block* prev_physical;
+    usize size; // Payload size. Low bit is TLSF_BLOCK_FREE
+
+    // Only valid while free
+    struct TLSF_Block* next_free;
+    struct TLSF_Block* prev_free;
+} TLSF_Block;
+
+#define TLSF_HEADER_SIZE  (sizeof(TLSF_Block*) + sizeof(usize))
+#define TLSF_BLOCK_MIN    (sizeof(TLSF_Block) - TLSF_HEADER_SIZE)
+#define TLSF_BLOCK_MAX    ((usize)1 << (TLSF_FL_INDEX_MAX - 1))
+#define TLSF_SMALL_BLOCK  ((usize)1 << TLSF_FL_INDEX_SHIFT)
+
+inline usize tlsf_block_size(TLSF_Block* block) { return block->size & ~TLSF_BLOCK_FREE; }
+inline b32 tlsf_block_is_free(TLSF_Block* block) { return (block->size & TLSF_BLOCK_FREE) != 0; }
+inline void* tlsf_block_to_ptr(TLSF_Block* block) { return (u8*)block + TLSF_HEADER_SIZE; }
+inline TLSF_Block* tlsf_block_from_ptr(void* ptr) { return (TLSF_Block*)((u8*)ptr - TLSF_HEADER_SIZE); }
+inline TLSF_Block* tlsf_next_physical(TLSF_Block* block) { return (TLSF_Block*)((u8*)tlsf_block_to_ptr(block) + tlsf_block_size(block)); }
+
+static void tlsf_mapping(usize size, int* fl, int* sl) {
+    if (size < TLSF_SMALL_BLOCK) {
+        *fl = 0;
+        *sl = (int)(size / (TLSF_SMALL_BLOCK / TLSF_SL_INDEX_COUNT));
+    } else {
+        int top = last_set_bit(size);
+        *sl = (int)((size >> (top - TLSF_SL_INDEX_COUNT_LOG2)) ^ ((usize)1 << TLSF_SL_INDEX_COUNT_LOG2));
+        *fl = top - (TLSF_FL_INDEX_SHIFT - 1);
+    }
+}
+
+static void tlsf_remove_free_block(TLSF_Allocator* tlsf, TLSF_Block* block, int fl, int sl) {
+    TLSF_Block* prev = block->prev_free;
+    TLSF_Block* next = block->next_free;
+    if (prev) prev->next_free = next;
+    if (next) next->prev_free = prev;
+
+    if (tlsf->free_blocks[fl][sl] == block) {
+        tlsf->free_blocks[fl][sl] = next;
+        if (!next) {
+            tlsf->sl_bitmap[fl] &= ~(1u << sl);
+            if (!tlsf->sl_bitmap[fl]) tlsf->fl_bitmap &= ~(1u << fl);
+        }
+    }
+}
+
+static void tlsf_insert_free_block(TLSF_Allocator* tlsf, TLSF_Block* block) {
+    int fl, sl;
+    tlsf_mapping(tlsf_block_size(block), &fl, &sl);
+
+    TLSF_Block* head = tlsf->free_blocks[fl][sl];
+    block->next_free = head;
+    block->prev_free = 0;
+    if (head) head->prev_free = block;
+
+    tlsf->free_blocks[fl][sl] = block;
+    tlsf->fl_bitmap |= 1u << fl;
+    tlsf->sl_bitmap[fl] |= 1u << sl;
+}
+
+static void tlsf_remove(TLSF_Allocator* tlsf, TLSF_Block* block) {
+    int fl, sl;
+    tlsf_mapping(tlsf_block_size(block), &fl, &sl);
+    tlsf_remove_free_block(tlsf, block, fl, sl);
+}
+
+// Splits off everything past size into a new free block if it is big enough to be one
+static void tlsf_trim(TLSF_Allocator* tlsf, TLSF_Block* block, usize size) {
+    usize block_size = tlsf_block_size(block);
+    if (block_size < size + sizeof(TLSF_Block)) return;
+
+    TLSF_Block* remaining = (TLSF_Block*)((u8*)tlsf_block_to_ptr(block) + size);
+    remaining->prev_physical = block;
+    remaining->size = (block_size - size - TLSF_HEADER_SIZE) | TLSF_BLOCK_FREE;
+    block->size = size | (block->size & TLSF_BLOCK_FREE);
+
+    TLSF_Block* next = tlsf_next_physical(remaining);
+    next->prev_physical = remaining;
+
+    // The block after may already be free so merge into it
+    if (tlsf_block_is_free(next)) {
+        tlsf_remove(tlsf, next);
+        remaining->size += tlsf_block_size(next) + TLSF_HEADER_SIZE;
+        tlsf_next_physical(remaining)->prev_physical = remaining;
+    }
+
+    tlsf_insert_free_block(tlsf, remaining);
+}
+
+// Merges block into its previous physical neighbour and returns the merged block
+static TLSF_Block* tlsf_absorb(TLSF_Block* prev, TLSF_Block* block) {
+    prev->size += tlsf_block_size(block) + TLSF_HEADER_SIZE;
+    tlsf_next_physical(prev)->prev_physical = prev;
+    return prev;
+}
+
+static TLSF_Block* tlsf_find_free_block(TLSF_Allocator* tlsf, usize size) {
+    // Round up to the next list so any block found is guaranteed to fit
+    if (size >= TLSF_SMALL_BLOCK) size += ((usize)1 << (last_set_bit(size) - TLSF_SL_INDEX_COUNT_LOG2)) - 1;
+
+    int fl, sl;
+    tlsf_mapping(size, &fl, &sl);
+    if (fl >= TLSF_FL_INDEX_COUNT) return 0;
+
+    u32 sl_map = tlsf->sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map) {
+        u32 fl_map = tlsf->fl_bitmap & (~0u << (fl + 1));
+        if (!fl_map) return 0;
+
+        fl = first_set_bit(fl_map);
+        sl_map = tlsf->sl_bitmap[fl];
+    }
+    sl = first_set_bit(sl_map);
+
+    TLSF_Block* result = tlsf->free_blocks[fl][sl];
+    tlsf_remove_free_block(tlsf, result, fl, sl);
+    return result;
+}
+
+static usize tlsf_adjust_size(usize size) {
+    size = (size + TLSF_ALIGNMENT - 1) & ~(usize)(TLSF_ALIGNMENT - 1);
+    return size < TLSF_BLOCK_MIN ? TLSF_BLOCK_MIN : size;
+}
+
+static void tlsf_free(TLSF_Allocator* tlsf, void* ptr) {
+    TLSF_Block* block = tlsf_block_from_ptr(ptr);
+    assert(!tlsf_block_is_free(block));
+
+    tlsf->used -= tlsf_block_size(block);
+    block->size |= TLSF_BLOCK_FREE;
+
+    TLSF_Block* prev = block->prev_physical;
+    if (prev && tlsf_block_is_free(prev)) {
+        tlsf_remove(tlsf, prev);
+        block = tlsf_absorb(prev, block);
+    }
+
+    TLSF_Block* next = tlsf_next_physical(block);
+    if (tlsf_block_is_free(next)) {
+        tlsf_remove(tlsf, next);
+        block = tlsf_absorb(block, next);
+    }
+
+    tlsf_insert_free_block(tlsf, block);
+}
+
+static void* tlsf_alloc(Allocator allocator, void* ptr, usize size, usize alignment) {
+    TLSF_Allocator* tlsf = allocator.data;
+
+    if (!size) {
+        if (ptr) tlsf_free(tlsf, ptr);
+        return 0;
+    }
+
+    if (alignment < TLSF_ALIGNMENT) alignment = TLSF_ALIGNMENT;
+    usize adjusted = tlsf_adjust_size(size);
+    if (adjusted > TLSF_BLOCK_MAX) return 0;
+
+    if (ptr) {
+        assert(((usize)ptr & (alignment - 1)) == 0);
+
+        TLSF_Block* block = tlsf_block_from_ptr(ptr);
+        usize old_size = tlsf_block_size(block);
+
+        // Grow in place by eating the next block if it is free and big enough
+        TLSF_Block* next = tlsf_next_physical(block);
+        usize combined = old_size + (tlsf_block_is_free(next) ? tlsf_block_size(next) + TLSF_HEADER_SIZE : 0);
+        if (adjusted > old_size && combined >= adjusted) {
+            tlsf_remove(tlsf, next);
+            tlsf_absorb(block, next);
+        }
+
+        if (tlsf_block_size(block) >= adjusted) {
+            tlsf_trim(tlsf, block, adjusted);
+            tlsf->used += tlsf_block_size(block) - old_size;
+            if (tlsf->used > tlsf->peak) tlsf->peak = tlsf->used;
+            return ptr;
+        }
+
+        void* result = tlsf_alloc(allocator, 0, size, alignment);
+        if (result) {
+            mem_copy(result, ptr, old_size);
+            tlsf_free(tlsf, ptr);
+        }
+        return result;
+    }
+
+    // Over aligned requests search for enough room to move the start forward by a whole free block
+    usize padding = alignment > TLSF_ALIGNMENT ? alignment + sizeof(TLSF_Block) : 0;
+    TLSF_Block* block = tlsf_find_free_block(tlsf, adjusted + padding);
+    if (!block) return 0;
+
+    block->size &= ~TLSF_BLOCK_FREE;
+
+    usize gap = get_alignment_offset(tlsf_block_to_ptr(block), alignment);
+    if (gap) {
+        if (gap < sizeof(TLSF_Block)) gap += alignment * ((sizeof(TLSF_Block) - gap + alignment - 1) / alignment);
+
+        // Give the front of the block back as its own free block
+        TLSF_Block* aligned = (TLSF_Block*)((u8*)block + gap);
+        aligned->prev_physical = block;
+        aligned->size = tlsf_block_size(block) - gap;
+        block->size = (gap - TLSF_HEADER_SIZE) | TLSF_BLOCK_FREE;
+        tlsf_next_physical(aligned)->prev_physical = aligned;
+        tlsf_insert_free_block(tlsf, block);
+
+        block = aligned;
+    }
+
+    tlsf_trim(tlsf, block, adjusted);
+    tlsf->used += tlsf_block_size(block);
+    if (tlsf->used > tlsf->peak) tlsf->peak = tlsf->used;
+
+    return tlsf_block_to_ptr(block);
+}
+
+Allocator tlsf_allocator(Allocator allocator, usize size) {
+    usize control_size = (sizeof(TLSF_Allocator) + TLSF_ALIGNMENT - 1) & ~(usize)(TLSF_ALIGNMENT - 1);
+    TLSF_Allocator* tlsf = mem_alloc_aligned(allocator, control_size + size, TLSF_ALIGNMENT);
+
+    // Keep the free lists if this memory was already set up by the last code load
+    if (tlsf->is_initialized) return (Allocator) { tlsf, tlsf_alloc };
+
+    mem_set(tlsf, 0, sizeof(TLSF_Allocator));
+
+    // One big free block followed by a zero sized used block so merging never walks off the end
+    usize pool_size = (size - 2 * TLSF_HEADER_SIZE) & ~(usize)(TLSF_ALIGNMENT - 1);
+    TLSF_Block* block = (TLSF_Block*)((u8*)tlsf + control_size);
+    block->prev_physical = 0;
+    block->size = pool_size | TLSF_BLOCK_FREE;
+
+    TLSF_Block* sentinel = tlsf_next_physical(block);
+    sentinel->prev_physical = block;
+    sentinel->size = 0;
+
+    // Blocks too big for the lists are split so every byte is usable
+    while (tlsf_block_size(block) > TLSF_BLOCK_MAX) {
+        block->size &= ~TLSF_BLOCK_FREE;
+        tlsf_trim(tlsf, block, TLSF_BLOCK_MAX);
+        TLSF_Block* next = tlsf_next_physical(block);
+        block->size |= TLSF_BLOCK_FREE;
+        tlsf_insert_free_block(tlsf, block);
+        tlsf_remove(tlsf, next);
+        block = next;
+    }
+    tlsf_insert_free_block(tlsf, block);
+
+    tlsf->total = pool_size;
+    tlsf->is_initialized = true;
+
+    return (Allocator) { tlsf, tlsf_alloc };
+}
+
+Allocation_Tracker* g_allocation_trackers[ALLOCATION_TRACKER_CAP];
+int g_allocation_tracker_count = 0;
+
+void track_allocator(Allocator* allocator, Allocator backing, const char* name, b32 tracks_frees) {
+#if ALLOCATION_TRACKING
+    assert(g_allocation_tracker_count < ALLOCATION_TRACKER_CAP);
+
+    // Memory is persistent across reloads so clear out whatever the last build left here
+    Allocation_Tracker* tracker = mem_alloc_struct(backing, Allocation_Tracker);
+    mem_set(tracker, 0, sizeof(Allocation_Tracker));
+    tracker->name = name;
+
+    if (tracks_frees) {
+        tracker->live = mem_alloc_array(backing, Live_Allocation, LIVE_ALLOCATION_CAP);
+        mem_set(tracker->live, 0, sizeof(Live_Allocation) * LIVE_ALLOCATION_CAP);
+    }
+
+    g_allocation_trackers[g_allocation_tracker_count++] = tracker;
+    allocator->tracker = tracker;
+#endif
+}
+
+void clear_allocation_trackers(void) {
+    g_allocation_tracker_count = 0;
+}
+
+#if ALLOCATION_TRACKING
+
+static void add_allocation_stats(Allocation_Stats* stats, usize size) {
+    stats->current += size;
+    stats->total   += size;
+    stats->alloc_count += 1;
+    if (stats->current > stats->peak) stats->peak = stats->current;
+}
+
+static void remove_allocation_stats(Allocation_Stats* stats, usize size) {
+    stats->current -= size < stats->current ? size : stats->current;
+    stats->free_count += 1;
+}
+
+static int find_allocation_site(Allocation_Tracker* tracker, const char* file, int line) {
+    // __FILE__ is a string literal so comparing the pointer is enough
+    usize hash = ((usize)file >> 3) * 31 + (usize)line;
+    for (int i = 0; i < ALLOCATION_SITE_CAP; ++i) {
+        int index = (int)((hash + i) & (ALLOCATION_SITE_CAP - 1));
+        Allocation_Site* site = &tracker->sites[index];
+
+        if (site->file == file && site->line == line) return index;
+        if (!site->file) {
+            site->file = file;
+            site->line = line;
+            tracker->site_count += 1;
+            return index;
+        }
+    }
+
+    // Out of sites. Everything else gets lumped into the last one
+    return ALLOCATION_SITE_CAP - 1;
+}
+
+static Live_Allocation* find_live_allocation(Allocation_Tracker* tracker, void* ptr, b32 for_insert) {
+    usize hash = ((usize)ptr >> 4) * 0x9E3779B97F4A7C15ull;
+    Live_Allocation* tombstone = 0;
+    for (int i = 0; i < LIVE_ALLOCATION_CAP; ++i) {
+        Live_Allocation* it = &tracker->live[(hash + i) & (LIVE_ALLOCATION_CAP - 1)];
+
+        if (it->ptr == ptr) return it;
+        if (!it->ptr) {
+            if (!for_insert) return 0;
+            // A site of -1 marks a removed entry that still has to be probed past
+            if (it->site != -1) return tombstone ? tombstone : it;
+            if (!tombstone) tombstone = it;
+        }
+    }
+
+    return for_insert ? tombstone : 0;
+}
+
+static void remove_live_allocation(Allocation_Tracker* tracker, void* ptr) {
+    if (!tracker->live || !ptr) return;
+
+    Live_Allocation* found = find_live_allocation(tracker, ptr, false);
+    if (!found) return;
+
+    remove_allocation_stats(&tracker->stats, found->size);
+    remove_allocation_stats(&tracker->sites[found->site].stats, found->size);
+
+    *found = (Live_Allocation) { 0, 0, -1 };
+    tracker->live_count -= 1;
+}
+
+static void add_live_allocation(Allocation_Tracker* tracker, void* ptr, usize size, int site) {
+    if (!tracker->live) return;
+
+    if (tracker->live_count >= LIVE_ALLOCATION_CAP / 2) {
+        tracker->dropped_count += 1;
+        return;
+    }
+
+    Live_Allocation* slot = find_live_allocation(tracker, ptr, true);
+    if (!slot) {
+        tracker->dropped_count += 1;
+        return;
+    }
+
+    *slot = (Live_Allocation) { ptr, size, site };
+    tracker->live_count += 1;
+}
+
+void* _mem_call_tracked(Allocator allocator, void* ptr, usize size, usize alignment, const char* file, int line) {
+    Allocation_Tracker* tracker = allocator.tracker;
+    void* result = allocator.proc(allocator, ptr, size, alignment);
+
+    // Arenas never free so only allocators with a live table account for frees and reallocs
+    if (ptr) remove_live_allocation(tracker, ptr);
+
+    if (size && result) {
+        int site = find_allocation_site(tracker, file, line);
+        add_allocation_stats(&tracker->stats, size);
+        add_allocation_stats(&tracker->sites[site].stats, size);
+        add_live_allocation(tracker, result, size, site);
+    }
+
+    return result;
+}
+
+void note_allocator_reset(Allocation_Tracker* tracker) {
+    tracker->stats.current = 0;
+    for (int i = 0; i < ALLOCATION_SITE_CAP; ++i) tracker->sites[i].stats.current = 0;
+
+    if (tracker->live) {
+        mem_set(tracker->live, 0, sizeof(Live_Allocation) * LIVE_ALLOCATION_CAP);
+        tracker->live_count = 0;
+    }
+}
+
+#endif
@@ -9,10 +9,21 @@
 
 #define DEFINE_GL_FUNCTIONS(type, func) type func = 0;
 GL_BINDINGS(DEFINE_GL_FUNCTIONS)
+GL_OPTIONAL_BINDINGS(DEFINE_GL_FUNCTIONS)
 #undef  DEFINE_GL_FUNCTIONS
 
 OpenGL_Context* g_gl_context = 0;
 
+b32 has_gl_extension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && str_cmp(extension, name) == 0) return true;
+    }
+    return false;
+}
+
 b32 upload_texture2d(Texture2d* t) {
     GLint format = 0;
     switch (t->depth) {
@@ -65,7 +76,41 @@ b32 upload_texture2d(Texture2d* t) {
     return true;
 }
 
+b32 upload_texture_array(Texture_Array* t, u8* pixels) {
+    if (t->id == 0) glGenTextures(1, &t->id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, t->id);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glTexImage3D(
+        GL_TEXTURE_2D_ARRAY,
+        0,
+        GL_SRGB_ALPHA,
+        t->width,
+        t->height,
+        t->layer_count,
+        0,
+        GL_RGBA,
+        GL_UNSIGNED_BYTE,
+        pixels
+    );
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return true;
+}
+
+static const char* shader_uniform_names[] = {
+#define SHADER_UNIFORM_NAME(su, name) name,
+    SHADER_UNIFORM_DEFINITION(SHADER_UNIFORM_NAME)
+#undef SHADER_UNIFORM_NAME
+};
+
 b32 init_shader(Shader* shader) {
+    mem_set(shader->uniform_indices, -1, sizeof(shader->uniform_indices));
+
     GLuint program_id = glCreateProgram();
 
     GLuint vert_id = glCreateShader(GL_VERTEX_SHADER);
@@ -122,6 +167,10 @@ b32 init_shader(Shader* shader) {
     glDeleteShader(frag_id);
 
     glGetProgramiv(program_id, GL_ACTIVE_UNIFORMS, &shader->uniform_count);
+    if (shader->uniform_count > SHADER_UNIFORM_CAP) {
+        o_log_error("[OpenGL] Shader has %i uniforms but only %i are supported", shader->uniform_count, SHADER_UNIFORM_CAP);
+        shader->uniform_count = SHADER_UNIFORM_CAP;
+    }
     for (GLint i = 0; i < shader->uniform_count; ++i) {
         GLsizei length;
         GLint size;
@@ -136,6 +185,10 @@ b32 init_shader(Shader* shader) {
         uniform.location = glGetUniformLocation(program_id, name);
 
         shader->uniforms[i] = uniform;
+
+        for (int j = 0; j < SU_Count; ++j) {
+            if (str_cmp(uniform.name, shader_uniform_names[j]) == 0) shader->uniform_indices[j] = (s8)i;
+        }
     }
 
     shader->id = program_id;
@@ -143,7 +196,13 @@ b32 init_shader(Shader* shader) {
 }
 
 b32 free_shader(Shader* shader) {
-    return false; // @TODO
+    if (!shader->id) return false;
+
+    glDeleteProgram(shader->id);
+    shader->id = 0;
+    shader->uniform_count = 0;
+    mem_set(shader->uniform_indices, -1, sizeof(shader->uniform_indices));
+    return true;
 }
 
 static char* get_shader_var_type_string(GLenum type) {
@@ -154,6 +213,7 @@ static char* get_shader_var_type_string(GLenum type) {
         case GL_FLOAT_VEC4: return "Vector4";
         case GL_FLOAT_MAT4: return "Matrix4";
         case GL_SAMPLER_2D: return "Texture2D";
+        case GL_SAMPLER_2D_ARRAY: return "Texture_Array";
         default:            invalid_code_path;
     }
 
@@ -161,50 +221,64 @@ static char* get_shader_var_type_string(GLenum type) {
 }
 
 static
-Shader_Uniform* find_uniform(char* name, GLenum type) {
+Shader_Uniform* find_uniform(Shader_Uniform_Id id, GLenum type) {
     Shader* s = get_bound_shader();
     if (!s) {
         o_log_error("[OpenGL] Tried to set uniform but no shader was bound");
         return false;
     }
 
-    for (int i = 0; i < s->uniform_count; ++i) {
-        Shader_Uniform* it = &s->uniforms[i];
+    int index = s->uniform_indices[id];
+    if (index < 0) return 0;
 
-        if (str_cmp(name, it->name) != 0) continue;
-
-        if (it->type != type) {
-            o_log_error("[OpenGL] Tried to set uniform with wrong type. %s has the type of %s", name, get_shader_var_type_string(GL_FLOAT_MAT4));
-            return 0;
-        }
-
-        return it;
+    Shader_Uniform* it = &s->uniforms[index];
+    if (it->type != type) {
+        o_log_error("[OpenGL] Tried to set uniform with wrong type. %s has the type of %s", shader_uniform_names[id], get_shader_var_type_string(it->type));
+        return 0;
     }
 
-    return 0;
+    return it;
 }
 
-b32 set_uniform_m4(char* name, Matrix4 m) {
-    Shader_Uniform* var = find_uniform(name, GL_FLOAT_MAT4);
+b32 set_uniform_m4(Shader_Uniform_Id id, Matrix4 m) {
+    Shader_Uniform* var = find_uniform(id, GL_FLOAT_MAT4);
     if (!var) return false; 
 
     glUniformMatrix4fv(var->location, 1, GL_FALSE, m.e);
     return true;
 }
 
-b32 set_uniform_texture(char* name, Texture2d t) {
-    Shader_Uniform* var = find_uniform(name, GL_SAMPLER_2D);
+b32 set_uniform_texture(Shader_Uniform_Id id, Texture2d t) {
+    Shader_Uniform* var = find_uniform(id, GL_SAMPLER_2D);
     if (!var) return false; 
 
-    glActiveTexture(GL_TEXTURE0 + var->location);
-    glBindTexture(GL_TEXTURE_2D, t.id);
+    set_uniform_texture_at(var->location, t.id);
+    return true;
+}
+
+void set_uniform_texture_at(GLint location, GLuint texture) {
+    glActiveTexture(GL_TEXTURE0 + location);
+    glBindTexture(GL_TEXTURE_2D, texture);
 
+    glUniform1i(location, location);
+
+    g_gl_context->bound_texture = texture;
+    g_gl_context->bound_texture_location = location;
+}
+
+// Not tracked as the bound texture. Imm commands only ever bind GL_TEXTURE_2D
+b32 set_uniform_texture_array(Shader_Uniform_Id id, Texture_Array t) {
+    Shader_Uniform* var = find_uniform(id, GL_SAMPLER_2D_ARRAY);
+    if (!var) return false;
+
+    glActiveTexture(GL_TEXTURE0 + var->location);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, t.id);
     glUniform1i(var->location, var->location);
     return true;
 }
 
-b32 set_uniform_v4(char* name, Vector4 v) {
-    Shader_Uniform* var = find_uniform(name, GL_FLOAT_VEC4);
+b32 set_uniform_v4(Shader_Uniform_Id id, Vector4 v) {
+    Shader_Uniform* var = find_uniform(id, GL_FLOAT_VEC4);
     if (!var) return false; 
 
     glUniform4f(var->location, v.x, v.y, v.z, v.w);
@@ -212,6 +286,9 @@ b32 set_uniform_v4(char* name, Vector4 v) {
 }
 
 void set_shader(Shader* s) {
+    g_gl_context->bound_texture = 0;
+    g_gl_context->bound_texture_location = 0;
+
     if (!s) {
         glUseProgram(0);
         g_gl_context->bound_shader = 0;
@@ -238,6 +315,7 @@ b32 init_framebuffer(int width, int height, int flags, Framebuffer* framebuffer)
     };
 
     if ((flags & FF_HDR)) assert((flags & FF_Albedo) == 0);
+    if ((flags & FF_Color)) assert((flags & (FF_Albedo | FF_HDR)) == 0);
 
     if ((flags & FF_Position) != 0) {
         GLuint position_texture;
@@ -324,6 +402,24 @@ b32 init_framebuffer(int width, int height, int flags, Framebuffer* framebuffer)
         };
     }
 
+    if ((flags & FF_Color) != 0) {
+        GLuint color_texture;
+        glGenTextures(1, &color_texture);
+        glBindTexture(GL_TEXTURE_2D, color_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + FCI_Color, GL_TEXTURE_2D, color_texture, 0);
+        result.color[FCI_Color] = (Texture2d) {
+            .width  = width,
+            .height = height,
+            .depth  = 4,
+            .id     = color_texture,
+        };
+    }
+
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
         // @TODO(colby): do cleanup
         return false;
@@ -345,6 +441,7 @@ b32 free_framebuffer(Framebuffer* framebuffer) {
     if ((flags & FF_Normal) != 0)   textures_to_delete[num_textures_to_delete++] = framebuffer->color[FCI_Normal].id;
     if ((flags & FF_Albedo) != 0)   textures_to_delete[num_textures_to_delete++] = framebuffer->color[FCI_Albedo].id;
     if ((flags & FF_HDR) != 0)      textures_to_delete[num_textures_to_delete++] = framebuffer->color[FCI_HDR].id;
+    if ((flags & FF_Color) != 0)    textures_to_delete[num_textures_to_delete++] = framebuffer->color[FCI_Color].id;
     if ((flags & FF_Depth) != 0)    textures_to_delete[num_textures_to_delete++] = framebuffer->depth.id;
 
     glDeleteTextures(num_textures_to_delete, textures_to_delete);
@@ -373,6 +470,7 @@ void begin_framebuffer(Framebuffer framebuffer) {
     if ((flags & FF_Normal) != 0)   attachments[num_attachments++] = GL_COLOR_ATTACHMENT0 + FCI_Normal;
     if ((flags & FF_Albedo) != 0)   attachments[num_attachments++] = GL_COLOR_ATTACHMENT0 + FCI_Albedo;
     if ((flags & FF_HDR) != 0)      attachments[num_attachments++] = GL_COLOR_ATTACHMENT0 + FCI_HDR;
+    if ((flags & FF_Color) != 0)    attachments[num_attachments++] = GL_COLOR_ATTACHMENT0 + FCI_Color;
 
     glDrawBuffers(num_attachments, attachments);
     glViewport(0, 0, framebuffer.width, framebuffer.height);
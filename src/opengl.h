@@ -47,6 +47,8 @@ macro(PFNGLGETCOMPRESSEDTEXIMAGEPROC, glGetCompressedTexImage) \
 macro(PFNGLBLENDFUNCSEPARATEPROC, glBlendFuncSeparate) \
 macro(PFNGLMULTIDRAWARRAYSPROC, glMultiDrawArrays) \
 macro(PFNGLMULTIDRAWELEMENTSPROC, glMultiDrawElements) \
+macro(PFNGLDRAWELEMENTSBASEVERTEXPROC, glDrawElementsBaseVertex) \
+macro(PFNGLMULTIDRAWELEMENTSBASEVERTEXPROC, glMultiDrawElementsBaseVertex) \
 macro(PFNGLPOINTPARAMETERFPROC, glPointParameterf) \
 macro(PFNGLPOINTPARAMETERFVPROC, glPointParameterfv) \
 macro(PFNGLPOINTPARAMETERIPROC, glPointParameteri) \
@@ -227,12 +229,18 @@ macro(PFNGLCLIENTWAITSYNCPROC, glClientWaitSync)\
 macro(PFNGLBINDBUFFERRANGEPROC, glBindBufferRange)\
 macro(PFNGLDEBUGMESSAGECALLBACKPROC, glDebugMessageCallback)
 
+// Newer than the 3.3 context we ask for so these can be missing. Check the matching OpenGL_Context flag before use
+#define GL_OPTIONAL_BINDINGS(macro) \
+macro(PFNGLBUFFERSTORAGEPROC, glBufferStorage)
+
 #define DECLARE_GL_FUNCTIONS(type, func) extern type func;
 GL_BINDINGS(DECLARE_GL_FUNCTIONS)
+GL_OPTIONAL_BINDINGS(DECLARE_GL_FUNCTIONS)
 #undef  DECLARE_GL_FUNCTIONS
 
 b32 init_opengl(Platform* platform);
 void swap_gl_buffers(Platform* platform);
+b32 has_gl_extension(const char* name);
 
 typedef struct Texture2d {
     u8* pixels;
@@ -243,6 +251,17 @@ typedef struct Texture2d {
 
 b32 upload_texture2d(Texture2d* t);
 
+// Same sized RGBA layers in one GL_TEXTURE_2D_ARRAY. Layers can't bleed into each other so uvs don't need insets
+typedef struct Texture_Array {
+    int width, height; // Of each layer
+    int layer_count;
+
+    GLuint id;
+} Texture_Array;
+
+// pixels is every layer back to back. They're uploaded as sRGB like 4 channel Texture2ds
+b32 upload_texture_array(Texture_Array* t, u8* pixels);
+
 #define SHADER_UNFORM_NAME_CAP 48
 typedef struct Shader_Uniform {
     GLchar name[SHADER_UNFORM_NAME_CAP];
@@ -252,6 +271,24 @@ typedef struct Shader_Uniform {
     GLint location;
 } Shader_Uniform;
 
+// Every uniform the engine sets. Each shader maps these to its own uniforms when it's built so setting one is an array lookup
+#define SHADER_UNIFORM_DEFINITION(def) \
+def(SU_Projection,     "projection") \
+def(SU_View,           "view") \
+def(SU_Diffuse,        "diffuse") \
+def(SU_Atlas,          "atlas") \
+def(SU_Distance_Atlas, "distance_atlas") \
+def(SU_Sprites,        "sprites") \
+def(SU_Layer_Z,        "layer_z") \
+def(SU_Color,          "color")
+
+typedef enum Shader_Uniform_Id {
+#define SHADER_UNIFORM_ENUM(su, name) su,
+    SHADER_UNIFORM_DEFINITION(SHADER_UNIFORM_ENUM)
+#undef SHADER_UNIFORM_ENUM
+    SU_Count,
+} Shader_Uniform_Id;
+
 #define SHADER_UNIFORM_CAP 16
 typedef struct Shader {
     GLuint id;
@@ -260,14 +297,18 @@ typedef struct Shader {
 
     Shader_Uniform uniforms[SHADER_UNIFORM_CAP];
     int uniform_count;
+
+    s8 uniform_indices[SU_Count]; // Index into uniforms or -1 if the shader doesn't have it
 } Shader;
 
 b32 init_shader(Shader* shader);
 b32 free_shader(Shader* shader);
 
-b32 set_uniform_m4(char* name, Matrix4 m);
-b32 set_uniform_texture(char* name, Texture2d t);
-b32 set_uniform_v4(char* name, Vector4 v);
+b32 set_uniform_m4(Shader_Uniform_Id id, Matrix4 m);
+b32 set_uniform_texture(Shader_Uniform_Id id, Texture2d t);
+void set_uniform_texture_at(GLint location, GLuint texture);
+b32 set_uniform_texture_array(Shader_Uniform_Id id, Texture_Array t);
+b32 set_uniform_v4(Shader_Uniform_Id id, Vector4 v);
 
 void set_shader(Shader* s);
 Shader* get_bound_shader(void);
@@ -281,6 +322,7 @@ enum Framebuffer_Flags {
     FF_GBuffer     = (FF_Position | FF_Normal | FF_Albedo | FF_Depth),
 
     FF_HDR         = (1 << 4),
+    FF_Color       = (1 << 5), // sRGB and linearly filtered so it can be drawn back at a different size
 };
 
 enum Framebuffer_Colors_Index {
@@ -289,6 +331,7 @@ enum Framebuffer_Colors_Index {
     FCI_Albedo,
     FCI_Count,
     FCI_HDR      = 0,
+    FCI_Color    = 0,
 };
 
 typedef struct Framebuffer {
@@ -310,8 +353,14 @@ void clear_framebuffer(Vector3 color);
 typedef struct OpenGL_Context {
     GLint maj_version, min_version;
 
+    b32 has_buffer_storage; // GL 4.4 or ARB_buffer_storage
+
     Shader* bound_shader;
 
+    // Last texture set through set_uniform_texture since the shader was bound. Queued draws remember this
+    GLuint bound_texture;
+    GLint bound_texture_location;
+
     b32 is_initialized;
 } OpenGL_Context;
 
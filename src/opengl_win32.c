@@ -27,6 +27,7 @@ b32 init_opengl(Platform* platform) {
     if (g_gl_context->is_initialized) {
         GL_BINDINGS(LOAD_GL_BINDINGS);
         GL_BINDINGS(CHECK_GL_BINDINGS);
+        GL_OPTIONAL_BINDINGS(LOAD_GL_BINDINGS);
         return true;
     }
 
@@ -74,6 +75,7 @@ b32 init_opengl(Platform* platform) {
 
             GL_BINDINGS(LOAD_GL_BINDINGS);
             GL_BINDINGS(CHECK_GL_BINDINGS);
+            GL_OPTIONAL_BINDINGS(LOAD_GL_BINDINGS);
 
             wglMakeCurrent(window_context, 0);
         }
@@ -121,6 +123,9 @@ b32 init_opengl(Platform* platform) {
     glGetIntegerv(GL_MAJOR_VERSION, &g_gl_context->maj_version);
     glGetIntegerv(GL_MINOR_VERSION, &g_gl_context->min_version);
 
+    b32 is_gl_4_4 = g_gl_context->maj_version > 4 || (g_gl_context->maj_version == 4 && g_gl_context->min_version >= 4);
+    g_gl_context->has_buffer_storage = glBufferStorage && (is_gl_4_4 || has_gl_extension("GL_ARB_buffer_storage"));
+
     g_gl_context->is_initialized = true;
 
     o_log_verbose(
@@ -17,18 +17,28 @@
 #error Platform not yet implemented.
 #endif
 
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define HASH_TABLE_SSE2 1
+#else
+#define HASH_TABLE_SSE2 0
+#endif
+
 #include "memory.c"
 #include "string.c"
 #include "math.c"
 #include "debug.c"
 #include "opengl.c"
+#include "rasterizer.c"
 #include "draw.c"
 #include "asset.c"
 #include "entity_manager.c"
 #include "controller.c"
 #include "pawn.c"
 #include "furniture.c"
+#include "cell_map.c"
 #include "gui.c"
+#include "benchmark.c"
 
 Platform* g_platform = 0;
 
@@ -42,67 +52,162 @@ Hash_Table _make_hash_table(int key_size, int value_size, Hash_Table_Func* func,
     };
 }
 
-static void rebuild_hash_table(Hash_Table* ht) {
-    mem_set(ht->bucket_layout, 0, sizeof(Hash_Bucket*) * ht->pair_cap);
+inline u64 hash_pod_key(void* key, int size) { return hash_bytes(key, size); }
+
+inline b32 pod_keys_equal(void* a, void* b, int size) {
+    u64 a_word, b_word;
+    switch (size) {
+    case sizeof(u32):
+        return *(u32*)a == *(u32*)b;
+    case sizeof(u64):
+        mem_copy(&a_word, a, sizeof(u64));
+        mem_copy(&b_word, b, sizeof(u64));
+        return a_word == b_word;
+    }
+    return memcmp(a, b, size) == 0; // @CRT
+}
 
-    for (int i = 0; i < ht->pair_count; ++i) {
-        Hash_Bucket* bucket = ht->buckets + i;
-        bucket->hash = ht->func((u8*)ht->keys + ht->key_size * i, 0, ht->key_size);
-        bucket->index = i;
-        bucket->next = 0;
-
-        int index = bucket->hash % ht->pair_cap;
-        Hash_Bucket** last = 0;
-        Hash_Bucket** slot = ht->bucket_layout + index;
-        while (*slot) {
-            last = slot;
-            slot = &(*slot)->next;
-        }
-        *slot = bucket;
-        if (last) (*last)->next = *slot;
+u64 hash_pod(void* a, void* b, int size) {
+    if (b) return pod_keys_equal(a, b, size);
+    return hash_pod_key(a, size);
+}
+
+inline u64 hash_key(Hash_Table* ht, void* key) {
+    if (ht->func == hash_pod) return hash_pod_key(key, ht->key_size);
+    return ht->func(key, 0, ht->key_size);
+}
+
+inline b32 hash_keys_equal(Hash_Table* ht, void* a, void* b) {
+    if (ht->func == hash_pod) return pod_keys_equal(a, b, ht->key_size);
+    return ht->func(a, b, ht->key_size) != 0;
+}
+
+inline u8 hash_control(u64 hash) { return (u8)(hash & 0x7F); }
+inline int hash_first_group(Hash_Table* ht, u64 hash) { return (int)(hash >> 7) & ((ht->slot_count / HASH_GROUP_SIZE) - 1); }
+
+// Bit i is set for every byte i in the group equal to control
+static u32 match_hash_group(u8* group, u8 control) {
+#if HASH_TABLE_SSE2
+    __m128i bytes = _mm_load_si128((__m128i*)group);
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)control)));
+#else
+    u32 result = 0;
+    for (int i = 0; i < HASH_GROUP_SIZE; ++i) {
+        if (group[i] == control) result |= 1 << i;
     }
+    return result;
+#endif
 }
 
-void* _push_hash_table(Hash_Table* ht, void* key, int key_size, void* value, int value_size) {
-    assert(key_size == ht->key_size && value_size == ht->value_size);
+// Empty and deleted are the only control bytes with the high bit set
+static u32 match_free_hash_group(u8* group) {
+#if HASH_TABLE_SSE2
+    return (u32)_mm_movemask_epi8(_mm_load_si128((__m128i*)group));
+#else
+    u32 result = 0;
+    for (int i = 0; i < HASH_GROUP_SIZE; ++i) {
+        if (group[i] & 0x80) result |= 1 << i;
+    }
+    return result;
+#endif
+}
+
+static int find_free_slot(Hash_Table* ht, u64 hash) {
+    int group_mask = ht->slot_count / HASH_GROUP_SIZE - 1;
+    int group = hash_first_group(ht, hash);
 
-    void* found = _find_hash_table(ht, key, key_size);
-    if (found) return found;
+    // Triangular steps visit every group when the group count is a power of 2
+    for (int probe = 1; ; ++probe) {
+        u32 free_slots = match_free_hash_group(ht->control + group * HASH_GROUP_SIZE);
+        if (free_slots) return group * HASH_GROUP_SIZE + first_set_bit(free_slots);
 
-    if (ht->pair_count == ht->pair_cap) {
-        reserve_hash_table(ht, 1);
-        mem_copy((u8*)ht->keys + key_size * ht->pair_count, key, key_size);
-        
-        if (value) mem_copy((u8*)ht->values + value_size * ht->pair_count, value, value_size);
-        else mem_set((u8*)ht->values + value_size * ht->pair_count, 0, value_size);
-        
-        ht->pair_count += 1;
-        rebuild_hash_table(ht);
-        return (u8*)ht->values + value_size * (ht->pair_count - 1);
+        group = (group + probe) & group_mask;
     }
+}
+
+static void rehash_hash_table(Hash_Table* ht, int slot_count) {
+    assert(slot_count >= HASH_GROUP_SIZE && (slot_count & (slot_count - 1)) == 0);
 
-    mem_copy((u8*)ht->keys + key_size * ht->pair_count, key, key_size);
-    if (value) mem_copy((u8*)ht->values + value_size * ht->pair_count, value, value_size);
-    else mem_set((u8*)ht->values + value_size * ht->pair_count, 0, value_size);
+    if (slot_count != ht->slot_count) {
+        mem_free(ht->allocator, ht->control);
+        mem_free(ht->allocator, ht->slot_pairs);
+        ht->control    = mem_alloc_aligned(ht->allocator, slot_count, HASH_GROUP_SIZE);
+        ht->slot_pairs = mem_alloc_array(ht->allocator, int, slot_count);
+        ht->slot_count = slot_count;
+    }
 
-    Hash_Bucket* bucket = ht->buckets + ht->pair_count;
-    bucket->hash = ht->func((u8*)ht->keys + key_size * ht->pair_count, 0, key_size);
-    bucket->index = ht->pair_count;
-    bucket->next = 0;
+    mem_set(ht->control, HASH_CONTROL_EMPTY, slot_count);
+    ht->deleted_count = 0;
 
-    int index = bucket->hash % ht->pair_cap;
-    Hash_Bucket** last = 0;
-    Hash_Bucket** slot = ht->bucket_layout + index;
-    while (*slot) {
-        last = slot;
-        slot = &(*slot)->next;
+    for (int i = 0; i < ht->pair_count; ++i) {
+        int slot = find_free_slot(ht, ht->hashes[i]);
+        ht->control[slot]    = hash_control(ht->hashes[i]);
+        ht->slot_pairs[slot] = i;
+        ht->pair_slots[i]    = slot;
     }
-    *slot = bucket;
-    if (last) (*last)->next = *slot;
+}
+
+static int find_pair_index(Hash_Table* ht, void* key, u64 hash) {
+    if (!ht->pair_count) return -1;
+
+    u8 control = hash_control(hash);
+    int group_mask = ht->slot_count / HASH_GROUP_SIZE - 1;
+    int group = hash_first_group(ht, hash);
+
+    for (int probe = 1; probe <= group_mask + 1; ++probe) {
+        u8* group_control = ht->control + group * HASH_GROUP_SIZE;
+
+        u32 matches = match_hash_group(group_control, control);
+        while (matches) {
+            int slot = group * HASH_GROUP_SIZE + first_set_bit(matches);
+            matches &= matches - 1;
+
+            // The control byte only has 7 bits of the hash so check the whole hash before paying for the key compare
+            int index = ht->slot_pairs[slot];
+            if (ht->hashes[index] == hash && hash_keys_equal(ht, key, (u8*)ht->keys + index * ht->key_size)) {
+                return index;
+            }
+        }
 
-    ht->pair_count++;
+        // Nothing is ever probed past a group with an empty slot
+        if (match_hash_group(group_control, HASH_CONTROL_EMPTY)) return -1;
+
+        group = (group + probe) & group_mask;
+    }
+
+    return -1;
+}
+
+void* _push_hash_table(Hash_Table* ht, void* key, int key_size, void* value, int value_size) {
+    assert(key_size == ht->key_size && value_size == ht->value_size);
+
+    u64 hash = hash_key(ht, key);
+    int found_index = find_pair_index(ht, key, hash);
+    if (found_index != -1) return (u8*)ht->values + value_size * found_index;
+
+    if (ht->pair_count == ht->pair_cap) reserve_hash_table(ht, 1);
+
+    // Keep the load under 7/8. Tombstones are dropped in place if that frees enough room otherwise grow
+    if ((ht->pair_count + ht->deleted_count + 1) * 8 > ht->slot_count * 7) {
+        if (ht->pair_count * 32 <= ht->slot_count * 25) rehash_hash_table(ht, ht->slot_count);
+        else rehash_hash_table(ht, ht->slot_count * 2);
+    }
 
-    return (u8*)ht->values + value_size * (ht->pair_count - 1);
+    // Value may point at pair_count so only bump it after copying
+    int index = ht->pair_count;
+    mem_copy((u8*)ht->keys + key_size * index, key, key_size);
+    if (value) mem_copy((u8*)ht->values + value_size * index, value, value_size);
+    else mem_set((u8*)ht->values + value_size * index, 0, value_size);
+    ht->pair_count += 1;
+
+    int slot = find_free_slot(ht, hash);
+    if (ht->control[slot] == HASH_CONTROL_DELETED) ht->deleted_count -= 1;
+    ht->control[slot]    = hash_control(hash);
+    ht->slot_pairs[slot] = index;
+    ht->hashes[index]     = hash;
+    ht->pair_slots[index] = slot;
+
+    return (u8*)ht->values + value_size * index;
 }
 
 void reserve_hash_table(Hash_Table* ht, int reserve_amount) {
@@ -114,11 +219,25 @@ void reserve_hash_table(Hash_Table* ht, int reserve_amount) {
         ht->pair_cap++;
     }
 
-    ht->keys          = mem_realloc(ht->allocator, ht->keys, ht->key_size * ht->pair_cap);
-    ht->values        = mem_realloc(ht->allocator, ht->values, ht->value_size * ht->pair_cap);
-    ht->buckets       = mem_realloc(ht->allocator, ht->buckets, sizeof(Hash_Bucket) * ht->pair_cap);
-    ht->bucket_layout = mem_realloc(ht->allocator, ht->bucket_layout, sizeof(Hash_Bucket*) * ht->pair_cap);
-    mem_set(ht->bucket_layout, 0, sizeof(Hash_Bucket*) * ht->pair_cap);
+    ht->keys       = mem_realloc(ht->allocator, ht->keys, ht->key_size * ht->pair_cap);
+    ht->values     = mem_realloc(ht->allocator, ht->values, ht->value_size * ht->pair_cap);
+    ht->hashes     = mem_realloc(ht->allocator, ht->hashes, sizeof(u64) * ht->pair_cap);
+    ht->pair_slots = mem_realloc(ht->allocator, ht->pair_slots, sizeof(int) * ht->pair_cap);
+
+    // Make sure every reserved pair fits without another rehash
+    int slot_count = ht->slot_count ? ht->slot_count : HASH_GROUP_SIZE;
+    while (ht->pair_cap * 8 > slot_count * 7) slot_count *= 2;
+    if (slot_count != ht->slot_count) rehash_hash_table(ht, slot_count);
+}
+
+void free_hash_table(Hash_Table* ht) {
+    mem_free(ht->allocator, ht->keys);
+    mem_free(ht->allocator, ht->values);
+    mem_free(ht->allocator, ht->hashes);
+    mem_free(ht->allocator, ht->pair_slots);
+    mem_free(ht->allocator, ht->control);
+    mem_free(ht->allocator, ht->slot_pairs);
+    *ht = _make_hash_table(ht->key_size, ht->value_size, ht->func, ht->allocator);
 }
 
 int _index_hash_table(Hash_Table* ht, void* key, int key_size) {
@@ -126,19 +245,7 @@ int _index_hash_table(Hash_Table* ht, void* key, int key_size) {
 
     if (!ht->pair_count) return -1;
 
-    u64 hash = ht->func(key, 0, key_size);
-    int index = hash % ht->pair_cap;
-
-    Hash_Bucket* found = ht->bucket_layout[index];
-    while (found) {
-        u64 my_hash = found->hash;
-        if (my_hash == hash) { // @TEMP } && ht->func(key, (u8*)ht->keys + found->index * key_size, key_size)) {
-            return found->index;
-        }
-        found = found->next;
-    }    
-
-    return -1;
+    return find_pair_index(ht, key, hash_key(ht, key));
 }
 
 void* _find_hash_table(Hash_Table* ht, void* key, int key_size) {
@@ -158,26 +265,124 @@ b32 _remove_hash_table(Hash_Table* ht, void* key, int key_size) {
     int found_index = _index_hash_table(ht, key, key_size);
     if (found_index == -1) return false;
 
+    // A group with an empty slot never made a probe move on so the slot can go straight back to empty
+    int slot = ht->pair_slots[found_index];
+    u8* group_control = ht->control + (slot & ~(HASH_GROUP_SIZE - 1));
+    if (match_hash_group(group_control, HASH_CONTROL_EMPTY)) {
+        ht->control[slot] = HASH_CONTROL_EMPTY;
+    } else {
+        ht->control[slot] = HASH_CONTROL_DELETED;
+        ht->deleted_count += 1;
+    }
+
     ht->pair_count -= 1;
 
-    if (found_index != ht->pair_count) {
-        mem_move(
-            (u8*)ht->keys + ht->key_size * found_index, 
-            (u8*)ht->keys + ht->key_size * (found_index + 1), 
-            (ht->pair_count - found_index) * ht->key_size
-        );
-        mem_move(
-            (u8*)ht->values + ht->value_size * found_index, 
-            (u8*)ht->values + ht->value_size * (found_index + 1), 
-            (ht->pair_count - found_index) * ht->value_size
-        );
+    int last = ht->pair_count;
+    if (found_index != last) {
+        mem_copy((u8*)ht->keys + ht->key_size * found_index, (u8*)ht->keys + ht->key_size * last, ht->key_size);
+        mem_copy((u8*)ht->values + ht->value_size * found_index, (u8*)ht->values + ht->value_size * last, ht->value_size);
+        ht->hashes[found_index]     = ht->hashes[last];
+        ht->pair_slots[found_index] = ht->pair_slots[last];
+        ht->slot_pairs[ht->pair_slots[found_index]] = found_index;
     }
 
-    rebuild_hash_table(ht);
-
     return true;
 }
 
+static u64 hash_bytes_tail(u8* p, usize left, u64 seed, u64 size) {
+    u64 a, b;
+    if (size <= 16) {
+        if (size >= 4) {
+            usize mid = (size >> 3) << 2;
+            a = (hash_read_u32(p) << 32) | hash_read_u32(p + mid);
+            b = (hash_read_u32(p + size - 4) << 32) | hash_read_u32(p + size - 4 - mid);
+        } else if (size > 0) {
+            a = ((u64)p[0] << 16) | ((u64)p[size >> 1] << 8) | p[size - 1];
+            b = 0;
+        } else {
+            a = 0;
+            b = 0;
+        }
+    } else {
+        while (left > 16) {
+            seed = hash_mix(hash_read_u64(p) ^ HASH_SECRET1, hash_read_u64(p + 8) ^ seed);
+            p += 16;
+            left -= 16;
+        }
+
+        // May read back into bytes already mixed which is fine as long as there are 16 of them
+        a = hash_read_u64(p + left - 16);
+        b = hash_read_u64(p + left - 8);
+    }
+
+    a ^= HASH_SECRET1;
+    b ^= seed;
+    hash_multiply(&a, &b);
+    return hash_mix(a ^ HASH_SECRET0 ^ size, b ^ HASH_SECRET1);
+}
+
+inline void hash_bytes_block(u8* p, u64* seed, u64* seed1, u64* seed2) {
+    *seed  = hash_mix(hash_read_u64(p)      ^ HASH_SECRET1, hash_read_u64(p + 8)  ^ *seed);
+    *seed1 = hash_mix(hash_read_u64(p + 16) ^ HASH_SECRET2, hash_read_u64(p + 24) ^ *seed1);
+    *seed2 = hash_mix(hash_read_u64(p + 32) ^ HASH_SECRET3, hash_read_u64(p + 40) ^ *seed2);
+}
+
+u64 _hash_bytes(void* data, usize size, u64 seed) {
+    u8* p = data;
+    seed ^= hash_mix(seed ^ HASH_SECRET0, HASH_SECRET1);
+
+    usize left = size;
+    if (left > 48) {
+        // Three independent lanes so the multiplies can overlap
+        u64 seed1 = seed;
+        u64 seed2 = seed;
+        do {
+            hash_bytes_block(p, &seed, &seed1, &seed2);
+            p += 48;
+            left -= 48;
+        } while (left > 48);
+        seed ^= seed1 ^ seed2;
+    }
+
+    return hash_bytes_tail(p, left, seed, size);
+}
+
+Hash_State begin_hash(void) {
+    Hash_State result = { 0 };
+    result.seed  = hash_mix(HASH_SECRET0, HASH_SECRET1);
+    result.seed1 = result.seed;
+    result.seed2 = result.seed;
+    return result;
+}
+
+void hash_state_bytes(Hash_State* state, void* data, usize size) {
+    u8* p = data;
+    state->size += size;
+
+    while (size) {
+        // Blocks are only mixed once more data shows up after them just like _hash_bytes leaves the last one for the tail
+        if (state->buffered == 48) {
+            hash_bytes_block(state->buffer + 16, &state->seed, &state->seed1, &state->seed2);
+            mem_copy(state->buffer, state->buffer + 48, 16);
+            state->buffered = 0;
+        }
+
+        usize amount = 48 - state->buffered;
+        if (amount > size) amount = size;
+        mem_copy(state->buffer + 16 + state->buffered, p, amount);
+        state->buffered += (int)amount;
+        p += amount;
+        size -= amount;
+    }
+}
+
+u64 end_hash(Hash_State* state) {
+    if (state->size <= 48) return hash_bytes(state->buffer + 16, state->size);
+
+    u64 seed = state->seed ^ state->seed1 ^ state->seed2;
+    return hash_bytes_tail(state->buffer + 16, state->buffered, seed, state->size);
+}
+
 u64 hash_string(void* a, void* b, int size) {
     assert(size == sizeof(String));
 
@@ -186,7 +391,7 @@ u64 hash_string(void* a, void* b, int size) {
 
     if (b) return string_equal(*s_a, *s_b);
 
-    return fnv1_hash(s_a->data, s_a->len);
+    return hash_bytes(s_a->data, s_a->len);
 }
 
 Builder make_builder(Allocator allocator, int reserve) {
@@ -358,8 +563,6 @@ int pop_max_float_heap(Float_Heap* heap) {
     return result;
 }
 
-#define PIXELS_PER_METER 32
-
 typedef struct Game_State {
     Entity_Manager* entity_manager;
 
@@ -367,18 +570,52 @@ typedef struct Game_State {
     int frame_count;
     f32 frame_accum;
 
+    int entities_drawn;
+    int entities_culled;
+
+    f64 submit_duration;
+
+    // The background and cell map only change when the camera or a chunk does so they're drawn once and composited
+    Draw_Layer world_layer;
+    b32 world_layer_redrawn;
+
+    // The overlay only shows new stats a few times a second so the gui can draw its last build again in between
+    f64 overlay_refreshed_at;
+    u64 overlay_refresh_count;
+    int gui_frames;
+    f64 gui_duration_sum;
+    int gui_frames_shown;
+    int gui_builds_shown;
+    f64 gui_average_duration;
+
+    // Searched again whenever either end moves. See update_debug_path
+    Path debug_path;
+    Cell_Ref debug_path_source;
+    Cell_Ref debug_path_dest;
+    b32 has_debug_path;
+
     b32 is_initialized;
 } Game_State;
 
 static Game_State* game_state;
 
+#define OVERLAY_REFRESH_INTERVAL 0.25
+
 DLL_EXPORT void init_game(Platform* platform) {
     g_platform = platform;
 
+    // The old trackers were in the permanent arena which was just reset so they have to be remade before anything allocates
+    platform->permanent_arena.tracker = 0;
+    platform->frame_arena.tracker = 0;
+    clear_allocation_trackers();
+    track_allocator(&platform->frame_arena, platform->permanent_arena, "Frame Arena", false);
+    track_allocator(&platform->permanent_arena, platform->permanent_arena, "Permanent Arena", false);
+
     init_logger(platform);
     init_opengl(platform);
     init_asset_manager(platform);
     init_draw(platform);
+    init_cell_map(platform);
     init_gui(platform);
     init_debug(platform);
 
@@ -391,10 +628,167 @@ DLL_EXPORT void init_game(Platform* platform) {
     }
     game_state->is_initialized = true;
 
-    Controller* controller = make_controller(game_state->entity_manager, v2s((WORLD_SIZE * CHUNK_SIZE) / 2.f), MAX_CAMERA_ORTHO_SIZE);
+    Controller* controller = make_controller(game_state->entity_manager, v2s((WORLD_SIZE * CHUNK_SIZE) / 2.f), START_CAMERA_ORTHO_SIZE);
     set_controller(game_state->entity_manager, controller);
 }
 
+static void draw_background(Rect viewport) {
+    set_shader(get_shader(AH_Basic2d_Shader));
+    draw_right_handed(viewport);
+    set_uniform_texture(SU_Diffuse, *get_texture2d(AH_Background_Texture));
+    imm_begin();
+    imm_textured_rect(viewport, -10.f, v2z(), v2s(1.f), v4s(1.f));
+    imm_flush();
+}
+
+// Everything the world layer shows. Anything that changes what it draws has to be in here or invalidate the layer
+static u64 world_layer_key(Controller* controller) {
+    Hash_State state = begin_hash();
+    hash_state_bytes(&state, &controller->location, sizeof(controller->location));
+    hash_state_bytes(&state, &controller->current_ortho_size, sizeof(controller->current_ortho_size));
+    hash_state_bytes(&state, &controller->mode, sizeof(controller->mode));
+    return end_hash(&state);
+}
+
+// Everything in the world. The gui is drawn after on top
+static void draw_world(Entity_Manager* em, Rect viewport) {
+    Controller* controller = find_entity_by_id(em, em->controller_id);
+    game_state->world_layer_redrawn = false;
+
+    // The software raster can't sample a framebuffer so it gets everything drawn directly
+    if (!controller || is_raster_capturing()) {
+        draw_background(viewport);
+        if (controller) draw_cell_map(em, controller);
+    } else {
+        Draw_Layer* layer = &game_state->world_layer;
+        if (is_cell_map_stale(em, controller)) invalidate_draw_layer(layer);
+
+        f32 scale = g_debug_state->half_res_world_layer ? 0.5f : 1.f;
+        if (begin_draw_layer(layer, world_layer_key(controller), scale)) {
+            draw_background(viewport);
+            draw_cell_map(em, controller);
+            end_draw_layer(layer);
+            game_state->world_layer_redrawn = true;
+        }
+        composite_draw_layer(layer, -10.f);
+
+        set_shader(get_shader(AH_Basic2d_Shader));
+        draw_from(controller->location, controller->current_ortho_size);
+    }
+
+    if (controller) {
+        if (controller->selection.valid) {
+            Rect selection = rect_from_points(controller->selection.start, controller->selection.current);
+            selection.min = v2_floor(selection.min);
+            selection.max = v2_add(v2_floor(selection.max), v2s(1.f));
+            Vector4 selection_color = rgba_from_hex(0x5ecf4466);
+            f32 selection_z = -2.f;
+
+            switch (controller->mode) {
+            case CM_Set_Cell: {
+                imm_begin();
+                imm_rect(selection, selection_z, selection_color);
+                imm_flush();
+            } break;
+            case CM_Set_Wall: {
+                imm_begin();
+                imm_border_rect(selection, selection_z, 1.f, selection_color);
+                imm_flush();
+            } break;
+            }
+        }
+
+        // Culled before anything is queued so off screen entities cost nothing past the broadphase
+        int visible_count;
+        Entity** visible = find_entities_in_rect(em, get_viewport_in_world_space(controller), g_platform->frame_arena, &visible_count);
+        game_state->entities_drawn  = visible_count;
+        game_state->entities_culled = em->entity_count - visible_count;
+
+        if (should_draw_lod(controller)) {
+            // Too small to see any detail so every entity is a flat quad in one command
+            set_shader(get_shader(AH_Basic2d_Shader));
+            draw_from(controller->location, controller->current_ortho_size);
+            imm_begin();
+            for (int i = 0; i < visible_count; ++i) {
+                Entity* entity = visible[i];
+
+                u32 lod_color = 0;
+                switch (entity->type) {
+#define LOD_COLOR_ENTITIES(type, tick, draw, color) \
+                case type: lod_color = color; break;
+                ENTITY_FUNCTIONS(LOD_COLOR_ENTITIES);
+#undef LOD_COLOR_ENTITIES
+                };
+                if (!lod_color) continue;
+
+                imm_rect(move_rect(entity->bounds, entity->location), -3.f, rgba_from_hex((int)lod_color));
+            }
+            imm_flush();
+        } else {
+            for (int i = 0; i < visible_count; ++i) {
+                Entity* entity = visible[i];
+
+                switch (entity->type) {
+#define DRAW_ENTITIES(type, tick, draw, lod_color) \
+                case type: draw(em, entity); break;
+                ENTITY_FUNCTIONS(DRAW_ENTITIES);
+#undef DRAW_ENTITIES
+                };
+            }
+        }
+
+        if (g_debug_state->draw_pathfinding && game_state->has_debug_path) draw_pathfind_debug(em, game_state->debug_path);
+    }
+}
+
+// The pathfinding debug view searches from the cell in the middle of the screen to the one under the mouse
+static void update_debug_path(Entity_Manager* em) {
+    Controller* controller = find_entity_by_id(em, em->controller_id);
+    if (!g_debug_state->draw_pathfinding || !controller) {
+        if (game_state->has_debug_path) free_path(&game_state->debug_path);
+        game_state->has_debug_path = false;
+        return;
+    }
+
+    Cell_Ref source = cell_ref_from_location(controller->location);
+    Cell_Ref dest   = cell_ref_from_location(get_mouse_pos_in_world_space(controller));
+    b32 is_same = cell_ref_equals(source, game_state->debug_path_source) && cell_ref_equals(dest, game_state->debug_path_dest);
+    if (game_state->has_debug_path && is_same) return;
+
+    if (game_state->has_debug_path) free_path(&game_state->debug_path);
+    game_state->debug_path = (Path) { 0 };
+    pathfind(em, source, dest, &game_state->debug_path);
+
+    game_state->debug_path_source = source;
+    game_state->debug_path_dest   = dest;
+    game_state->has_debug_path    = true;
+}
+
+typedef struct Tick_Work {
+    Entity_Manager* em;
+    f32 dt;
+    f64 duration;
+} Tick_Work;
+
+static PLATFORM_WORK_PROC(tick_entities_work) {
+    Tick_Work* work = data;
+    Entity_Manager* em = work->em;
+    f32 dt = work->dt;
+
+    f64 start_time = g_platform->time_in_seconds();
+    for (entity_iterator(em)) {
+        Entity* entity = entity_from_iterator(iter);
+
+        switch (entity->type) {
+#define TICK_ENTITIES(type, tick, draw, lod_color) \
+        case type: tick(em, entity, dt); break;
+        ENTITY_FUNCTIONS(TICK_ENTITIES);
+#undef TICK_ENTITIES
+        };
+    }
+    work->duration = g_platform->time_in_seconds() - start_time;
+}
+
 DLL_EXPORT void tick_game(f32 dt) {
     game_state->frame_accum += dt;
     if (game_state->frame_accum >= 1.f) {
@@ -418,183 +812,89 @@ DLL_EXPORT void tick_game(f32 dt) {
     Entity_Manager* em = game_state->entity_manager;
     Rect viewport = viewport_rect();
 
-    f64 before_tick = g_platform->time_in_seconds();
-    // Tick the game state
-    {
-        for (entity_iterator(em)) {
-            Entity* entity = entity_from_iterator(iter);
-
-            switch (entity->type) {
-#define TICK_ENTITIES(type, tick, draw) \
-            case type: tick(em, entity, dt); break;
-            ENTITY_FUNCTIONS(TICK_ENTITIES);
-#undef TICK_ENTITIES
-            };
-        }
-    }
-    f64 tick_duration = g_platform->time_in_seconds() - before_tick;
-
-    // Draw the game state
-    f64 before_draw = g_platform->time_in_seconds();
-    {
-        glViewport(0, 0, g_platform->window_width, g_platform->window_height);
-        clear_framebuffer(v3s(0.01f));
-
-        draw_state->num_draw_calls = 0;
-        draw_state->vertices_drawn = 0;
-        draw_state->draw_call_duration = 0.0;
-
-        set_shader(find_shader(from_cstr("assets/shaders/basic2d")));
-        draw_right_handed(viewport);
-        set_uniform_texture("diffuse", *find_texture2d(from_cstr("assets/textures/background")));
-        imm_begin();
-        imm_textured_rect(viewport, -10.f, v2z(), v2s(1.f), v4s(1.f));
-        imm_flush();
-
+    // The zoom benchmark holds the camera still so the tick doesn't lerp it anywhere. See benchmark.c
+    f32 benchmark_ortho_size;
+    b32 zoom_benchmarking = get_zoom_benchmark_ortho_size(&benchmark_ortho_size);
+    if (zoom_benchmarking) {
         Controller* controller = find_entity_by_id(em, em->controller_id);
         if (controller) {
-            // Draw the cellmap
-            set_shader(find_shader(from_cstr("assets/shaders/basic2d")));
-            Texture2d* terrain = find_texture2d(from_cstr("assets/sprites/terrain_map"));
-            set_uniform_texture("diffuse", *terrain);
-            draw_from(controller->location, controller->current_ortho_size);
-
-            Rect viewport_in_world_space = get_viewport_in_world_space(controller);
-            
-            // Draw cell in a single batch
-            for (int i = 0; i < WORLD_SIZE * WORLD_SIZE; ++i) {
-                Chunk* chunk = &em->chunks[i];
-
-                int chunk_y = i / WORLD_SIZE;
-                int chunk_x = i - chunk_y * WORLD_SIZE;
-                
-                Vector2 min = v2((f32)chunk_x * CHUNK_SIZE, (f32)chunk_y * CHUNK_SIZE);
-                Vector2 max = v2_add(min, v2(CHUNK_SIZE, CHUNK_SIZE));
-                Rect chunk_rect = { min, max };
-
-                if (!rect_overlaps_rect(viewport_in_world_space, chunk_rect, 0)) continue;
-
-                imm_begin();
-                Vector2 pos = v2((f32)(chunk_x * CHUNK_SIZE), (f32)(chunk_y * CHUNK_SIZE));
-                for (int x = 0; x < CHUNK_SIZE; ++x) {
-                    for (int y = 0; y < CHUNK_SIZE; ++y) {
-                        Cell* cell = &chunk->cells[x + y * CHUNK_SIZE];
-
-                        Vector2 tmin = v2_add(pos, v2((f32)x, (f32)y));
-                        Vector2 tmax = v2_add(tmin, v2s(1.f));
-                        Rect trect = { tmin, tmax };
-                        f32 cell_z = -5.f;
-
-                        // if (rect_overlaps_rect(viewport_in_world_space, trect)) continue;
-
-                        int sprites_per_row = terrain->width / PIXELS_PER_METER;
-                        int sprite_y = cell->floor_type / sprites_per_row;
-                        int sprite_x = cell->floor_type - sprite_y * sprites_per_row;
-
-                        f32 map_width = (f32)terrain->width;
-                        f32 texel_size = 1.f / map_width;
-                        Vector2 uv_offset = v2s(texel_size / 4.f);
-
-                        Vector2 uv0 = v2_add(v2(sprite_x * PIXELS_PER_METER / map_width, sprite_y * PIXELS_PER_METER / map_width), uv_offset);
-                        Vector2 uv1 = v2_sub(v2_add(uv0, v2s(texel_size * PIXELS_PER_METER)), uv_offset);
-
-
-                        switch (controller->mode) {
-                        case CM_Normal: 
-                        case CM_Set_Wall:
-                            if (cell->floor_type != CFT_None) imm_textured_rect(trect, cell_z, uv0, uv1, v4s(1.f));
-                            break;
-                        case CM_Set_Cell:
-                            imm_textured_rect(trect, cell_z, uv0, uv1, v4s(1.f)); 
-                            break;
-                        default: invalid_code_path;
-                        }
-
-                    }
-                }
-                imm_flush();
-            }
-
-            Texture2d* walls = find_texture2d(from_cstr("assets/sprites/walls"));
-            set_uniform_texture("diffuse", *walls);
-            for (int i = 0; i < WORLD_SIZE * WORLD_SIZE; ++i) {
-                Chunk* chunk = &em->chunks[i];
-
-                int chunk_y = i / WORLD_SIZE;
-                int chunk_x = i - chunk_y * WORLD_SIZE;
-                
-                Vector2 min = v2((f32)chunk_x * CHUNK_SIZE, (f32)chunk_y * CHUNK_SIZE);
-                Vector2 max = v2_add(min, v2(CHUNK_SIZE, CHUNK_SIZE));
-                Rect chunk_rect = { min, max };
-
-                if (!rect_overlaps_rect(viewport_in_world_space, chunk_rect, 0)) continue;
+            controller->current_ortho_size = benchmark_ortho_size;
+            controller->target_ortho_size  = benchmark_ortho_size;
+        }
+    }
 
-                imm_begin();
-                Vector2 pos = v2((f32)(chunk_x * CHUNK_SIZE), (f32)(chunk_y * CHUNK_SIZE));
-                for (int x = 0; x < CHUNK_SIZE; ++x) {
-                    for (int y = 0; y < CHUNK_SIZE; ++y) {
-                        Cell* cell = &chunk->cells[x + y * CHUNK_SIZE];
+    // Last frame's commands are submitted while a worker ticks this frame. Until complete_all_work the entities and
+    // cells belong to the tick and the queued commands belong to the submit, so neither side may touch the other's.
+    // The tick also stays out of the frame arena since the submit takes temp memory from it
+    Tick_Work tick_work = { .em = em, .dt = dt };
+    g_platform->add_work(tick_entities_work, &tick_work);
 
-                        Vector2 tmin = v2_add(pos, v2((f32)x, (f32)y));
-                        Vector2 tmax = v2_add(tmin, v2s(1.f));
-                        Rect trect = { tmin, tmax };
-                        f32 wall_z = -4.f;
+    f64 before_submit = g_platform->time_in_seconds();
+    flush_render_commands();
+    next_imm_frame();
+    next_gpu_frame();
+    swap_gl_buffers(g_platform);
+    game_state->submit_duration = g_platform->time_in_seconds() - before_submit;
 
-                        if (cell->content != CC_Wall) continue;
+    g_platform->complete_all_work();
+    f64 tick_duration = tick_work.duration;
 
-                        int sprite_y = 0;
-                        int sprite_x = cell->wall.visual;
+    update_debug_path(em);
 
-                        f32 map_width = (f32)walls->width;
-                        f32 texel_size = 1.f / map_width;
-                        Vector2 uv_offset = v2s(texel_size / 4.f);
+    // After the submit so nothing queued still points at a texture or shader that reloading frees
+#if DEBUG_BUILD
+    if (reload_changed_assets()) invalidate_draw_layer(&game_state->world_layer);
+#endif
 
-                        Vector2 uv0 = v2_add(v2(sprite_x * PIXELS_PER_METER / map_width, sprite_y * PIXELS_PER_METER / map_width), uv_offset);
-                        Vector2 uv1 = v2_sub(v2_add(uv0, v2s(texel_size * PIXELS_PER_METER)), uv_offset);
+    // The software raster benchmark draws the world into its own target first. See benchmark.c
+    if (wants_raster_benchmark_frame()) {
+        begin_raster_benchmark_frame();
+        draw_world(em, viewport);
+        end_raster_benchmark_frame();
+    }
 
-                        imm_textured_rect(trect, wall_z, uv0, uv1, v4s(1.f)); 
-                    }
-                }
-                imm_flush();
-            }
+    // A cached world layer would hide what the zoom costs
+    if (zoom_benchmarking) invalidate_draw_layer(&game_state->world_layer);
 
-            if (controller->selection.valid) {
-                Rect selection = rect_from_points(controller->selection.start, controller->selection.current);
-                selection.min = v2_floor(selection.min);
-                selection.max = v2_add(v2_floor(selection.max), v2s(1.f));
-                Vector4 selection_color = rgba_from_hex(0x5ecf4466);
-                f32 selection_z = -2.f;
-
-                switch (controller->mode) {
-                case CM_Set_Cell: {
-                    imm_begin();
-                    imm_rect(selection, selection_z, selection_color);
-                    imm_flush();
-                } break;
-                case CM_Set_Wall: {
-                    imm_begin();
-                    imm_border_rect(selection, selection_z, 1.f, selection_color);
-                    imm_flush();
-                } break;
-                }
-            }
+    // Draw the game state
+    f64 before_draw = g_platform->time_in_seconds();
+    {
+        glViewport(0, 0, g_platform->window_width, g_platform->window_height);
+        gpu_scope("Clear") clear_framebuffer(v3s(0.01f));
 
-            for (entity_iterator(em)) {
-                Entity* entity = entity_from_iterator(iter);
+        draw_state->last_stats = draw_state->stats;
+        draw_state->stats = (Draw_Stats) { 0 };
 
-                switch (entity->type) {
-#define DRAW_ENTITIES(type, tick, draw) \
-                case type: draw(em, entity); break;
-                ENTITY_FUNCTIONS(DRAW_ENTITIES);
-#undef DRAW_ENTITIES
-                };
-            }
-        }
+        draw_world(em, viewport);
     }
     f64 draw_duration = g_platform->time_in_seconds() - before_draw;
+    if (zoom_benchmarking) end_zoom_benchmark_frame(tick_duration, draw_duration, cell_map_renderer->drew_impostors);
+
+    game_state->gui_frames += 1;
+    game_state->gui_duration_sum += gui_state->last_duration;
+    if (g_platform->current_frame_time - game_state->overlay_refreshed_at >= OVERLAY_REFRESH_INTERVAL) {
+        game_state->overlay_refreshed_at   = g_platform->current_frame_time;
+        game_state->overlay_refresh_count += 1;
+
+        game_state->gui_frames_shown     = game_state->gui_frames;
+        game_state->gui_builds_shown     = gui_state->built_frames;
+        game_state->gui_average_duration = game_state->gui_duration_sum / (f64)game_state->gui_frames;
+        game_state->gui_frames       = 0;
+        game_state->gui_duration_sum = 0.0;
+        gui_state->built_frames      = 0;
+    }
+
+    // Everything the overlay shows is read when it's built so only a refresh or a debug option changes it
+    Hash_State overlay_inputs = begin_hash();
+    hash_state_bytes(&overlay_inputs, &game_state->overlay_refresh_count, sizeof(game_state->overlay_refresh_count));
+    hash_state_bytes(&overlay_inputs, g_debug_state, sizeof(Debug_State));
 
-    do_gui(dt) {
-        gui_row_layout_rect(viewport, true) {
+    do_cached_gui(dt, end_hash(&overlay_inputs)) {
+        f32 hotbar_height = 50.f;
+
+        // Stats and debug ui that run past the bottom are cut off above the hotbar instead of drawing over it
+        Rect overlay_clip = rect_from_raw(0.f, hotbar_height, rect_width(viewport), rect_height(viewport));
+        gui_clip_rect(overlay_clip) gui_row_layout_rect(viewport, true) {
             gui_label_printf("FPS: %i", game_state->fps);
 
             gui_label_printf(" ");
@@ -602,11 +902,50 @@ DLL_EXPORT void tick_game(f32 dt) {
             f64 precise_dt = g_platform->current_frame_time - g_platform->last_frame_time;
             gui_label_printf("Frame Time: %.3fms", precise_dt * 1000.0);
             gui_label_printf("    Tick Time: %.3fms", tick_duration * 1000.0);
+            gui_label_printf("    Submit Time: %.3fms (overlaps the tick)", game_state->submit_duration * 1000.0);
             gui_label_printf("    Draw Time: %.3fms", draw_duration * 1000.0);
-            gui_label_printf("        Draw Calls: %i", draw_state->num_draw_calls);
-            gui_label_printf("        Vertices Drawn: %i", draw_state->vertices_drawn);
-            gui_label_printf("        GPU Time: %.3fms", draw_state->draw_call_duration * 1000.0);
-            gui_label_printf("    GUI Time: %.3fms", gui_state->last_duration * 1000.0);
+            gui_label_printf("        Draw Calls: %i (%i before merging)", draw_state->last_stats.num_draw_calls, draw_state->last_stats.num_draw_commands);
+            gui_label_printf("        Vertices Drawn: %i (%lluKB)", draw_state->last_stats.vertices_drawn, draw_state->last_stats.vertex_bytes / 1024);
+            if (!game_state->world_layer_redrawn) {
+                gui_label_printf("        Chunks Drawn: cached in the world layer");
+            } else if (cell_map_renderer->drew_impostors) {
+                gui_label_printf("        Chunks Drawn: %i impostors (%i rebuilt, %i redrawn)", cell_map_renderer->chunks_drawn, cell_map_renderer->chunks_rebuilt, cell_map_renderer->impostors_redrawn);
+            } else {
+                gui_label_printf("        Chunks Drawn: %i (%i rebuilt)", cell_map_renderer->chunks_drawn, cell_map_renderer->chunks_rebuilt);
+            }
+            gui_label_printf("        Entities Drawn: %i (%i culled)", game_state->entities_drawn, game_state->entities_culled);
+
+            // Compositing costs one full screen quad per layer either way. What's saved is everything drawn into it
+            Framebuffer* world_framebuffer = &game_state->world_layer.framebuffer;
+            usize layer_pixels = draw_state->last_stats.layer_pixels_composited;
+            f32 layer_fill = layer_pixels ? (f32)draw_state->last_stats.layer_pixels_drawn / (f32)layer_pixels : 0.f;
+            gui_label_printf("        World Layer: %ix%i, %s, %.1f%% of full resolution fill", world_framebuffer->width, world_framebuffer->height, game_state->world_layer_redrawn ? "redrawn" : "cached", layer_fill * 100.f);
+
+            int cached_glyphs;
+            f32 glyph_occupancy, glyph_shelf_usage;
+            get_glyph_cache_stats(&cached_glyphs, &glyph_occupancy, &glyph_shelf_usage);
+            gui_label_printf("        Glyph Cache: %i glyphs in %.1f%% of the atlas (%.1f%% shelved)", cached_glyphs, glyph_occupancy * 100.f, glyph_shelf_usage * 100.f);
+            gui_label_printf("            Rasterized: %i (%.3fms), %i shelves evicted", draw_state->last_stats.glyphs_rasterized, draw_state->last_stats.glyph_raster_duration * 1000.0, draw_state->last_stats.glyphs_evicted);
+            int text_layouts = draw_state->last_stats.text_layout_hits + draw_state->last_stats.text_layout_misses;
+            f32 text_hit_rate = text_layouts ? (f32)draw_state->last_stats.text_layout_hits / (f32)text_layouts : 1.f;
+            gui_label_printf("        Text Layouts: %i hits, %i laid out (%.1f%% hit)", draw_state->last_stats.text_layout_hits, draw_state->last_stats.text_layout_misses, text_hit_rate * 100.f);
+            gui_label_printf("        Draw Call Time: %.3fms (cpu)", draw_state->last_stats.draw_call_duration * 1000.0);
+
+            int gpu_scope_count;
+            f64 gpu_duration;
+            int gpu_scopes_dropped;
+            GPU_Scope_Time* gpu_times = get_gpu_scope_times(&gpu_scope_count, &gpu_duration, &gpu_scopes_dropped);
+            if (gpu_scopes_dropped > 0) {
+                gui_label_printf("        GPU Time: %.3fms (%i scopes dropped, so it's low)", gpu_duration * 1000.0, gpu_scopes_dropped);
+            } else {
+                gui_label_printf("        GPU Time: %.3fms", gpu_duration * 1000.0);
+            }
+            for (int i = 0; i < gpu_scope_count; ++i) {
+                GPU_Scope_Time* time = &gpu_times[i];
+                gui_label_printf("            %*s%s: %.3fms", time->depth * 4, "", time->name, time->duration * 1000.0);
+            }
+            gui_label_printf("        Ring Wait: %.3fms", draw_state->last_stats.ring_wait_duration * 1000.0);
+            gui_label_printf("    GUI Time: %.3fms avg, built %i of %i frames", game_state->gui_average_duration * 1000.0, game_state->gui_builds_shown, game_state->gui_frames_shown);
 
             gui_label_printf(" ");
 
@@ -625,13 +964,13 @@ DLL_EXPORT void tick_game(f32 dt) {
             gui_label_printf(" ");
 
             do_debug_ui();
-
-            Rect hotbar_panel = rect_from_raw(0.f, 0.f, rect_width(viewport), 50.f);
-            gui_panel_rect(hotbar_panel);
         }
+
+        Rect hotbar_panel = rect_from_raw(0.f, 0.f, rect_width(viewport), hotbar_height);
+        gui_panel_rect(hotbar_panel);
     }
 
-    swap_gl_buffers(g_platform);
+    // Submitted and presented at the top of the next tick while that frame's entities tick
 }
 
 DLL_EXPORT void shutdown_game(void) {
@@ -4,6 +4,7 @@ Pawn* make_pawn(Entity_Manager* em, Vector2 location) {
     Pawn* result = make_entity(em, Pawn);
     result->bounds   = (Rect) { v2(-0.5f, 0.f), v2(0.5f, 2.f) };
     result->location = location;
+    refresh_entity_chunk(em, &result->base);
     return result;
 }
 
@@ -16,7 +17,7 @@ static void tick_pawn(Entity_Manager* em, Entity* entity, f32 dt) {
 static void draw_pawn(Entity_Manager* em, Entity* entity) {
     Pawn* pawn = entity->derived;
 
-    set_shader(find_shader(from_cstr("assets/shaders/basic2d")));
+    set_shader(get_shader(AH_Basic2d_Shader));
     Rect draw_rect = move_rect(entity->bounds, entity->location);
 
     imm_begin();
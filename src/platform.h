@@ -82,6 +82,17 @@ typedef PLATFORM_CYCLES(Platform_Cycles);
 #define PLATFORM_TIME_IN_SECONDS(name) f64 name(void)
 typedef PLATFORM_TIME_IN_SECONDS(Platform_Time_In_Seconds);
 
+#define PLATFORM_WORK_PROC(name) void name(void* data)
+typedef PLATFORM_WORK_PROC(Platform_Work_Proc);
+
+// Work is picked up by the worker threads in the order it's added. Only the main thread may add work
+#define PLATFORM_ADD_WORK(name) void name(Platform_Work_Proc* proc, void* data)
+typedef PLATFORM_ADD_WORK(Platform_Add_Work);
+
+// The calling thread helps with the queue until everything added so far is done
+#define PLATFORM_COMPLETE_ALL_WORK(name) void name(void)
+typedef PLATFORM_COMPLETE_ALL_WORK(Platform_Complete_All_Work);
+
 typedef enum OS_Event_Type {
     OET_Window_Resized = 0,
     OET_Window_Closed,
@@ -123,6 +134,10 @@ typedef struct Platform {
     Platform_Cycles*            cycles;
     Platform_Time_In_Seconds*   time_in_seconds;
 
+    Platform_Add_Work*          add_work;
+    Platform_Complete_All_Work* complete_all_work;
+    int worker_count; // Not counting the main thread
+
     void* window_handle;
     int window_width;
     int window_height;
@@ -249,6 +249,90 @@ static PLATFORM_TIME_IN_SECONDS(win32_time_in_seconds) {
     return (f64)time.QuadPart / (f64)g_qpc_freq.QuadPart;
 }
 
+typedef struct Work_Entry {
+    Platform_Work_Proc* proc;
+    void* data;
+} Work_Entry;
+
+// Single producer, multiple consumer ring. Only the main thread writes so next_to_write needs no interlock
+#define WORK_QUEUE_CAP 256
+#define WORKER_CAP 16
+typedef struct Work_Queue {
+    Work_Entry entries[WORK_QUEUE_CAP];
+    volatile LONG next_to_write;
+    volatile LONG next_to_read;
+
+    volatile LONG completion_goal;
+    volatile LONG completion_count;
+
+    HANDLE semaphore;
+} Work_Queue;
+
+static Work_Queue g_work_queue;
+
+// Returns false if there was nothing to do
+static b32 do_next_work(Work_Queue* queue) {
+    LONG original = queue->next_to_read;
+    if (original == queue->next_to_write) return false;
+
+    LONG next = (original + 1) % WORK_QUEUE_CAP;
+    if (InterlockedCompareExchange(&queue->next_to_read, next, original) == original) {
+        Work_Entry entry = queue->entries[original];
+        entry.proc(entry.data);
+        InterlockedIncrement(&queue->completion_count);
+    }
+    return true;
+}
+
+static DWORD WINAPI worker_thread_proc(LPVOID param) {
+    Work_Queue* queue = param;
+    for (;;) {
+        if (!do_next_work(queue)) WaitForSingleObjectEx(queue->semaphore, INFINITE, FALSE);
+    }
+}
+
+static PLATFORM_ADD_WORK(win32_add_work) {
+    Work_Queue* queue = &g_work_queue;
+
+    // If the ring is full help drain it instead of overwriting work that hasn't started
+    LONG next = (queue->next_to_write + 1) % WORK_QUEUE_CAP;
+    while (next == queue->next_to_read) do_next_work(queue);
+
+    queue->entries[queue->next_to_write] = (Work_Entry) { proc, data };
+    queue->completion_goal += 1;
+
+    // The entry has to be visible before the workers can see the new write index
+    InterlockedExchange(&queue->next_to_write, next);
+    ReleaseSemaphore(queue->semaphore, 1, 0);
+}
+
+static PLATFORM_COMPLETE_ALL_WORK(win32_complete_all_work) {
+    Work_Queue* queue = &g_work_queue;
+    while (queue->completion_count != queue->completion_goal) {
+        if (!do_next_work(queue)) YieldProcessor();
+    }
+
+    queue->completion_goal  = 0;
+    queue->completion_count = 0;
+}
+
+static int init_work_queue(void) {
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+
+    int worker_count = (int)system_info.dwNumberOfProcessors - 1;
+    if (worker_count > WORKER_CAP) worker_count = WORKER_CAP;
+    if (worker_count < 0) worker_count = 0;
+
+    g_work_queue.semaphore = CreateSemaphoreA(0, 0, WORK_QUEUE_CAP, 0);
+    for (int i = 0; i < worker_count; ++i) {
+        HANDLE thread = CreateThread(0, 0, worker_thread_proc, &g_work_queue, 0, 0);
+        CloseHandle(thread);
+    }
+
+    return worker_count;
+}
+
 #define push_os_event(t, ...) g_platform->events[g_platform->num_events++] = (OS_Event) { .type = t, __VA_ARGS__ }
 
 static LRESULT the_window_proc(HWND hWnd, UINT Msg, WPARAM wParam, LPARAM lParam) {
@@ -384,8 +468,11 @@ int main(int argv, char** argc) {
         .local_time         = win32_local_time,
         .cycles             = win32_cycles,
         .time_in_seconds    = win32_time_in_seconds,
+        .add_work           = win32_add_work,
+        .complete_all_work  = win32_complete_all_work,
         .dpi_scale          = 1.f,
     };
+    the_platform.worker_count = init_work_queue();
 
     // DPI Scaling
     {
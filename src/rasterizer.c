@@ -0,0 +1,680 @@
+#include "rasterizer.h"
+
+#include <emmintrin.h>
+
+// Gl blends in linear and encodes to sRGB on write because GL_FRAMEBUFFER_SRGB is on. These tables do the same
+static f32 srgb_to_linear_table[256];
+static u8 linear_to_srgb_table[4096];
+static b32 are_srgb_tables_initialized = false;
+
+static void init_srgb_tables(void) {
+    if (are_srgb_tables_initialized) return;
+    are_srgb_tables_initialized = true;
+
+    for (int i = 0; i < 256; ++i) {
+        f32 c = (f32)i / 255.f;
+        srgb_to_linear_table[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    for (int i = 0; i < array_count(linear_to_srgb_table); ++i) {
+        f32 c = (f32)i / 4095.f;
+        f32 s = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.f / 2.4f) - 0.055f;
+        linear_to_srgb_table[i] = (u8)(s * 255.f + 0.5f);
+    }
+}
+
+static u8 linear_to_srgb(f32 c) {
+    if (c <= 0.f) return 0;
+    if (c >= 1.f) return 255;
+    return linear_to_srgb_table[(int)(c * 4095.f + 0.5f)];
+}
+
+static u8 unorm_to_u8(f32 c) {
+    if (c <= 0.f) return 0;
+    if (c >= 1.f) return 255;
+    return (u8)(c * 255.f + 0.5f);
+}
+
+static u32 pack_rgba8(u8 r, u8 g, u8 b, u8 a) {
+    return (u32)r | ((u32)g << 8) | ((u32)b << 16) | ((u32)a << 24);
+}
+
+Raster_Target make_raster_target(int width, int height, Allocator allocator) {
+    assert(width > 0 && height > 0);
+    init_srgb_tables();
+
+    Raster_Target result = {
+        .width     = width,
+        .height    = height,
+        .allocator = allocator,
+    };
+    result.tiles_x = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    result.tiles_y = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    result.stride  = result.tiles_x * RASTER_TILE_SIZE;
+
+    int pixel_count = result.stride * result.tiles_y * RASTER_TILE_SIZE;
+    result.color = mem_alloc_aligned(allocator, sizeof(u32) * pixel_count, 16);
+    result.depth = mem_alloc_aligned(allocator, sizeof(f32) * pixel_count, 16);
+
+    int bin_count = result.tiles_x * result.tiles_y;
+    result.bins = mem_alloc_array(allocator, Raster_Bin, bin_count);
+    for (int i = 0; i < bin_count; ++i) {
+        result.bins[i] = (Raster_Bin) {
+            .x = i % result.tiles_x,
+            .y = i / result.tiles_x,
+        };
+    }
+
+    result.textures = make_pod_hash_table(u32, Raster_Texture*, allocator);
+
+    result.clear_pending = true;
+    result.clear_color   = pack_rgba8(0, 0, 0, 255);
+
+    return result;
+}
+
+void free_raster_target(Raster_Target* target) {
+    Allocator allocator = target->allocator;
+
+    for (int i = 0; i < target->textures.pair_count; ++i) {
+        Raster_Texture* texture = ((Raster_Texture**)target->textures.values)[i];
+        mem_free(allocator, texture->pixels);
+        mem_free(allocator, texture);
+    }
+    free_hash_table(&target->textures);
+
+    int bin_count = target->tiles_x * target->tiles_y;
+    for (int i = 0; i < bin_count; ++i) {
+        if (target->bins[i].triangles) mem_free(allocator, target->bins[i].triangles);
+    }
+    mem_free(allocator, target->bins);
+    if (target->triangles) mem_free(allocator, target->triangles);
+
+    mem_free(allocator, target->color);
+    mem_free(allocator, target->depth);
+    *target = (Raster_Target) { 0 };
+}
+
+void clear_raster_target(Raster_Target* target, Vector3 color) {
+    // Anything binned before this would be cleared over anyways
+    target->triangle_count = 0;
+    int bin_count = target->tiles_x * target->tiles_y;
+    for (int i = 0; i < bin_count; ++i) target->bins[i].count = 0;
+
+    target->clear_pending = true;
+    target->clear_color   = pack_rgba8(linear_to_srgb(color.r), linear_to_srgb(color.g), linear_to_srgb(color.b), 255);
+}
+
+void set_raster_scissor(Raster_Target* target, int x, int y, int width, int height) {
+    target->has_scissor   = true;
+    target->scissor_min_x = x;
+    target->scissor_min_y = y;
+    target->scissor_max_x = x + width - 1;
+    target->scissor_max_y = y + height - 1;
+}
+
+void clear_raster_scissor(Raster_Target* target) { target->has_scissor = false; }
+
+static f32 min3(f32 a, f32 b, f32 c) { return a < b ? (a < c ? a : c) : (b < c ? b : c); }
+static f32 max3(f32 a, f32 b, f32 c) { return a > b ? (a > c ? a : c) : (b > c ? b : c); }
+
+static void bin_raster_triangle(Raster_Target* target, int index) {
+    Raster_Triangle* triangle = &target->triangles[index];
+
+    int tile_x0 = triangle->min_x / RASTER_TILE_SIZE;
+    int tile_y0 = triangle->min_y / RASTER_TILE_SIZE;
+    int tile_x1 = triangle->max_x / RASTER_TILE_SIZE;
+    int tile_y1 = triangle->max_y / RASTER_TILE_SIZE;
+
+    for (int tile_y = tile_y0; tile_y <= tile_y1; ++tile_y) {
+        for (int tile_x = tile_x0; tile_x <= tile_x1; ++tile_x) {
+            // Skip tiles the bounds overlap but an edge doesn't. Each edge is checked at the tile's most inside corner
+            f32 x0 = (f32)(tile_x * RASTER_TILE_SIZE) + 0.5f;
+            f32 y0 = (f32)(tile_y * RASTER_TILE_SIZE) + 0.5f;
+            f32 x1 = x0 + (f32)(RASTER_TILE_SIZE - 1);
+            f32 y1 = y0 + (f32)(RASTER_TILE_SIZE - 1);
+
+            b32 is_outside = false;
+            for (int k = 0; k < 3; ++k) {
+                f32 x = triangle->edge_a[k] > 0.f ? x1 : x0;
+                f32 y = triangle->edge_b[k] > 0.f ? y1 : y0;
+                if (triangle->edge_a[k] * x + triangle->edge_b[k] * y + triangle->edge_c[k] < 0.f) is_outside = true;
+            }
+            if (is_outside) continue;
+
+            Raster_Bin* bin = &target->bins[tile_x + tile_y * target->tiles_x];
+            if (bin->count == bin->cap) {
+                bin->cap = bin->cap ? bin->cap * 2 : 256;
+                bin->triangles = mem_realloc(target->allocator, bin->triangles, sizeof(int) * bin->cap);
+            }
+            bin->triangles[bin->count++] = index;
+        }
+    }
+}
+
+void raster_triangles(Raster_Target* target, Matrix4 mvp, Raster_Shading shading, Raster_Texture* texture, Raster_Vertex* vertices, int count) {
+    assert(count % 3 == 0);
+    f32* m = mvp.e;
+
+    f32 width  = (f32)target->width;
+    f32 height = (f32)target->height;
+
+    for (int i = 0; i + 2 < count; i += 3) {
+        f32 x[3], y[3];
+        f32 attributes[3][RA_Count];
+
+        b32 is_visible = true;
+        for (int j = 0; j < 3; ++j) {
+            Raster_Vertex* v = &vertices[i + j];
+            Vector3 p = v->position;
+
+            f32 clip_x = m[0] * p.x + m[4] * p.y + m[8]  * p.z + m[12];
+            f32 clip_y = m[1] * p.x + m[5] * p.y + m[9]  * p.z + m[13];
+            f32 clip_z = m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14];
+            f32 clip_w = m[3] * p.x + m[7] * p.y + m[11] * p.z + m[15];
+
+            // No clipping. Views are orthographic so w is 1 and depth outside the range is dropped per pixel
+            if (clip_w <= 0.f) {
+                is_visible = false;
+                break;
+            }
+            f32 inv_w = 1.f / clip_w;
+
+            x[j] = (clip_x * inv_w * 0.5f + 0.5f) * width;
+            y[j] = (clip_y * inv_w * 0.5f + 0.5f) * height;
+
+            attributes[j][RA_Z] = clip_z * inv_w * 0.5f + 0.5f;
+            attributes[j][RA_U] = v->uv.x;
+            attributes[j][RA_V] = v->uv.y;
+            attributes[j][RA_R] = v->color.r;
+            attributes[j][RA_G] = v->color.g;
+            attributes[j][RA_B] = v->color.b;
+            attributes[j][RA_A] = v->color.a;
+        }
+        if (!is_visible) continue;
+
+        // Back faces are culled like gl with counter clockwise fronts
+        f32 area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (area <= 0.f) continue;
+
+        // Pixels whose centers are inside the bounds
+        int min_x = (int)ceilf(min3(x[0], x[1], x[2]) - 0.5f);
+        int min_y = (int)ceilf(min3(y[0], y[1], y[2]) - 0.5f);
+        int max_x = (int)floorf(max3(x[0], x[1], x[2]) - 0.5f);
+        int max_y = (int)floorf(max3(y[0], y[1], y[2]) - 0.5f);
+        if (min_x < 0) min_x = 0;
+        if (min_y < 0) min_y = 0;
+        if (max_x > target->width - 1)  max_x = target->width - 1;
+        if (max_y > target->height - 1) max_y = target->height - 1;
+        if (target->has_scissor) {
+            if (min_x < target->scissor_min_x) min_x = target->scissor_min_x;
+            if (min_y < target->scissor_min_y) min_y = target->scissor_min_y;
+            if (max_x > target->scissor_max_x) max_x = target->scissor_max_x;
+            if (max_y > target->scissor_max_y) max_y = target->scissor_max_y;
+        }
+        if (min_x > max_x || min_y > max_y) continue;
+
+        if (target->triangle_count == target->triangle_cap) {
+            target->triangle_cap = target->triangle_cap ? target->triangle_cap * 2 : 4096;
+            target->triangles = mem_realloc(target->allocator, target->triangles, sizeof(Raster_Triangle) * target->triangle_cap);
+        }
+        int index = target->triangle_count++;
+        Raster_Triangle* triangle = &target->triangles[index];
+        *triangle = (Raster_Triangle) {
+            .min_x   = min_x,
+            .min_y   = min_y,
+            .max_x   = max_x,
+            .max_y   = max_y,
+            .shading = shading,
+            .texture = texture,
+        };
+
+        // Edge k is opposite vertex k so it's also vertex k's barycentric weight times the area
+        for (int k = 0; k < 3; ++k) {
+            int from = (k + 1) % 3;
+            int to   = (k + 2) % 3;
+            f32 dx = x[to] - x[from];
+            f32 dy = y[to] - y[from];
+
+            // A shared edge is set up from the same end in both triangles so one is exactly the negative of the
+            // other. Otherwise rounding can put a pixel center on the edge outside of both and leave a hole
+            b32 is_flipped = x[to] < x[from] || (x[to] == x[from] && y[to] < y[from]);
+            int start = is_flipped ? to : from;
+            f32 sign  = is_flipped ? -1.f : 1.f;
+            f32 start_dx = dx * sign;
+            f32 start_dy = dy * sign;
+
+            triangle->edge_a[k] = -start_dy * sign;
+            triangle->edge_b[k] = start_dx * sign;
+            triangle->edge_c[k] = (start_dy * x[start] - start_dx * y[start]) * sign;
+
+            // With y up and counter clockwise winding left edges go down and top edges go left
+            triangle->is_top_left[k] = dy < 0.f || (dy == 0.f && dx < 0.f);
+        }
+
+        f32 inv_area = 1.f / area;
+        for (int a = 0; a < RA_Count; ++a) {
+            // Flat attributes are kept exact. A uv of -1 that came out as -0.9999 would sample a texture
+            if (attributes[0][a] == attributes[1][a] && attributes[0][a] == attributes[2][a]) {
+                triangle->plane_dx[a] = 0.f;
+                triangle->plane_dy[a] = 0.f;
+                triangle->plane_c[a]  = attributes[0][a];
+                continue;
+            }
+
+            f32 dx = 0.f, dy = 0.f, c = 0.f;
+            for (int k = 0; k < 3; ++k) {
+                dx += triangle->edge_a[k] * attributes[k][a];
+                dy += triangle->edge_b[k] * attributes[k][a];
+                c  += triangle->edge_c[k] * attributes[k][a];
+            }
+            triangle->plane_dx[a] = dx * inv_area;
+            triangle->plane_dy[a] = dy * inv_area;
+            triangle->plane_c[a]  = c * inv_area;
+        }
+
+        if (shading == RS_Distance && texture) {
+            f32 tex_w = (f32)texture->width;
+            f32 tex_h = (f32)texture->height;
+            f32 du_dx = triangle->plane_dx[RA_U] * tex_w;
+            f32 dv_dx = triangle->plane_dx[RA_V] * tex_h;
+            f32 du_dy = triangle->plane_dy[RA_U] * tex_w;
+            f32 dv_dy = triangle->plane_dy[RA_V] * tex_h;
+            f32 texels_x = sqrtf(du_dx * du_dx + dv_dx * dv_dx);
+            f32 texels_y = sqrtf(du_dy * du_dy + dv_dy * dv_dy);
+            triangle->edge_width = 0.5f * texture->distance_per_texel * (texels_x + texels_y);
+        }
+
+        bin_raster_triangle(target, index);
+    }
+}
+
+// Nearest with repeat wrapping like the textures gl is given. Returns linear rgba
+static void sample_raster_texture(Raster_Texture* texture, f32 u, f32 v, f32* rgba) {
+    if (!texture) {
+        // An unbound sampler reads as opaque black
+        rgba[0] = 0.f;
+        rgba[1] = 0.f;
+        rgba[2] = 0.f;
+        rgba[3] = 1.f;
+        return;
+    }
+
+    int x = (int)floorf(u * (f32)texture->width) % texture->width;
+    int y = (int)floorf(v * (f32)texture->height) % texture->height;
+    if (x < 0) x += texture->width;
+    if (y < 0) y += texture->height;
+
+    u32 texel = texture->pixels[x + y * texture->width];
+    u8 r = (u8)(texel & 0xFF);
+    u8 g = (u8)((texel >> 8) & 0xFF);
+    u8 b = (u8)((texel >> 16) & 0xFF);
+    u8 a = (u8)(texel >> 24);
+
+    if (texture->is_srgb) {
+        rgba[0] = srgb_to_linear_table[r];
+        rgba[1] = srgb_to_linear_table[g];
+        rgba[2] = srgb_to_linear_table[b];
+    } else {
+        rgba[0] = (f32)r / 255.f;
+        rgba[1] = (f32)g / 255.f;
+        rgba[2] = (f32)b / 255.f;
+    }
+    rgba[3] = (f32)a / 255.f;
+}
+
+// Bilinear like the distance atlas is sampled in gl then faded over the triangle's edge width like the sdf_font shader
+static f32 sample_raster_distance(Raster_Texture* texture, f32 u, f32 v, f32 edge_width) {
+    if (!texture) return 0.f;
+
+    f32 fx = u * (f32)texture->width - 0.5f;
+    f32 fy = v * (f32)texture->height - 0.5f;
+    int x0 = (int)floorf(fx);
+    int y0 = (int)floorf(fy);
+    f32 tx = fx - (f32)x0;
+    f32 ty = fy - (f32)y0;
+
+    f32 texels[2][2];
+    for (int j = 0; j < 2; ++j) {
+        for (int i = 0; i < 2; ++i) {
+            int x = (x0 + i) % texture->width;
+            int y = (y0 + j) % texture->height;
+            if (x < 0) x += texture->width;
+            if (y < 0) y += texture->height;
+            texels[j][i] = (f32)(texture->pixels[x + y * texture->width] & 0xFF) / 255.f;
+        }
+    }
+    f32 bottom   = texels[0][0] + (texels[0][1] - texels[0][0]) * tx;
+    f32 top      = texels[1][0] + (texels[1][1] - texels[1][0]) * tx;
+    f32 distance = bottom + (top - bottom) * ty;
+
+    if (edge_width <= 0.f) return distance >= 0.5f ? 1.f : 0.f;
+    f32 t = CLAMP((distance - (0.5f - edge_width)) / (2.f * edge_width), 0.f, 1.f);
+    return t * t * (3.f - 2.f * t);
+}
+
+static __m128 select_ps(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static __m128 edge_inside(__m128 e, b32 is_top_left) {
+    __m128 zero = _mm_setzero_ps();
+    return is_top_left ? _mm_cmpge_ps(e, zero) : _mm_cmpgt_ps(e, zero);
+}
+
+// Walks the triangle's rows inside the rect 4 pixels at a time. x0 must be a multiple of 4
+static void raster_spans(Raster_Target* target, Raster_Triangle* triangle, int x0, int y0, int x1, int y1) {
+    __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 one  = _mm_set1_ps(1.f);
+    __m128 no_texture_u = _mm_set1_ps(-1.f);
+
+    __m128 edge_a[3];
+    for (int k = 0; k < 3; ++k) edge_a[k] = _mm_set1_ps(triangle->edge_a[k]);
+
+    __m128 plane_dx[RA_Count];
+    for (int a = 0; a < RA_Count; ++a) plane_dx[a] = _mm_set1_ps(triangle->plane_dx[a]);
+
+    for (int y = y0; y <= y1; ++y) {
+        f32 py = (f32)y + 0.5f;
+
+        __m128 edge_row[3];
+        for (int k = 0; k < 3; ++k) edge_row[k] = _mm_set1_ps(triangle->edge_b[k] * py + triangle->edge_c[k]);
+
+        u32* color_row = target->color + y * target->stride;
+        f32* depth_row = target->depth + y * target->stride;
+
+        for (int x = x0; x <= x1; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((f32)x), lane_offsets);
+
+            __m128 mask = edge_inside(_mm_add_ps(_mm_mul_ps(edge_a[0], px), edge_row[0]), triangle->is_top_left[0]);
+            mask = _mm_and_ps(mask, edge_inside(_mm_add_ps(_mm_mul_ps(edge_a[1], px), edge_row[1]), triangle->is_top_left[1]));
+            mask = _mm_and_ps(mask, edge_inside(_mm_add_ps(_mm_mul_ps(edge_a[2], px), edge_row[2]), triangle->is_top_left[2]));
+            if (!_mm_movemask_ps(mask)) continue;
+
+            __m128 attributes[RA_Count];
+            for (int a = 0; a < RA_Count; ++a) {
+                attributes[a] = _mm_add_ps(_mm_mul_ps(plane_dx[a], px), _mm_set1_ps(triangle->plane_dy[a] * py + triangle->plane_c[a]));
+            }
+
+            // Depth test is LEQUAL against a cleared depth of 1. Anything outside the depth range is clipped
+            __m128 z = attributes[RA_Z];
+            __m128 old_depth = _mm_loadu_ps(depth_row + x);
+            mask = _mm_and_ps(mask, _mm_cmpge_ps(z, zero));
+            mask = _mm_and_ps(mask, _mm_cmple_ps(z, one));
+            mask = _mm_and_ps(mask, _mm_cmple_ps(z, old_depth));
+            int lanes = _mm_movemask_ps(mask);
+            if (!lanes) continue;
+
+            __m128 r = attributes[RA_R];
+            __m128 g = attributes[RA_G];
+            __m128 b = attributes[RA_B];
+            __m128 a = attributes[RA_A];
+
+            __m128 is_textured = _mm_and_ps(mask, _mm_cmpgt_ps(attributes[RA_U], no_texture_u));
+            if (_mm_movemask_ps(is_textured)) {
+                // Texture fetches are a gather so they're done a lane at a time
+                f32 u[4], v[4];
+                _mm_storeu_ps(u, attributes[RA_U]);
+                _mm_storeu_ps(v, attributes[RA_V]);
+
+                f32 texels[4][4] = { 0 };
+                for (int lane = 0; lane < 4; ++lane) {
+                    if (!(lanes & (1 << lane))) continue;
+                    if (triangle->shading == RS_Distance) {
+                        texels[lane][0] = sample_raster_distance(triangle->texture, u[lane], v[lane], triangle->edge_width);
+                    } else {
+                        sample_raster_texture(triangle->texture, u[lane], v[lane], texels[lane]);
+                    }
+                }
+                __m128 texel_r = _mm_setr_ps(texels[0][0], texels[1][0], texels[2][0], texels[3][0]);
+
+                if (triangle->shading == RS_Textured) {
+                    __m128 texel_g = _mm_setr_ps(texels[0][1], texels[1][1], texels[2][1], texels[3][1]);
+                    __m128 texel_b = _mm_setr_ps(texels[0][2], texels[1][2], texels[2][2], texels[3][2]);
+                    __m128 texel_a = _mm_setr_ps(texels[0][3], texels[1][3], texels[2][3], texels[3][3]);
+                    r = select_ps(is_textured, texel_r, r);
+                    g = select_ps(is_textured, texel_g, g);
+                    b = select_ps(is_textured, texel_b, b);
+                    a = select_ps(is_textured, texel_a, a);
+                } else if (triangle->shading == RS_Distance) {
+                    a = select_ps(is_textured, _mm_mul_ps(a, texel_r), a);
+                } else {
+                    a = select_ps(is_textured, texel_r, a);
+                }
+            }
+
+            // SRC_ALPHA, ONE_MINUS_SRC_ALPHA for color and alpha. Opaque spans don't need to read the destination
+            __m128i old_color = _mm_loadu_si128((__m128i*)(color_row + x));
+            if (_mm_movemask_ps(_mm_and_ps(mask, _mm_cmplt_ps(a, one)))) {
+                u32 old_pixels[4];
+                _mm_storeu_si128((__m128i*)old_pixels, old_color);
+
+                f32 dst[4][4];
+                for (int lane = 0; lane < 4; ++lane) {
+                    u32 pixel = old_pixels[lane];
+                    dst[lane][0] = srgb_to_linear_table[pixel & 0xFF];
+                    dst[lane][1] = srgb_to_linear_table[(pixel >> 8) & 0xFF];
+                    dst[lane][2] = srgb_to_linear_table[(pixel >> 16) & 0xFF];
+                    dst[lane][3] = (f32)(pixel >> 24) / 255.f;
+                }
+
+                __m128 inv_a = _mm_sub_ps(one, a);
+                r = _mm_add_ps(_mm_mul_ps(r, a), _mm_mul_ps(_mm_setr_ps(dst[0][0], dst[1][0], dst[2][0], dst[3][0]), inv_a));
+                g = _mm_add_ps(_mm_mul_ps(g, a), _mm_mul_ps(_mm_setr_ps(dst[0][1], dst[1][1], dst[2][1], dst[3][1]), inv_a));
+                b = _mm_add_ps(_mm_mul_ps(b, a), _mm_mul_ps(_mm_setr_ps(dst[0][2], dst[1][2], dst[2][2], dst[3][2]), inv_a));
+                a = _mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(_mm_setr_ps(dst[0][3], dst[1][3], dst[2][3], dst[3][3]), inv_a));
+            }
+
+            f32 out_r[4], out_g[4], out_b[4], out_a[4];
+            _mm_storeu_ps(out_r, r);
+            _mm_storeu_ps(out_g, g);
+            _mm_storeu_ps(out_b, b);
+            _mm_storeu_ps(out_a, a);
+
+            u32 new_pixels[4];
+            for (int lane = 0; lane < 4; ++lane) {
+                new_pixels[lane] = pack_rgba8(linear_to_srgb(out_r[lane]), linear_to_srgb(out_g[lane]), linear_to_srgb(out_b[lane]), unorm_to_u8(out_a[lane]));
+            }
+
+            __m128i mask_i = _mm_castps_si128(mask);
+            __m128i new_color = _mm_loadu_si128((__m128i*)new_pixels);
+            new_color = _mm_or_si128(_mm_and_si128(mask_i, new_color), _mm_andnot_si128(mask_i, old_color));
+            _mm_storeu_si128((__m128i*)(color_row + x), new_color);
+
+            _mm_storeu_ps(depth_row + x, select_ps(mask, z, old_depth));
+        }
+    }
+}
+
+static void raster_tile(Raster_Bin* bin) {
+    Raster_Target* target = bin->target;
+
+    int tile_x0 = bin->x * RASTER_TILE_SIZE;
+    int tile_y0 = bin->y * RASTER_TILE_SIZE;
+    int tile_x1 = tile_x0 + RASTER_TILE_SIZE - 1;
+    int tile_y1 = tile_y0 + RASTER_TILE_SIZE - 1;
+
+    if (target->clear_pending) {
+        __m128i clear_color = _mm_set1_epi32((int)target->clear_color);
+        __m128 clear_depth  = _mm_set1_ps(1.f);
+        for (int y = tile_y0; y <= tile_y1; ++y) {
+            u32* color_row = target->color + y * target->stride;
+            f32* depth_row = target->depth + y * target->stride;
+            for (int x = tile_x0; x <= tile_x1; x += 4) {
+                _mm_storeu_si128((__m128i*)(color_row + x), clear_color);
+                _mm_storeu_ps(depth_row + x, clear_depth);
+            }
+        }
+    }
+
+    for (int i = 0; i < bin->count; ++i) {
+        Raster_Triangle* triangle = &target->triangles[bin->triangles[i]];
+
+        int x0 = triangle->min_x > tile_x0 ? triangle->min_x : tile_x0;
+        int y0 = triangle->min_y > tile_y0 ? triangle->min_y : tile_y0;
+        int x1 = triangle->max_x < tile_x1 ? triangle->max_x : tile_x1;
+        int y1 = triangle->max_y < tile_y1 ? triangle->max_y : tile_y1;
+
+        raster_spans(target, triangle, x0 & ~3, y0, x1, y1);
+    }
+}
+
+static PLATFORM_WORK_PROC(raster_tile_work) {
+    raster_tile(data);
+}
+
+void resolve_raster_target(Raster_Target* target) {
+    int bin_count = target->tiles_x * target->tiles_y;
+    for (int i = 0; i < bin_count; ++i) {
+        Raster_Bin* bin = &target->bins[i];
+        bin->target = target;
+
+        // Empty tiles still have to clear
+        if (bin->count == 0 && !target->clear_pending) continue;
+        g_platform->add_work(raster_tile_work, bin);
+    }
+    g_platform->complete_all_work();
+
+    for (int i = 0; i < bin_count; ++i) target->bins[i].count = 0;
+    target->triangle_count = 0;
+    target->clear_pending  = false;
+}
+
+Raster_Texture* find_raster_texture(Raster_Target* target, u32 id) {
+    Raster_Texture** found = find_hash_table(&target->textures, id);
+    return found ? *found : 0;
+}
+
+Raster_Texture* add_raster_texture(Raster_Target* target, u32 id, int width, int height, b32 is_srgb) {
+    assert(!find_raster_texture(target, id));
+
+    // Allocated on their own so triangles can hold onto them while the table grows
+    Raster_Texture* texture = mem_alloc_struct(target->allocator, Raster_Texture);
+    *texture = (Raster_Texture) {
+        .pixels   = mem_alloc_array(target->allocator, u32, width * height),
+        .width    = width,
+        .height   = height,
+        .is_srgb  = is_srgb,
+    };
+    push_hash_table(&target->textures, id, texture);
+    return texture;
+}
+
+static u32 crc32_table[256];
+static b32 is_crc32_table_initialized = false;
+
+static u32 update_crc32(u32 crc, u8* data, usize size) {
+    if (!is_crc32_table_initialized) {
+        is_crc32_table_initialized = true;
+        for (u32 i = 0; i < 256; ++i) {
+            u32 c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            crc32_table[i] = c;
+        }
+    }
+
+    crc = ~crc;
+    for (usize i = 0; i < size; ++i) crc = crc32_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static u32 adler32(u8* data, usize size) {
+    u32 a = 1, b = 0;
+    while (size > 0) {
+        // 5552 is the most bytes that can be summed before b could overflow
+        usize block = size < 5552 ? size : 5552;
+        for (usize i = 0; i < block; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        size -= block;
+    }
+    return (b << 16) | a;
+}
+
+static u8* put_u32_be(u8* at, u32 x) {
+    at[0] = (u8)(x >> 24);
+    at[1] = (u8)(x >> 16);
+    at[2] = (u8)(x >> 8);
+    at[3] = (u8)x;
+    return at + 4;
+}
+
+// Writes the chunk's length, type and crc around size bytes of data already at at + 8
+static u8* put_png_chunk(u8* at, const char* type, usize size) {
+    put_u32_be(at, (u32)size);
+    mem_copy(at + 4, type, 4);
+    u32 crc = update_crc32(0, at + 4, size + 4);
+    return put_u32_be(at + 8 + size, crc);
+}
+
+b32 write_png(String path, u32* pixels, int width, int height, int stride) {
+    Allocator allocator = heap_allocator();
+
+    // Every row starts with a filter byte. Png rows go top to bottom
+    usize row_size = 1 + (usize)width * 4;
+    usize raw_size = row_size * height;
+    u8* raw = mem_alloc(allocator, raw_size);
+    for (int y = 0; y < height; ++y) {
+        u8* row = raw + row_size * y;
+        row[0] = 0;
+        mem_copy(row + 1, pixels + (usize)(height - 1 - y) * stride, (usize)width * 4);
+    }
+
+    // Stored deflate blocks hold at most 65535 bytes each
+    usize block_count = (raw_size + 65534) / 65535;
+    usize idat_size = 2 + raw_size + block_count * 5 + 4;
+    usize file_size = 8 + (12 + 13) + (12 + idat_size) + 12;
+    u8* file = mem_alloc(allocator, file_size);
+    u8* at = file;
+
+    static const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    mem_copy(at, signature, sizeof(signature));
+    at += sizeof(signature);
+
+    u8* header = at + 8;
+    header = put_u32_be(header, (u32)width);
+    header = put_u32_be(header, (u32)height);
+    header[0] = 8; // Bit depth
+    header[1] = 6; // RGBA
+    header[2] = 0; // Deflate
+    header[3] = 0; // Adaptive filtering
+    header[4] = 0; // Not interlaced
+    at = put_png_chunk(at, "IHDR", 13);
+
+    u8* idat = at + 8;
+    idat[0] = 0x78; // Deflate with a 32k window
+    idat[1] = 0x01; // No preset dictionary and the check bits for 0x78
+    idat += 2;
+    for (usize offset = 0; offset < raw_size; offset += 65535) {
+        usize block_size = raw_size - offset < 65535 ? raw_size - offset : 65535;
+        u16 len = (u16)block_size;
+        idat[0] = offset + block_size == raw_size ? 1 : 0;
+        idat[1] = (u8)len;
+        idat[2] = (u8)(len >> 8);
+        idat[3] = (u8)~len;
+        idat[4] = (u8)(~len >> 8);
+        mem_copy(idat + 5, raw + offset, block_size);
+        idat += 5 + block_size;
+    }
+    put_u32_be(idat, adler32(raw, raw_size));
+    at = put_png_chunk(at, "IDAT", idat_size);
+
+    at = put_png_chunk(at, "IEND", 0);
+    assert((usize)(at - file) == file_size);
+
+    b32 result = false;
+    File_Handle handle;
+    if (g_platform->open_file(path, FF_Write | FF_Create, &handle)) {
+        result = g_platform->write_file(handle, file, (int)file_size);
+        g_platform->close_file(&handle);
+    }
+
+    mem_free(allocator, file);
+    mem_free(allocator, raw);
+    return result;
+}
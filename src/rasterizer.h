@@ -0,0 +1,126 @@
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include "platform.h"
+
+// A cpu rasterizer for what the imm shaders draw. It doesn't touch gl so frames can be drawn, timed and written out
+// for comparing against golden images without a gpu. Triangles are binned into tiles when submitted then each tile
+// is rasterized on its own worker thread when the target is resolved. Interpolation is affine which is exact for the
+// orthographic views everything is drawn with.
+
+#define RASTER_TILE_SIZE 64 // Must be a multiple of 4 for the simd spans
+
+typedef struct Raster_Texture {
+    u32* pixels; // RGBA8 with the bottom row first like gl
+    int width, height;
+    b32 is_srgb; // Decoded to linear when sampled like a GL_SRGB_ALPHA texture
+    f32 distance_per_texel; // For RS_Distance. How much the red channel changes from one texel to the next
+} Raster_Texture;
+
+typedef enum Raster_Shading {
+    RS_Textured, // basic2d. The texture's color
+    RS_Coverage, // font and ui_2d. The vertex color with the texture's red channel as alpha
+    RS_Distance, // sdf_font. The vertex color faded out over a pixel around 0.5 in the texture's red channel, sampled linearly
+} Raster_Shading;
+
+// A uv.x of -1 or less means untextured and uses the vertex color, same as the shaders
+typedef struct Raster_Vertex {
+    Vector3 position;
+    Vector2 uv;
+    Vector4 color;
+} Raster_Vertex;
+
+typedef enum Raster_Attribute {
+    RA_Z,
+    RA_U,
+    RA_V,
+    RA_R,
+    RA_G,
+    RA_B,
+    RA_A,
+
+    RA_Count,
+} Raster_Attribute;
+
+// Set up once when submitted so tiles only have to step these
+typedef struct Raster_Triangle {
+    // Edge functions a * x + b * y + c at pixel centers. Positive is inside
+    f32 edge_a[3];
+    f32 edge_b[3];
+    f32 edge_c[3];
+    b32 is_top_left[3];
+
+    // Attributes as planes over the screen
+    f32 plane_dx[RA_Count];
+    f32 plane_dy[RA_Count];
+    f32 plane_c[RA_Count];
+
+    int min_x, min_y, max_x, max_y;
+
+    Raster_Shading shading;
+    Raster_Texture* texture;
+    f32 edge_width; // For RS_Distance. Half of how much the distance changes over a pixel, like fwidth in the shader
+} Raster_Triangle;
+
+typedef struct Raster_Target Raster_Target;
+
+typedef struct Raster_Bin {
+    Raster_Target* target;
+    int x, y; // In tiles
+
+    int* triangles; // In submission order so blending comes out the same as gl
+    int count;
+    int cap;
+} Raster_Bin;
+
+typedef struct Raster_Target {
+    int width, height;
+    int stride; // Rows are padded out to whole tiles
+
+    u32* color; // sRGB encoded RGBA8 with the bottom row first
+    f32* depth;
+
+    int tiles_x, tiles_y;
+    Raster_Bin* bins;
+
+    Raster_Triangle* triangles;
+    int triangle_count;
+    int triangle_cap;
+
+    // Clears are done by the tiles when resolving
+    b32 clear_pending;
+    u32 clear_color;
+
+    // Inclusive pixel bounds triangles are cut to while has_scissor is set
+    b32 has_scissor;
+    int scissor_min_x, scissor_min_y;
+    int scissor_max_x, scissor_max_y;
+
+    Hash_Table textures; // u32 id -> Raster_Texture*
+
+    Allocator allocator;
+} Raster_Target;
+
+Raster_Target make_raster_target(int width, int height, Allocator allocator);
+void free_raster_target(Raster_Target* target);
+
+void clear_raster_target(Raster_Target* target, Vector3 color);
+
+// Transforms and bins the triangles. Nothing is written to the target until it's resolved
+void raster_triangles(Raster_Target* target, Matrix4 mvp, Raster_Shading shading, Raster_Texture* texture, Raster_Vertex* vertices, int count);
+
+// Like glScissor. Triangles submitted until it's cleared only cover pixels inside the box
+void set_raster_scissor(Raster_Target* target, int x, int y, int width, int height);
+void clear_raster_scissor(Raster_Target* target);
+
+// Rasterizes everything binned since the last resolve, one tile per job on the platform's workers
+void resolve_raster_target(Raster_Target* target);
+
+// Textures are owned by the target and looked up by whatever id the caller uses, like a gl texture name
+Raster_Texture* find_raster_texture(Raster_Target* target, u32 id);
+Raster_Texture* add_raster_texture(Raster_Target* target, u32 id, int width, int height, b32 is_srgb);
+
+// Writes RGBA8 pixels stored bottom row first. The png is uncompressed so this only needs crc32 and adler32
+b32 write_png(String path, u32* pixels, int width, int height, int stride);
+
+#endif /* RASTERIZER_H */